@@ -0,0 +1,563 @@
+/**
+ * @file bench.cpp
+ * @brief Microbenchmarks for the tokenizer, the parser and every Geralt action.
+ *
+ * Usage:
+ * @code
+ * witchertracker-bench [--sizes 10,1000,100000,1000000] [--min-time-ms 50] [--filter text]
+ *                      [--out results.json] [--baseline baseline.json] [--threshold 10]
+ * witchertracker-bench --compare baseline.json current.json [--threshold 10]
+ * @endcode
+ *
+ * Results are written as JSON, one benchmark object per line. With --baseline (after a
+ * run) or --compare (between two stored result files) every benchmark that got slower
+ * than the threshold percentage is flagged and the exit status is 1.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <optional>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "../src/geralt.h"
+#include "../src/commands.h"
+#include "../src/parser.h"
+#include "../src/token.h"
+#include "../src/querycache.h"
+#include "../src/arena.h"
+#include "../src/output.h"
+#include "../src/planner.h"
+#include "../src/optimizer.h"
+
+using namespace std;
+
+optional<TokenList> scanLine(const string&);
+optional<TokenList> tokenizeLine(const string&);
+bool refineTokens(TokenList&);
+TokenType getWordType(const string&, int, int);
+
+namespace {
+
+/**
+ * @struct Result
+ * @brief Measurement of one benchmark.
+ */
+struct Result {
+    string name;
+    uint64_t size;
+    uint64_t iterations;
+    double nsPerOp;
+};
+
+/// Stops the optimizer from discarding a computed value.
+template <typename T>
+void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * @brief Runs @p body in batches until a batch takes at least @p minTime, then reports
+ *        the fastest of three such batches in nanoseconds per iteration.
+ */
+Result measure(const string& name, uint64_t size, chrono::nanoseconds minTime, const function<void(uint64_t)>& body) {
+    uint64_t iterations = 1;
+
+    // Warm-up, so one-time work such as filling a cache is not mistaken for the steady state
+    body(1);
+
+    while (true) {
+        auto start = chrono::steady_clock::now();
+        body(iterations);
+        auto elapsed = chrono::steady_clock::now() - start;
+
+        if (elapsed >= minTime || iterations >= (1ULL << 30)) {
+            break;
+        }
+
+        // Grow quickly, but aim a little past the target so the next batch usually suffices
+        double ratio = elapsed.count() > 0 ? static_cast<double>(minTime.count()) / elapsed.count() : 100.0;
+        iterations = max<uint64_t>(iterations + 1, static_cast<uint64_t>(iterations * min(ratio * 1.2, 100.0)));
+    }
+
+    double best = 0;
+    for (int repetition = 0; repetition < 3; repetition++) {
+        auto start = chrono::steady_clock::now();
+        body(iterations);
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / iterations;
+        best = repetition == 0 ? ns : min(best, ns);
+    }
+
+    return Result{name, size, iterations, best};
+}
+
+/// Builds a unique, purely alphabetical name such as "IngBaf" from a number.
+string nameFor(const string& prefix, uint64_t number) {
+    string name = prefix;
+    do {
+        name.push_back(static_cast<char>('a' + number % 26));
+        number /= 26;
+    } while (number > 0);
+    return name;
+}
+
+/// Tokenizes a line that is known to be valid.
+TokenList tokens(const string& line) {
+    optional<TokenList> result = tokenizeLine(line);
+    if (!result) {
+        cerr << "Benchmark line is invalid: " << line << endl;
+        exit(2);
+    }
+    return *result;
+}
+
+/// One representative line for every ParserActionType.
+const vector<pair<ParserActionType, string>>& sampleLines() {
+    static const vector<pair<ParserActionType, string>> lines = {
+        {LOOT_ACTION, "Geralt loots 5 Rebis, 4 Vitriol, 1 Quebrith"},
+        {TRADE_ACTION, "Geralt trades 1 Harpy, 2 Wyvern trophy for 8 Vitriol, 3 Rebis"},
+        {BREW_ACTION, "Geralt brews Black Blood"},
+        {KNOWLEDGE_EFFECTIVENESS_SIGN, "Geralt learns Igni sign is effective against Harpy"},
+        {KNOWLEDGE_EFFECTIVENESS_POTION, "Geralt learns Black Blood potion is effective against Harpy"},
+        {KNOWLEDGE_POTION_FORMULA, "Geralt learns Black Blood potion consists of 3 Vitriol, 2 Rebis, 1 Quebrith"},
+        {ENCOUNTER, "Geralt encounters a Harpy"},
+        {TOTAL_ALL_INGREDIENT_QUERY, "Total ingredient?"},
+        {TOTAL_ALL_POTION_QUERY, "Total potion?"},
+        {TOTAL_ALL_TROPHY_QUERY, "Total trophy?"},
+        {TOTAL_SPECIFIC_INGREDIENT_QUERY, "Total ingredient Rebis?"},
+        {TOTAL_SPECIFIC_POTION_QUERY, "Total potion Black Blood?"},
+        {TOTAL_SPECIFIC_TROPHY_QUERY, "Total trophy Harpy?"},
+        {BESTIARY_QUERY, "What is effective against Harpy?"},
+        {ALCHEMY_QUERY, "What is in Black Blood?"},
+        {EXIT_COMMAND, "Exit"},
+    };
+    return lines;
+}
+
+/**
+ * @brief Benchmarks of the lexer and the grammar matcher, which do not depend on the catalog size.
+ */
+void benchFrontEnd(vector<Result>& results, chrono::nanoseconds minTime, const string& filter) {
+    auto wanted = [&](const string& name) { return name.find(filter) != string::npos; };
+
+    for (const auto& sample : sampleLines()) {
+        string action = actionTypeName(sample.first);
+        const string& line = sample.second;
+
+        string name = "tokenizeLine/" + action;
+        if (wanted(name)) {
+            results.push_back(measure(name, 0, minTime, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    // Like execute_line, every line gets its own arena scope
+                    CommandArena::Scope arena;
+                    keep(tokenizeLine(line));
+                }
+            }));
+        }
+
+        // refineTokens works in place, so every iteration refines a fresh copy of the raw tokens
+        name = "refineTokens/" + action;
+        if (wanted(name)) {
+            TokenList raw = *scanLine(line);
+            TokenList work;
+            results.push_back(measure(name, 0, minTime, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    work = raw;
+                    keep(refineTokens(work));
+                }
+            }));
+        }
+
+        name = "parseCommand/" + action;
+        if (wanted(name)) {
+            TokenList refined = tokens(line);
+            results.push_back(measure(name, 0, minTime, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    keep(matchCommand(refined));
+                }
+            }));
+        }
+    }
+
+    const vector<pair<string, string>> words = {{"keyword", "encounters"}, {"word", "Quebrith"}};
+    for (const auto& word : words) {
+        string name = "getWordType/" + word.first;
+        if (wanted(name)) {
+            results.push_back(measure(name, 0, minTime, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    keep(getWordType(word.second, 0, static_cast<int>(word.second.size())));
+                }
+            }));
+        }
+    }
+}
+
+/**
+ * @brief Fills Geralt with @p size ingredients, potions, monsters and trophies.
+ *
+ * Every potion has a two-ingredient formula, every monster has an effective sign and
+ * potion, and every monster has been defeated once so that it has a trophy.
+ */
+void buildCatalog(uint64_t size) {
+    Geralt::reset();
+
+    const uint64_t batch = 1000;
+    vector<string> names;
+    vector<ItemCount> items;
+    for (uint64_t first = 0; first < size; first += batch) {
+        names.clear();
+        items.clear();
+        for (uint64_t i = first; i < min(size, first + batch); i++) {
+            names.push_back(nameFor("Ing", i));
+        }
+        for (const string& name : names) {
+            items.push_back(ItemCount{name, 1});
+        }
+        Geralt::loot(items);
+    }
+
+    for (uint64_t i = 0; i < size; i++) {
+        string potion = nameFor("Pot", i);
+        string monster = nameFor("Mon", i);
+        string first = nameFor("Ing", i);
+        string second = nameFor("Ing", (i + 1) % size);
+
+        Geralt::learnFormula(potion, {ItemCount{first, 1}, ItemCount{second, 1}});
+        Geralt::learnSign("Igni", monster);
+        Geralt::learnPotion(potion, monster);
+        Geralt::encounter(monster);
+
+        // The planner searches the formulas of every potion that is effective against a Hydra
+        if (i < 10000) {
+            Geralt::learnPotion(potion, "Hydra");
+        }
+    }
+
+    // Plenty of stock so that brews and trades keep succeeding for any iteration count
+    uint64_t middle = size / 2;
+    Geralt::getIngredients().find(nameFor("Ing", middle))->second->increaseQuantity(1000000000);
+    Geralt::getIngredients().find(nameFor("Ing", (middle + 1) % size))->second->increaseQuantity(1000000000);
+    Geralt::getTrophies().find(nameFor("Mon", middle))->second->increaseQuantity(1000000000);
+    QueryCache::clear();
+}
+
+/**
+ * @brief Benchmarks of every Geralt action on a catalog of the given size.
+ */
+void benchActions(vector<Result>& results, uint64_t size, chrono::nanoseconds minTime, const string& filter) {
+    vector<pair<string, function<void()>>> actions;
+
+    string ingredient = nameFor("Ing", size / 2);
+    string potion = nameFor("Pot", size / 2);
+    string monster = nameFor("Mon", size / 2);
+
+    // A shopping list of up to 200 different potions
+    string shoppingList;
+    for (uint64_t i = 0; i < min<uint64_t>(size, 200); i++) {
+        shoppingList += (i > 0 ? ", " : "") + to_string(i % 7 + 1) + " " + nameFor("Pot", i * (size / min<uint64_t>(size, 200)));
+    }
+
+    // A multi-get of 32 ingredients spread over the catalog, to compare with 32 single queries
+    string manyIngredients;
+    for (uint64_t i = 0; i < 32; i++) {
+        manyIngredients += (i > 0 ? ", " : "") + nameFor("Ing", (i * 7919) % size);
+    }
+
+    vector<pair<string, TokenList>> lines = {
+        {"loot", tokens("Geralt loots 1 " + ingredient)},
+        {"trade", tokens("Geralt trades 1 " + monster + " trophy for 1 " + ingredient)},
+        {"brew", tokens("Geralt brews " + potion)},
+        {"learnSign", tokens("Geralt learns Igni sign is effective against " + monster)},
+        {"learnPotion", tokens("Geralt learns " + potion + " potion is effective against " + monster)},
+        {"learnFormula", tokens("Geralt learns " + potion + " potion consists of 1 " + ingredient)},
+        {"encounter", tokens("Geralt encounters a " + monster)},
+        {"querySpecificIngredient", tokens("Total ingredient " + ingredient + "?")},
+        {"querySpecificPotion", tokens("Total potion " + potion + "?")},
+        {"querySpecificTrophy", tokens("Total trophy " + monster + "?")},
+        {"queryAllIngredients", tokens("Total ingredient?")},
+        {"queryAllPotions", tokens("Total potion?")},
+        {"queryAllTrophies", tokens("Total trophy?")},
+        {"queryEffectiveness", tokens("What is effective against " + monster + "?")},
+        {"queryFormula", tokens("What is in " + potion + "?")},
+        {"queryPlan", tokens("How does Geralt prepare for Hydra?")},
+        {"queryBrewMix", tokens("Total brewable potion?")},
+        {"queryShoppingList", tokens("What does Geralt need for " + shoppingList + "?")},
+        {"queryRankedIngredients", tokens("Top 10 ingredient?")},
+        {"queryRankedIngredients/scarcest", tokens("Bottom 10 ingredient?")},
+        {"queryMultipleIngredients", tokens("Total ingredient " + manyIngredients + "?")},
+        {"searchIngredientNames", tokens("Complete ingredient " + ingredient.substr(0, ingredient.size() - 1) + "?")},
+        {"searchIngredientNames/similar", tokens("Suggest ingredient " + ingredient.substr(1) + "?")},
+    };
+
+    map<string, void (*)(const TokenList&)> functions = {
+        {"loot", Commands::loot}, {"trade", Commands::trade}, {"brew", Commands::brew},
+        {"learnSign", Commands::learnSign}, {"learnPotion", Commands::learnPotion},
+        {"learnFormula", Commands::learnFormula}, {"encounter", Commands::encounter},
+        {"querySpecificIngredient", Commands::querySpecificIngredient},
+        {"querySpecificPotion", Commands::querySpecificPotion},
+        {"querySpecificTrophy", Commands::querySpecificTrophy},
+        {"queryAllIngredients", Commands::queryAllIngredients},
+        {"queryAllPotions", Commands::queryAllPotions},
+        {"queryAllTrophies", Commands::queryAllTrophies},
+        {"queryEffectiveness", Commands::queryEffectiveness},
+        {"queryFormula", Commands::queryFormula},
+        {"queryPlan", Commands::queryPlan},
+        {"queryBrewMix", Commands::queryBrewMix},
+        {"queryShoppingList", Commands::queryShoppingList},
+        {"queryRankedIngredients", Commands::queryRankedIngredients},
+        {"queryRankedIngredients/scarcest", Commands::queryRankedIngredients},
+        {"queryMultipleIngredients", Commands::queryMultipleIngredients},
+        {"searchIngredientNames", Commands::searchIngredientNames},
+        {"searchIngredientNames/similar", Commands::searchIngredientNames},
+    };
+
+    for (const auto& line : lines) {
+        string name = "Geralt::" + line.first;
+        if (name.find(filter) == string::npos) {
+            continue;
+        }
+
+        void (*function)(const TokenList&) = functions.at(line.first);
+        const TokenList& input = line.second;
+
+        results.push_back(measure(name, size, minTime, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                function(input);
+            }
+        }));
+
+        // Queries are memoized, so they are also measured with the answer rendered every time
+        if (line.first.compare(0, 5, "query") == 0) {
+            results.push_back(measure(name + "/uncached", size, minTime, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    QueryCache::clear();
+                    Planner::clear();
+                    BrewOptimizer::clear();
+                    function(input);
+                }
+            }));
+        }
+
+        // Planning again after a loot, which keeps the planner's index of the monster's potions
+        // and the optimizer's formula matrix, prices and previous mix
+        if (line.first == "queryPlan" || line.first == "queryBrewMix") {
+            const ItemCount restock[] = {ItemCount{ingredient, 1}};
+            results.push_back(measure(name + "/replan", size, minTime, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    Geralt::loot(restock);
+                    function(input);
+                }
+            }));
+        }
+    }
+}
+
+/**
+ * @brief Benchmarks of the typed calls that embedders use instead of sentences.
+ *
+ * Same operations as benchActions without tokens, parsing or printing, so the difference
+ * between "Geralt::<action>" and "Geralt::typed/<action>" is the cost of the text layer.
+ */
+void benchTypedActions(vector<Result>& results, uint64_t size, chrono::nanoseconds minTime, const string& filter) {
+    string ingredient = nameFor("Ing", size / 2);
+    string potion = nameFor("Pot", size / 2);
+    string monster = nameFor("Mon", size / 2);
+
+    const ItemCount ingredients[] = {ItemCount{ingredient, 1}};
+    const ItemCount trophies[] = {ItemCount{monster, 1}};
+    pmr::vector<ItemCount> stock;
+    pmr::vector<string_view> effective;
+    pmr::vector<int> quantities;
+
+    vector<string> manyNames;
+    for (uint64_t i = 0; i < 32; i++) {
+        manyNames.push_back(nameFor("Ing", (i * 7919) % size));
+    }
+    vector<string_view> many(manyNames.begin(), manyNames.end());
+
+    vector<pair<string, function<void()>>> calls = {
+        {"loot", [&] { Geralt::loot(ingredients); }},
+        {"trade", [&] { keep(Geralt::trade(trophies, ingredients)); }},
+        {"brew", [&] { keep(Geralt::brew(potion).brewed); }},
+        {"learnSign", [&] { keep(Geralt::learnSign("Igni", monster)); }},
+        {"learnPotion", [&] { keep(Geralt::learnPotion(potion, monster)); }},
+        {"learnFormula", [&] { keep(Geralt::learnFormula(potion, ingredients)); }},
+        {"encounter", [&] { keep(Geralt::encounter(monster)); }},
+        {"ingredientQuantity", [&] { keep(Geralt::ingredientQuantity(ingredient)); }},
+        {"ingredientQuantities", [&] { Geralt::ingredientQuantities(many, quantities); keep(quantities.size()); }},
+        {"ingredientStock", [&] { Geralt::ingredientStock(stock); keep(stock.size()); }},
+        {"effectiveAgainst", [&] { Geralt::effectiveAgainst(monster, effective); keep(effective.size()); }},
+        {"formula", [&] { keep(Geralt::formula(potion, stock)); }},
+    };
+
+    for (const auto& call : calls) {
+        string name = "Geralt::typed/" + call.first;
+        if (name.find(filter) == string::npos) {
+            continue;
+        }
+
+        const function<void()>& function = call.second;
+        results.push_back(measure(name, size, minTime, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                function();
+            }
+        }));
+    }
+}
+
+void writeResults(ostream& out, const vector<Result>& results) {
+    out << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        out << "    {\"name\": \"" << result.name << "\", \"size\": " << result.size
+            << ", \"iterations\": " << result.iterations << ", \"ns_per_op\": " << result.nsPerOp << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+/// Extracts the value that follows `"field": ` on a line written by writeResults.
+string fieldOf(const string& line, const string& field) {
+    string marker = "\"" + field + "\": ";
+    size_t start = line.find(marker);
+    if (start == string::npos) {
+        return "";
+    }
+    start += marker.size();
+
+    if (line[start] == '"') {
+        return line.substr(start + 1, line.find('"', start + 1) - start - 1);
+    }
+    return line.substr(start, line.find_first_of(",}", start) - start);
+}
+
+vector<Result> readResults(const string& path) {
+    vector<Result> results;
+    ifstream input(path);
+    if (!input) {
+        cerr << "Could not open " << path << endl;
+        exit(2);
+    }
+
+    string line;
+    while (getline(input, line)) {
+        string name = fieldOf(line, "name");
+        if (!name.empty()) {
+            results.push_back(Result{name, stoull(fieldOf(line, "size")), stoull(fieldOf(line, "iterations")),
+                                     stod(fieldOf(line, "ns_per_op"))});
+        }
+    }
+    return results;
+}
+
+/**
+ * @brief Prints the relative change of every benchmark present in both result sets.
+ *
+ * @return int 1 if any benchmark regressed beyond @p threshold percent, 0 otherwise.
+ */
+int compareResults(const vector<Result>& baseline, const vector<Result>& current, double threshold) {
+    map<pair<string, uint64_t>, double> before;
+    for (const Result& result : baseline) {
+        before[{result.name, result.size}] = result.nsPerOp;
+    }
+
+    int regressions = 0;
+    for (const Result& result : current) {
+        auto it = before.find({result.name, result.size});
+        if (it == before.end() || it->second <= 0) {
+            continue;
+        }
+
+        double change = (result.nsPerOp - it->second) / it->second * 100.0;
+        bool regressed = change > threshold;
+        regressions += regressed ? 1 : 0;
+
+        cerr << (regressed ? "REGRESSION " : "           ") << result.name << " [" << result.size << "] "
+             << it->second << " ns -> " << result.nsPerOp << " ns (" << (change >= 0 ? "+" : "") << change << "%)\n";
+    }
+
+    cerr << regressions << " regression(s) beyond " << threshold << "%" << endl;
+    return regressions > 0 ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    vector<uint64_t> sizes = {10, 1000, 100000, 1000000};
+    chrono::nanoseconds minTime = chrono::milliseconds(50);
+    string filter, outPath, baselinePath, comparePaths[2];
+    double threshold = 10.0;
+
+    for (int arg = 1; arg < argc; arg++) {
+        string option = argv[arg];
+        bool hasValue = arg + 1 < argc;
+
+        if (option == "--sizes" && hasValue) {
+            sizes.clear();
+            stringstream list(argv[++arg]);
+            string size;
+            while (getline(list, size, ',')) {
+                sizes.push_back(stoull(size));
+            }
+        } else if (option == "--min-time-ms" && hasValue) {
+            minTime = chrono::milliseconds(stoull(argv[++arg]));
+        } else if (option == "--filter" && hasValue) {
+            filter = argv[++arg];
+        } else if (option == "--out" && hasValue) {
+            outPath = argv[++arg];
+        } else if (option == "--baseline" && hasValue) {
+            baselinePath = argv[++arg];
+        } else if (option == "--threshold" && hasValue) {
+            threshold = stod(argv[++arg]);
+        } else if (option == "--compare" && arg + 2 < argc) {
+            comparePaths[0] = argv[++arg];
+            comparePaths[1] = argv[++arg];
+        } else {
+            cerr << "Unknown option: " << option << endl;
+            return 2;
+        }
+    }
+
+    if (!comparePaths[0].empty()) {
+        return compareResults(readResults(comparePaths[0]), readResults(comparePaths[1]), threshold);
+    }
+
+    // Answers are rendered as usual but never reach the terminal
+    NullSink nullSink;
+    Output::redirect(&nullSink);
+
+    vector<Result> results;
+    benchFrontEnd(results, minTime, filter);
+
+    for (uint64_t size : sizes) {
+        if (size == 0) {
+            continue;
+        }
+        buildCatalog(size);
+        benchActions(results, size, minTime, filter);
+        benchTypedActions(results, size, minTime, filter);
+    }
+
+    Output::redirect(nullptr);
+
+    if (outPath.empty()) {
+        writeResults(cout, results);
+    } else {
+        ofstream out(outPath);
+        writeResults(out, results);
+    }
+
+    if (!baselinePath.empty()) {
+        return compareResults(readResults(baselinePath), results, threshold);
+    }
+
+    return 0;
+}
@@ -0,0 +1,409 @@
+/**
+ * @file workload.cpp
+ * @brief Generator of large, reproducible command streams with skewed name popularity.
+ *
+ * Usage:
+ * @code
+ * witchertracker-workload --lines 100000000 [--seed 1] [--names 1000] [--zipf 1.0]
+ *                         [--mix loot=25,trade=5,brew=15,learn=10,encounter=10,query=34.9,listing=0.1,invalid=0]
+ *                         [--formula-length 2-4] [--list-length 1-4]
+ *                         [--out input.txt] [--expected output.txt]
+ * @endcode
+ *
+ * Names are drawn from a catalog of --names ingredients, potions and monsters, with
+ * rank k chosen with probability proportional to 1 / k^zipf. The same options and seed
+ * always produce the same stream. With --expected every generated line is also run
+ * through the interpreter in this process, and its answers are written in the format
+ * of test-cases/outputN.txt, so any other mode of witchertracker can be checked with
+ * test/checker.py against inputs of any size.
+ *
+ * Listing queries ("Total ingredient?") answer with the whole catalog, so on large
+ * catalogs even their small default weight dominates the size of the expected output.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <memory>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../src/parsecache.h"
+#include "../src/output.h"
+
+using namespace std;
+
+bool execute_line(const string&);
+
+namespace {
+
+/**
+ * @brief splitmix64, used instead of the standard distributions so that a seed gives the
+ *        same stream with every standard library.
+ */
+class Random {
+public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    /// Uniform in [0, 1).
+    double uniform() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+    /// Uniform in [low, high].
+    uint64_t between(uint64_t low, uint64_t high) { return low + next() % (high - low + 1); }
+
+private:
+    uint64_t state;
+};
+
+/**
+ * @brief Samples ranks 0..n-1 with probability proportional to 1 / (rank + 1)^exponent.
+ */
+class Zipf {
+public:
+    Zipf(uint64_t n, double exponent) : cumulative(n) {
+        double sum = 0;
+        for (uint64_t rank = 0; rank < n; rank++) {
+            sum += 1.0 / pow(static_cast<double>(rank + 1), exponent);
+            cumulative[rank] = sum;
+        }
+        for (double& value : cumulative) {
+            value /= sum;
+        }
+    }
+
+    uint64_t sample(Random& random) const {
+        auto it = upper_bound(cumulative.begin(), cumulative.end(), random.uniform());
+        return min<uint64_t>(it - cumulative.begin(), cumulative.size() - 1);
+    }
+
+private:
+    vector<double> cumulative;
+};
+
+/// Line kinds that --mix assigns weights to, in the order they are drawn.
+const vector<string> KINDS = {"loot", "trade", "brew", "learn", "encounter", "query", "listing", "invalid"};
+
+const vector<string> SIGNS = {"Aard", "Igni", "Yrden", "Quen", "Axii"};
+
+/**
+ * @struct Options
+ * @brief Parsed command-line options.
+ */
+struct Options {
+    uint64_t lines = 1000000;
+    uint64_t seed = 1;
+    uint64_t names = 1000;
+    double zipf = 1.0;
+    map<string, double> mix = {{"loot", 25}, {"trade", 5}, {"brew", 15}, {"learn", 10},
+                               {"encounter", 10}, {"query", 34.9}, {"listing", 0.1}, {"invalid", 0}};
+    uint64_t formulaMin = 2, formulaMax = 4;
+    uint64_t listMin = 1, listMax = 4;
+    string outPath;
+    string expectedPath;
+};
+
+/// Builds a unique, purely alphabetical name such as "Ingbaf" from a number.
+string nameFor(const string& prefix, uint64_t number) {
+    string name = prefix;
+    do {
+        name.push_back(static_cast<char>('a' + number % 26));
+        number /= 26;
+    } while (number > 0);
+    return name;
+}
+
+/**
+ * @class Generator
+ * @brief Produces one command line at a time according to the options.
+ */
+class Generator {
+public:
+    explicit Generator(const Options& options)
+        : options(options), random(options.seed), popularity(options.names, options.zipf) {
+        double sum = 0;
+        for (const string& kind : KINDS) {
+            sum += options.mix.at(kind);
+            kindCumulative.push_back(sum);
+        }
+    }
+
+    /// Writes the next command into @p line, replacing its contents.
+    void next(string& line) {
+        line.clear();
+
+        double pick = random.uniform() * kindCumulative.back();
+        size_t kind = upper_bound(kindCumulative.begin(), kindCumulative.end(), pick) - kindCumulative.begin();
+
+        switch (min(kind, KINDS.size() - 1)) {
+        case 0:
+            line.append("Geralt loots ");
+            appendList(line, "Ing", options.listMin, options.listMax, 1, 20);
+            break;
+        case 1:
+            line.append("Geralt trades ");
+            appendList(line, "Mon", options.listMin, options.listMax, 1, 2);
+            line.append(" trophy for ");
+            appendList(line, "Ing", options.listMin, options.listMax, 1, 10);
+            break;
+        case 2:
+            line.append("Geralt brews ").append(potion());
+            break;
+        case 3:
+            appendLearn(line);
+            break;
+        case 4:
+            line.append("Geralt encounters a ").append(nameFor("Mon", popularity.sample(random)));
+            break;
+        case 5:
+            appendQuery(line);
+            break;
+        case 6: {
+            static const char* const listings[] = {"Total ingredient?", "Total potion?", "Total trophy?"};
+            line.append(listings[random.next() % 3]);
+            break;
+        }
+        default:
+            appendInvalid(line);
+            break;
+        }
+    }
+
+private:
+    const Options& options;
+    Random random;
+    Zipf popularity;
+    vector<double> kindCumulative;
+
+    /// Every third potion has a two-word name, like "Black Blood" in the sample inputs.
+    string potion() {
+        uint64_t rank = popularity.sample(random);
+        string name = nameFor("Pot", rank);
+        if (rank % 3 == 2) {
+            name.append(" Draught");
+        }
+        return name;
+    }
+
+    /// Appends "q1 Name1, q2 Name2, ..." with distinct names.
+    void appendList(string& line, const string& prefix, uint64_t minLength, uint64_t maxLength,
+                    uint64_t minQuantity, uint64_t maxQuantity) {
+        uint64_t length = min(random.between(minLength, maxLength), options.names);
+        vector<uint64_t> used;
+
+        while (used.size() < length) {
+            uint64_t rank = popularity.sample(random);
+
+            // A steep distribution keeps returning the same few ranks, so fall back to the most popular unused one
+            for (uint64_t attempt = 0; find(used.begin(), used.end(), rank) != used.end(); attempt++) {
+                rank = attempt < 16 ? popularity.sample(random) : rank + 1 == options.names ? 0 : rank + 1;
+            }
+
+            if (!used.empty()) {
+                line.append(", ");
+            }
+            used.push_back(rank);
+            line.append(to_string(random.between(minQuantity, maxQuantity))).append(" ").append(nameFor(prefix, rank));
+        }
+    }
+
+    /// Formulas make up half of the learn lines, so that brews have something to succeed on.
+    void appendLearn(string& line) {
+        uint64_t variant = random.next() % 4;
+        string monster = nameFor("Mon", popularity.sample(random));
+
+        line.append("Geralt learns ");
+        if (variant == 0) {
+            line.append(SIGNS[random.next() % SIGNS.size()]).append(" sign is effective against ").append(monster);
+        } else if (variant == 1) {
+            line.append(potion()).append(" potion is effective against ").append(monster);
+        } else {
+            line.append(potion()).append(" potion consists of ");
+            appendList(line, "Ing", options.formulaMin, options.formulaMax, 1, 5);
+        }
+    }
+
+    void appendQuery(string& line) {
+        switch (random.next() % 5) {
+        case 0:
+            line.append("Total ingredient ").append(nameFor("Ing", popularity.sample(random))).append("?");
+            break;
+        case 1:
+            line.append("Total potion ").append(potion()).append("?");
+            break;
+        case 2:
+            line.append("Total trophy ").append(nameFor("Mon", popularity.sample(random))).append("?");
+            break;
+        case 3:
+            line.append("What is effective against ").append(nameFor("Mon", popularity.sample(random))).append("?");
+            break;
+        default:
+            line.append("What is in ").append(potion()).append("?");
+            break;
+        }
+    }
+
+    /// Near misses of valid commands, the kind of typo a client actually sends.
+    void appendInvalid(string& line) {
+        switch (random.next() % 4) {
+        case 0:
+            line.append("Geralt loots ").append(nameFor("Ing", popularity.sample(random)));
+            break;
+        case 1:
+            line.append("Geralt brews 3 ").append(potion());
+            break;
+        case 2:
+            line.append("Total ingredient ").append(nameFor("Ing", popularity.sample(random)));
+            break;
+        default:
+            line.append("Geralt loots -1 ").append(nameFor("Ing", popularity.sample(random)));
+            break;
+        }
+    }
+};
+
+/// Parses "low-high" or a single number into an inclusive range.
+bool parseRange(const char* text, uint64_t& low, uint64_t& high) {
+    char* end = nullptr;
+    low = strtoull(text, &end, 10);
+    high = *end == '-' ? strtoull(end + 1, &end, 10) : low;
+    return *end == '\0' && low >= 1 && low <= high;
+}
+
+/// Parses "kind=weight,kind=weight"; kinds that are not mentioned keep their default.
+bool parseMix(const string& text, map<string, double>& mix) {
+    stringstream stream(text);
+    string item;
+
+    while (getline(stream, item, ',')) {
+        size_t equals = item.find('=');
+        if (equals == string::npos || mix.count(item.substr(0, equals)) == 0) {
+            return false;
+        }
+        mix[item.substr(0, equals)] = strtod(item.c_str() + equals + 1, nullptr);
+    }
+
+    double sum = 0;
+    for (const auto& weight : mix) {
+        if (weight.second < 0) {
+            return false;
+        }
+        sum += weight.second;
+    }
+    return sum > 0;
+}
+
+int usage() {
+    cerr << "Usage: witchertracker-workload --lines <n> [--seed <n>] [--names <n>] [--zipf <s>]\n"
+            "                               [--mix kind=weight,...] [--formula-length a-b] [--list-length a-b]\n"
+            "                               [--out <file>] [--expected <file>]\n"
+            "Kinds: loot, trade, brew, learn, encounter, query, listing, invalid" << endl;
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+
+    for (int arg = 1; arg < argc; arg++) {
+        bool hasValue = arg + 1 < argc;
+
+        if (strcmp(argv[arg], "--lines") == 0 && hasValue) {
+            options.lines = strtoull(argv[++arg], nullptr, 10);
+        } else if (strcmp(argv[arg], "--seed") == 0 && hasValue) {
+            options.seed = strtoull(argv[++arg], nullptr, 10);
+        } else if (strcmp(argv[arg], "--names") == 0 && hasValue) {
+            options.names = max<uint64_t>(1, strtoull(argv[++arg], nullptr, 10));
+        } else if (strcmp(argv[arg], "--zipf") == 0 && hasValue) {
+            options.zipf = strtod(argv[++arg], nullptr);
+        } else if (strcmp(argv[arg], "--mix") == 0 && hasValue) {
+            if (!parseMix(argv[++arg], options.mix)) {
+                return usage();
+            }
+        } else if (strcmp(argv[arg], "--formula-length") == 0 && hasValue) {
+            if (!parseRange(argv[++arg], options.formulaMin, options.formulaMax)) {
+                return usage();
+            }
+        } else if (strcmp(argv[arg], "--list-length") == 0 && hasValue) {
+            if (!parseRange(argv[++arg], options.listMin, options.listMax)) {
+                return usage();
+            }
+        } else if (strcmp(argv[arg], "--out") == 0 && hasValue) {
+            options.outPath = argv[++arg];
+        } else if (strcmp(argv[arg], "--expected") == 0 && hasValue) {
+            options.expectedPath = argv[++arg];
+        } else {
+            return usage();
+        }
+    }
+
+    ofstream outFile;
+    if (!options.outPath.empty()) {
+        outFile.open(options.outPath);
+        if (!outFile) {
+            cerr << "Could not open " << options.outPath << endl;
+            return 1;
+        }
+    }
+    ostream& out = options.outPath.empty() ? cout : outFile;
+
+    // The reference run answers through the output sink, which is pointed at the expected file
+    int expectedFd = -1;
+    unique_ptr<BufferSink> expected;
+    if (!options.expectedPath.empty()) {
+        if (options.outPath.empty()) {
+            cerr << "--expected needs --out, since the answers are written to standard output" << endl;
+            return 2;
+        }
+
+        expectedFd = open(options.expectedPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (expectedFd < 0) {
+            cerr << "Could not open " << options.expectedPath << endl;
+            return 1;
+        }
+        expected.reset(new BufferSink(expectedFd));
+        Output::redirect(expected.get());
+
+        // The reference answers come from the plain tokenizer and parser path
+        ParseCache::setCapacity(0);
+    }
+
+    Generator generator(options);
+    string line;
+
+    for (uint64_t i = 0; i < options.lines; i++) {
+        generator.next(line);
+        out << line << '\n';
+
+        if (expected && !execute_line(line)) {
+            expected->write("INVALID");
+            expected->endAnswer();
+        }
+    }
+
+    out.flush();
+    bool closed = true;
+    if (expected) {
+        expected->flush();
+        Output::redirect(nullptr);
+        closed = close(expectedFd) == 0;
+    }
+
+    return out && closed ? 0 : 1;
+}
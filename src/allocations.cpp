@@ -0,0 +1,129 @@
+/**
+ * @file allocations.cpp
+ * @brief Implementation of the operator new hook and the allocation budgets.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include "allocations.h"
+#include "stats.h"
+
+using namespace std;
+
+namespace {
+
+bool tracking = false;
+thread_local Allocations::Counters counters;
+
+/// Budgets by action name, as loaded by loadBudgets.
+map<string, uint64_t> budgets;
+
+} // namespace
+
+#if WITCHERTRACKER_ALLOC_HOOK && WITCHERTRACKER_STATS
+
+namespace {
+
+// Kept out of line: once free() is inlined into a caller that allocated with operator
+// new, GCC reports the pair as mismatched (-Wmismatched-new-delete).
+__attribute__((noinline)) void release(void* pointer) noexcept {
+    free(pointer);
+}
+
+} // namespace
+
+// The array and nothrow forms of the default operators forward to these two, so
+// replacing them is enough to see every allocation of the program. The sized and array
+// deletes are replaced too, so that every delete reaches release() above.
+void* operator new(size_t size) {
+    if (tracking) {
+        counters.allocations++;
+        counters.bytes += size;
+    }
+
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    release(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+#endif
+
+void Allocations::enable() {
+    tracking = STATS_COMPILED && ALLOC_HOOK_COMPILED;
+}
+
+bool Allocations::isEnabled() {
+    return tracking;
+}
+
+Allocations::Counters Allocations::current() {
+    return counters;
+}
+
+bool Allocations::loadBudgets(const string& path, string& error) {
+    ifstream input(path);
+    if (!input) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    string line;
+    for (int number = 1; getline(input, line); number++) {
+        istringstream fields(line);
+        string action;
+        uint64_t limit;
+
+        if (!(fields >> action) || action[0] == '#') {
+            continue;
+        }
+        if (!(fields >> limit)) {
+            error = path + ":" + to_string(number) + ": expected an action name and an allocation count";
+            return false;
+        }
+        budgets[action] = limit;
+    }
+
+    return true;
+}
+
+bool Allocations::checkBudgets() {
+    bool withinBudget = true;
+
+    for (int action = -1; action < PARSER_ACTION_COUNT; action++) {
+        const char* name = action < 0 ? "INVALID" : actionTypeName(static_cast<ParserActionType>(action));
+        auto budget = budgets.find(name);
+        const Stats::AllocationTotals& totals = Stats::commandAllocations(action);
+
+        if (budget != budgets.end() && totals.maxAllocations > budget->second) {
+            cerr << "allocation budget exceeded: " << name << " made up to " << totals.maxAllocations
+                 << " allocations per command, budget is " << budget->second << endl;
+            withinBudget = false;
+        }
+    }
+
+    return withinBudget;
+}
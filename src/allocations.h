@@ -0,0 +1,76 @@
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+/**
+ * @file allocations.h
+ * @brief Declares the heap allocation counters fed by a global operator new hook.
+ *
+ * The program replaces the global operator new. While tracking is on, each call adds
+ * one allocation and its size to counters of the calling thread. A Stats::Span reads
+ * these counters when it starts and when it ends, so allocations are charged to the
+ * stage that made them, and every command is charged to its ParserActionType.
+ *
+ * Replacing operator new affects every object linked into the program, so the hook is
+ * only compiled in with -DWITCHERTRACKER_ALLOC_HOOK=1, which the command line build
+ * passes and the static library leaves out. It is also left out with
+ * -DWITCHERTRACKER_STATS=0, since only the instrumentation reads the counters.
+ */
+
+#include <cstdint>
+#include <string>
+
+#ifndef WITCHERTRACKER_ALLOC_HOOK
+#define WITCHERTRACKER_ALLOC_HOOK 0
+#endif
+
+/// Whether the global operator new is replaced to count allocations.
+constexpr bool ALLOC_HOOK_COMPILED = WITCHERTRACKER_ALLOC_HOOK != 0;
+
+/**
+ * @class Allocations
+ * @brief Static access to the per-thread allocation counters.
+ */
+class Allocations {
+public:
+    /**
+     * @struct Counters
+     * @brief Running totals of one thread since tracking started.
+     */
+    struct Counters {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+    };
+
+    /// Starts counting allocations made by operator new.
+    static void enable();
+
+    /// Tells whether allocations are being counted.
+    static bool isEnabled();
+
+    /// Returns the counters of the calling thread.
+    static Counters current();
+
+    /**
+     * @brief Loads per-command allocation budgets and checks them at exit.
+     *
+     * Each non-empty line of the file that does not start with '#' holds an action name
+     * as printed by actionTypeName (or INVALID), then the maximum number of allocations a
+     * single command of that kind may make. Actions without a line are not checked.
+     *
+     * @param path Budget file.
+     * @param error Receives a human readable reason on failure.
+     * @return true If the budgets have been loaded.
+     */
+    static bool loadBudgets(const std::string& path, std::string& error);
+
+    /**
+     * @brief Compares the observed per-command maxima with the loaded budgets.
+     *
+     * Every command kind that went over its budget is reported on standard error.
+     *
+     * @return true If no budget was exceeded.
+     */
+    static bool checkBudgets();
+};
+
+#endif
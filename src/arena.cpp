@@ -0,0 +1,48 @@
+/**
+ * @file arena.cpp
+ * @brief Implementation of the per-thread command arena.
+ */
+
+#include <cstddef>
+#include <memory_resource>
+
+#include "arena.h"
+
+using namespace std;
+
+namespace {
+
+/**
+ * @struct ThreadArena
+ * @brief The reusable buffer of one thread and the monotonic resource laid over it.
+ */
+struct ThreadArena {
+    alignas(max_align_t) unsigned char buffer[CommandArena::BUFFER_SIZE];
+    pmr::monotonic_buffer_resource resource{buffer, sizeof(buffer), pmr::new_delete_resource()};
+    int depth = 0; ///< Number of open scopes
+};
+
+ThreadArena& threadArena() {
+    thread_local ThreadArena arena;
+    return arena;
+}
+
+} // namespace
+
+CommandArena::Scope::Scope() {
+    threadArena().depth++;
+}
+
+CommandArena::Scope::~Scope() {
+    ThreadArena& arena = threadArena();
+
+    // release() returns any overflow blocks to the heap and rewinds to the start of the buffer
+    if (--arena.depth == 0) {
+        arena.resource.release();
+    }
+}
+
+pmr::memory_resource* CommandArena::resource() {
+    ThreadArena& arena = threadArena();
+    return arena.depth > 0 ? &arena.resource : pmr::get_default_resource();
+}
@@ -0,0 +1,53 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+/**
+ * @file arena.h
+ * @brief Declares the per-command arena for transient allocations.
+ *
+ * Most memory a command needs lives only until its answer is printed: the token list,
+ * the scratch vectors of the executors. Instead of a malloc/free pair each, such
+ * containers draw from a std::pmr::monotonic_buffer_resource laid over a buffer that
+ * every thread keeps for its whole life. When the outermost Scope of a command ends,
+ * the resource is released in one step and the next command starts at the beginning
+ * of the same buffer again. Only a command that outgrows the buffer touches the heap.
+ */
+
+#include <cstddef>
+#include <memory_resource>
+
+/**
+ * @class CommandArena
+ * @brief Static access to the arena of the calling thread.
+ */
+class CommandArena {
+public:
+    /// Bytes of the per-thread buffer; larger commands continue on the heap.
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+    /**
+     * @class Scope
+     * @brief Marks the lifetime of one command; the arena is reset when the outermost scope ends.
+     *
+     * Scopes nest, so a command that runs another command inside itself keeps its own
+     * transient data alive until it finishes.
+     */
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    /**
+     * @brief Returns the resource transient containers should allocate from.
+     *
+     * Outside of any Scope there is no point at which the arena could be reset, so
+     * the default resource (the heap) is returned instead.
+     */
+    static std::pmr::memory_resource* resource();
+};
+
+#endif
@@ -0,0 +1,350 @@
+/**
+ * @file changefeed.cpp
+ * @brief Implementation of the delta ring, the coalescing overflow and the dispatcher.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "changefeed.h"
+#include "output.h"
+
+using namespace std;
+
+namespace {
+
+atomic<bool> feeding{false};
+
+/**
+ * The ring. Only the command thread pushes while @c overflowing is false, and only
+ * the holder of pendingMutex while it is true, so there is one producer at a time;
+ * only the dispatcher advances @c tail.
+ */
+unique_ptr<ChangeFeed::Delta[]> slots;
+size_t capacity = 0;
+atomic<uint64_t> head{0};
+atomic<uint64_t> tail{0};
+
+/// Deltas that did not fit into the ring, oldest first, one per entity.
+mutex pendingMutex;
+atomic<bool> overflowing{false};
+vector<ChangeFeed::Delta> pending;
+size_t pendingBegin = 0;                   ///< Deltas before it are in the ring already
+unordered_map<uint64_t, size_t> pendingIndex;   ///< Entity key to its index in pending
+atomic<uint64_t> coalesced{0};
+
+mutex subscriberMutex;
+vector<ChangeFeed::Callback> callbacks;
+int listener = -1;
+string socketPath;
+
+/// Connected feed clients; only the dispatcher touches them while it runs.
+vector<int> clients;
+
+thread dispatcher;
+mutex dispatcherMutex;
+condition_variable dispatcherWake;
+condition_variable deliveredSignal;
+bool stopping = false;
+
+/// How often the dispatcher drains the ring when nobody wakes it.
+constexpr chrono::milliseconds FLUSH_INTERVAL(5);
+
+uint64_t entityKey(const ChangeFeed::Delta& delta) {
+    return (static_cast<uint64_t>(delta.collection) << 32) | delta.id;
+}
+
+bool tryPush(const ChangeFeed::Delta& delta) {
+    uint64_t position = head.load(memory_order_relaxed);
+    if (position - tail.load(memory_order_acquire) == capacity) {
+        return false;
+    }
+
+    slots[position & (capacity - 1)] = delta;
+    head.store(position + 1, memory_order_release);
+    return true;
+}
+
+/// Moves the oldest kept deltas into the ring while there is room; pendingMutex must be held.
+void movePending() {
+    while (pendingBegin < pending.size() && tryPush(pending[pendingBegin])) {
+        pendingIndex.erase(entityKey(pending[pendingBegin]));
+        pendingBegin++;
+    }
+
+    if (pendingBegin == pending.size()) {
+        pending.clear();
+        pendingBegin = 0;
+        overflowing.store(false, memory_order_release);
+    }
+}
+
+/// Keeps a delta aside, merged into the one of the same entity if there is one; pendingMutex must be held.
+void keepAside(const ChangeFeed::Delta& delta) {
+    auto slot = pendingIndex.find(entityKey(delta));
+    if (slot != pendingIndex.end()) {
+        ChangeFeed::Delta& earlier = pending[slot->second];
+        earlier.after = delta.after;
+        earlier.sequence = delta.sequence;
+        coalesced.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    pendingIndex.emplace(entityKey(delta), pending.size());
+    pending.push_back(delta);
+}
+
+void appendLine(string& lines, const ChangeFeed::Delta& delta) {
+    appendInteger(lines, static_cast<long long>(delta.sequence));
+    lines += ' ';
+    lines += collectionName(delta.collection);
+    lines += ' ';
+    appendInteger(lines, delta.id);
+    lines += ' ';
+    appendInteger(lines, delta.before);
+    lines += ' ';
+    appendInteger(lines, delta.after);
+    lines += ' ';
+    lines.append(delta.name);
+    lines += '\n';
+}
+
+/// Sends the lines to every client and drops the clients that are gone.
+void sendToClients(const string& lines) {
+    size_t kept = 0;
+    for (int client : clients) {
+        const char* data = lines.data();
+        size_t size = lines.size();
+        bool connected = true;
+
+        while (connected && size > 0) {
+            ssize_t sent = ::send(client, data, size, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                connected = false;
+                break;
+            }
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        }
+
+        if (connected) {
+            clients[kept++] = client;
+        } else {
+            ::close(client);
+        }
+    }
+    clients.resize(kept);
+}
+
+void acceptClients() {
+    lock_guard<mutex> lock(subscriberMutex);
+    if (listener < 0) {
+        return;
+    }
+
+    // The listener does not block; accepted sockets do, so a slow client holds the ring back
+    int client;
+    while ((client = ::accept(listener, nullptr, nullptr)) >= 0) {
+        clients.push_back(client);
+    }
+}
+
+/// Delivers every delta in the ring, then every kept delta, to the subscribers and clients.
+void deliver() {
+    vector<ChangeFeed::Callback> subscribers;
+    {
+        lock_guard<mutex> lock(subscriberMutex);
+        subscribers = callbacks;
+    }
+    string lines;
+
+    while (true) {
+        uint64_t position = tail.load(memory_order_relaxed);
+        uint64_t end = head.load(memory_order_acquire);
+
+        if (position == end) {
+            if (!overflowing.load(memory_order_acquire)) {
+                return;
+            }
+            lock_guard<mutex> lock(pendingMutex);
+            movePending();
+            continue;
+        }
+
+        lines.clear();
+        for (; position != end; position++) {
+            const ChangeFeed::Delta& delta = slots[position & (capacity - 1)];
+            for (const auto& callback : subscribers) {
+                callback(delta);
+            }
+            if (!clients.empty()) {
+                appendLine(lines, delta);
+            }
+        }
+
+        // The slots are released only once every subscriber has them
+        if (!clients.empty()) {
+            sendToClients(lines);
+        }
+        tail.store(end, memory_order_release);
+    }
+}
+
+void dispatcherLoop() {
+    unique_lock<mutex> lock(dispatcherMutex);
+    while (!stopping) {
+        dispatcherWake.wait_for(lock, FLUSH_INTERVAL);
+
+        lock.unlock();
+        acceptClients();
+        deliver();
+        lock.lock();
+
+        deliveredSignal.notify_all();
+    }
+}
+
+} // namespace
+
+const char* collectionName(ChangeFeed::Collection collection) {
+    switch (collection) {
+        case ChangeFeed::INGREDIENT: return "ingredient";
+        case ChangeFeed::POTION: return "potion";
+        case ChangeFeed::TROPHY: return "trophy";
+    }
+    return "unknown";
+}
+
+void ChangeFeed::open(size_t ringCapacity) {
+    capacity = 1;
+    while (capacity < ringCapacity) {
+        capacity <<= 1;
+    }
+    slots.reset(new Delta[capacity]);
+    head.store(0, memory_order_relaxed);
+    tail.store(0, memory_order_relaxed);
+    coalesced.store(0, memory_order_relaxed);
+
+    stopping = false;
+    dispatcher = thread(dispatcherLoop);
+    feeding.store(true, memory_order_release);
+}
+
+bool ChangeFeed::isOpen() {
+    return feeding.load(memory_order_relaxed);
+}
+
+bool ChangeFeed::listen(const string& path, string& error) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        error = "socket path too long: " + path;
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = string("cannot create socket: ") + strerror(errno);
+        return false;
+    }
+
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 16) != 0 ||
+        ::fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        error = "cannot listen on " + path + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    lock_guard<mutex> lock(subscriberMutex);
+    listener = fd;
+    socketPath = path;
+    return true;
+}
+
+void ChangeFeed::subscribe(Callback callback) {
+    lock_guard<mutex> lock(subscriberMutex);
+    callbacks.push_back(move(callback));
+}
+
+void ChangeFeed::publish(Collection collection, uint32_t id, string_view name, int before, int after,
+                         uint64_t sequence) {
+    Delta delta{sequence, name, id, before, after, collection};
+    if (!overflowing.load(memory_order_acquire) && tryPush(delta)) {
+        // A burst does not wait for the next periodic drain to be delivered
+        if (head.load(memory_order_relaxed) - tail.load(memory_order_relaxed) == capacity / 2) {
+            dispatcherWake.notify_one();
+        }
+        return;
+    }
+
+    // The ring is full or older deltas are waiting: keep the order and never wait
+    lock_guard<mutex> lock(pendingMutex);
+    movePending();
+    if (!overflowing.load(memory_order_relaxed) && tryPush(delta)) {
+        return;
+    }
+    overflowing.store(true, memory_order_release);
+    keepAside(delta);
+}
+
+void ChangeFeed::flush() {
+    unique_lock<mutex> lock(dispatcherMutex);
+    while (isOpen() && (tail.load(memory_order_acquire) != head.load(memory_order_relaxed) ||
+                        overflowing.load(memory_order_acquire))) {
+        dispatcherWake.notify_one();
+        deliveredSignal.wait_for(lock, FLUSH_INTERVAL);
+    }
+}
+
+uint64_t ChangeFeed::coalescedCount() {
+    return coalesced.load(memory_order_relaxed);
+}
+
+void ChangeFeed::close() {
+    if (!feeding.exchange(false)) {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(dispatcherMutex);
+        stopping = true;
+    }
+    dispatcherWake.notify_one();
+    dispatcher.join();
+
+    // Whatever was published after the last drain
+    deliver();
+
+    for (int client : clients) {
+        ::close(client);
+    }
+    clients.clear();
+
+    lock_guard<mutex> lock(subscriberMutex);
+    if (listener >= 0) {
+        ::close(listener);
+        ::unlink(socketPath.c_str());
+        listener = -1;
+    }
+    callbacks.clear();
+    slots.reset();
+}
@@ -0,0 +1,118 @@
+#ifndef CHANGEFEED_H
+#define CHANGEFEED_H
+
+/**
+ * @file changefeed.h
+ * @brief Declares the change-data-capture feed of quantity deltas.
+ *
+ * A consumer that wants to follow the inventory should not poll "Total ingredient?"
+ * and compare whole answers. With the feed open, every quantity change made by loot,
+ * trade, brew or encounter is published as one fixed-size delta: which entity, its
+ * quantity before and after, and the input line of the command. The learn actions
+ * change no quantity and publish nothing; a potion they add shows up with its first
+ * change.
+ *
+ * Publishing only copies the delta into a single-producer ring buffer, like a trace
+ * span. A background dispatcher drains the ring, calls the in-process subscribers and
+ * writes one text line per delta to every client of the feed socket:
+ * @code
+ * <sequence> <collection> <id> <before> <after> <name>
+ * 42 ingredient 3 5 8 Rebis
+ * @endcode
+ *
+ * Subscribers that fall behind fill the ring. The command is never made to wait:
+ * deltas that do not fit are kept aside, coalesced per entity, and moved into the ring
+ * as it empties. A coalesced delta keeps the place and the quantity before of the first
+ * change it replaces, and the quantity after and sequence of the last one.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+ * @class ChangeFeed
+ * @brief Static feed of quantity deltas, used like the static Trace recorder.
+ */
+class ChangeFeed {
+public:
+    /// Collection of the entity a delta is about.
+    enum Collection : uint8_t {
+        INGREDIENT = 0,
+        POTION,
+        TROPHY
+    };
+
+    /**
+     * @struct Delta
+     * @brief One quantity change, as stored in the ring buffer.
+     */
+    struct Delta {
+        uint64_t sequence;      ///< Input line of the command; see Geralt::beginVersion()
+        std::string_view name;  ///< Points into the entity, valid until Geralt::reset()
+        uint32_t id;            ///< Entity ID in its collection
+        int32_t before;
+        int32_t after;
+        Collection collection;
+    };
+
+    /// In-process subscriber; called on the dispatcher thread, in feed order.
+    using Callback = std::function<void(const Delta&)>;
+
+    /// Deltas the ring holds by default; a power of two.
+    static constexpr size_t DEFAULT_RING_CAPACITY = 1 << 14;
+
+    /**
+     * @brief Starts the dispatcher.
+     *
+     * @param capacity Deltas the ring holds before new ones are coalesced; rounded up to a power of two.
+     */
+    static void open(size_t capacity = DEFAULT_RING_CAPACITY);
+
+    /// Returns true between open() and close().
+    static bool isOpen();
+
+    /**
+     * @brief Accepts feed clients on a Unix domain stream socket.
+     *
+     * A client receives the deltas delivered after it is accepted. Clients that
+     * disconnect are dropped.
+     *
+     * @param path Socket path; an existing socket file is replaced.
+     * @param error Receives a human readable reason on failure.
+     * @return true If the socket is listening.
+     */
+    static bool listen(const std::string& path, std::string& error);
+
+    /// Adds an in-process subscriber, which receives the deltas delivered from now on.
+    static void subscribe(Callback callback);
+
+    /**
+     * @brief Publishes a quantity change; only the thread that runs the commands may call it.
+     *
+     * @param collection Collection of the entity.
+     * @param id Entity ID.
+     * @param name Entity name.
+     * @param before Quantity before the change.
+     * @param after Quantity after the change.
+     * @param sequence Input line of the command.
+     */
+    static void publish(Collection collection, uint32_t id, std::string_view name, int before, int after,
+                        uint64_t sequence);
+
+    /// Waits until every published delta has been delivered to the subscribers.
+    static void flush();
+
+    /// Number of deltas merged into an earlier one of the same entity because the ring was full.
+    static uint64_t coalescedCount();
+
+    /// Delivers what is left, stops the dispatcher and closes the socket and its clients.
+    static void close();
+};
+
+/// Name of a collection in the text lines of the feed, e.g. "ingredient".
+const char* collectionName(ChangeFeed::Collection collection);
+
+#endif
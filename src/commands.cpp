@@ -0,0 +1,1221 @@
+/**
+ * @file commands.cpp
+ * @brief Implementation of the sentence adapters over Geralt's typed calls.
+ *
+ * Token positions follow the syntax vectors in parser.h: a list of "<quantity> <name>"
+ * pairs takes three tokens per entry because of the separating commas.
+ */
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "commands.h"
+#include "geralt.h"
+#include "parser.h"
+#include "querycache.h"
+#include "arena.h"
+#include "output.h"
+#include "planner.h"
+#include "optimizer.h"
+#include "formulamatrix.h"
+
+using namespace std;
+
+namespace {
+
+/// Argument lists and query results only live until the command has run, so they are built in the command arena.
+typedef pmr::vector<ItemCount> ItemList;
+
+/**
+ * @brief Writes an answer to the current output sink.
+ *
+ * @param answer Answer text without a line terminator.
+ */
+void printAnswer(string_view answer) {
+    OutputSink& sink = Output::sink();
+    sink.write(answer);
+    sink.endAnswer();
+}
+
+/**
+ * @brief Writes an answer that ends with a name, such as "Geralt defeats <monster>".
+ */
+void printAnswer(string_view prefix, string_view name) {
+    OutputSink& sink = Output::sink();
+    sink.write(prefix);
+    sink.write(name);
+    sink.endAnswer();
+}
+
+/**
+ * @brief Collects "<quantity> <name>" pairs separated by commas.
+ *
+ * @param tokenList Tokenized input line.
+ * @param first Index of the quantity of the first pair.
+ * @param last Index one past the last pair.
+ * @param items Receives the pairs.
+ */
+void collectItems(const TokenList& tokenList, size_t first, size_t last, ItemList& items) {
+    for (size_t i = first; i + 1 < last; i += 3) {
+        items.push_back({tokenList[i + 1].getContent(), stoi(tokenList[i].getContent())});
+    }
+}
+
+/**
+ * @brief Renders the answer to a specific quantity query and memoizes it.
+ *
+ * An existing entity's answer stays valid while the entity's generation is unchanged;
+ * the "0" answer for an unknown name stays valid until a new name joins the collection.
+ *
+ * @param action Query action used as the cache key.
+ * @param name Queried name.
+ * @param collection Map that is queried.
+ * @param membership Membership generation of that map.
+ * @return const string& The rendered answer.
+ */
+template <typename Entity>
+const string& renderQuantity(ParserActionType action, const string& name,
+                             EntityMap<Entity>& collection, const uint64_t& membership) {
+    if (const string* cached = QueryCache::find(action, name)) {
+        return *cached;
+    }
+
+    auto it = collection.find(name);
+
+    // Entity is not in the inventory
+    if (it == collection.end()) {
+        return QueryCache::store(action, name, "0", QueryCache::on(membership));
+    }
+
+    // Entity is in the inventory, its quantity is the answer
+    string answer;
+    appendInteger(answer, it->second->getQuantity());
+    return QueryCache::store(action, name, move(answer), QueryCache::on(it->second));
+}
+
+/**
+ * @brief Renders a full inventory listing and memoizes it until the collection changes.
+ *
+ * Entities are listed in alphabetical order as "<quantity> <name>", skipping the ones
+ * whose quantity is 0, or "None" when nothing is left.
+ *
+ * @param action Query action used as the cache key.
+ * @param stockOf Geralt's listing function of the collection.
+ * @param contents Contents generation of that collection.
+ * @return const string& The rendered answer.
+ */
+const string& renderListing(ParserActionType action, void (*stockOf)(pmr::vector<ItemCount>&), const uint64_t& contents) {
+    if (const string* cached = QueryCache::find(action, "")) {
+        return *cached;
+    }
+
+    ItemList stock(CommandArena::resource());
+    stockOf(stock);
+
+    string output;
+    // For each entity in stock, print out the name with its quantity
+    for (const ItemCount& item : stock) {
+        if (!output.empty()) {
+            output.append(", ");
+        }
+        appendInteger(output, item.quantity);
+        output.append(" ").append(item.name);
+    }
+
+    // If there is nothing in stock, print None
+    if (output.empty()) {
+        output = "None";
+    }
+
+    return QueryCache::store(action, "", move(output), QueryCache::on(contents));
+}
+
+/**
+ * @brief Prints the outcome of learning an effectiveness.
+ *
+ * @param result Result of the learn call.
+ * @param monsterName Monster whose bestiary entry was concerned.
+ */
+void printEffectivenessResult(LearnResult result, string_view monsterName) {
+    switch (result) {
+        case LEARN_NEW_ENTRY:
+            printAnswer("New bestiary entry added: ", monsterName);
+            break;
+        case LEARN_UPDATED:
+            printAnswer("Bestiary entry updated: ", monsterName);
+            break;
+        case LEARN_ALREADY_KNOWN:
+            printAnswer("Already known effectiveness");
+            break;
+    }
+}
+
+/**
+ * @brief Writes "<quantity> <name>" pairs separated by commas, the list syntax of the commands.
+ */
+void writeItems(OutputSink& sink, Span<ItemCount> items) {
+    for (size_t i = 0; i < items.size(); i++) {
+        if (i > 0) {
+            sink.write(", ");
+        }
+        sink.write(items[i].quantity);
+        sink.write(" ");
+        sink.write(items[i].name);
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Handles the loot action.
+ *
+ * Outputs: “Alchemy ingredients obtained”
+ *
+ * @param tokenList Tokenized user input line.
+ */
+void Commands::loot(const TokenList& tokenList) {
+    ItemList ingredientList(CommandArena::resource());
+    collectItems(tokenList, 2, tokenList.size(), ingredientList);
+
+    loot(ingredientList);
+}
+
+/**
+ * @brief Handles the loot action with its ingredients given.
+ *
+ * @param ingredientList Looted ingredients with their quantities.
+ */
+void Commands::loot(Span<ItemCount> ingredientList) {
+    Geralt::loot(ingredientList);
+
+    // Print the output
+    printAnswer("Alchemy ingredients obtained");
+}
+
+/**
+ * @brief Processes a **trade** action.
+ *
+ * Outputs:
+ * “Trade successful” on success
+ * “Not enough trophies” on failure
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::trade(const TokenList& tokenList) {
+    ItemList trophyList(CommandArena::resource());
+    ItemList ingredientList(CommandArena::resource());
+
+    // The trophy list ends at the "trophy" keyword, followed by "for" and the ingredient list
+    size_t trophyKeyword = 2;
+    while (tokenList[trophyKeyword].getType() != TOKEN_TROPHY) {
+        trophyKeyword++;
+    }
+    collectItems(tokenList, 2, trophyKeyword, trophyList);
+    collectItems(tokenList, trophyKeyword + 2, tokenList.size(), ingredientList);
+
+    trade(trophyList, ingredientList);
+}
+
+/**
+ * @brief Processes a trade action with its lists given.
+ *
+ * @param trophyList Trophies given away.
+ * @param ingredientList Ingredients received.
+ */
+void Commands::trade(Span<ItemCount> trophyList, Span<ItemCount> ingredientList) {
+    if (Geralt::trade(trophyList, ingredientList) == TRADE_SUCCESSFUL) {
+        printAnswer("Trade successful");
+    } else {
+        printAnswer("Not enough trophies");
+    }
+}
+
+/**
+ * @brief Handles the **brew** action.
+ *
+ * Outputs “Alchemy item created: <potion>”, “Not enough ingredients” or “No formula for <potion>”.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::brew(const TokenList& tokenList) {
+    brew(tokenList[2].getContent());
+}
+
+/**
+ * @brief Handles the brew action for a given potion.
+ *
+ * @param potionName Potion to brew.
+ */
+void Commands::brew(string_view potionName) {
+    switch (Geralt::brew(potionName).status) {
+        case BREW_CREATED:
+            printAnswer("Alchemy item created: ", potionName);
+            break;
+        case BREW_NOT_ENOUGH_INGREDIENTS:
+            printAnswer("Not enough ingredients");
+            break;
+        case BREW_NO_FORMULA:
+            printAnswer("No formula for ", potionName);
+            break;
+    }
+}
+
+/**
+ * @brief Registers a new sign as effective against a monster in the bestiary.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::learnSign(const TokenList& tokenList) {
+    learnSign(tokenList[2].getContent(), tokenList[7].getContent());
+}
+
+/**
+ * @brief Registers a sign as effective against a monster, both given by name.
+ *
+ * @param signName Effective sign.
+ * @param monsterName Monster it is effective against.
+ */
+void Commands::learnSign(string_view signName, string_view monsterName) {
+    printEffectivenessResult(Geralt::learnSign(signName, monsterName), monsterName);
+}
+
+/**
+ * @brief Registers a new potion as effective against a monster in the bestiary and potion inventory.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::learnPotion(const TokenList& tokenList) {
+    learnPotion(tokenList[2].getContent(), tokenList[7].getContent());
+}
+
+/**
+ * @brief Registers a potion as effective against a monster, both given by name.
+ *
+ * @param potionName Effective potion.
+ * @param monsterName Monster it is effective against.
+ */
+void Commands::learnPotion(string_view potionName, string_view monsterName) {
+    printEffectivenessResult(Geralt::learnPotion(potionName, monsterName), monsterName);
+}
+
+/**
+ * @brief Learns and stores a new alchemy formula for a potion.
+ *
+ * Outputs “New alchemy formula obtained: <potion>” or “Already known formula”.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::learnFormula(const TokenList& tokenList) {
+    ItemList ingredientList(CommandArena::resource());
+    collectItems(tokenList, 6, tokenList.size(), ingredientList);
+
+    learnFormula(tokenList[2].getContent(), ingredientList);
+}
+
+/**
+ * @brief Learns a formula given as a potion and its ingredients.
+ *
+ * @param potionName Potion of the formula.
+ * @param ingredientList Ingredients of the formula with their quantities.
+ */
+void Commands::learnFormula(string_view potionName, Span<ItemCount> ingredientList) {
+    if (Geralt::learnFormula(potionName, ingredientList) == LEARN_NEW_ENTRY) {
+        printAnswer("New alchemy formula obtained: ", potionName);
+    } else {
+        printAnswer("Already known formula");
+    }
+}
+
+/**
+ * @brief Resolves a monster encounter.
+ *
+ * Outputs “Geralt defeats <monster>” or “Geralt is unprepared and barely escapes with his life”.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::encounter(const TokenList& tokenList) {
+    encounter(tokenList[3].getContent());
+}
+
+/**
+ * @brief Resolves an encounter with a monster given by name.
+ *
+ * @param monsterName Monster encountered.
+ */
+void Commands::encounter(string_view monsterName) {
+    if (Geralt::encounter(monsterName) == ENCOUNTER_DEFEATED) {
+        printAnswer("Geralt defeats ", monsterName);
+    } else {
+        printAnswer("Geralt is unprepared and barely escapes with his life");
+    }
+}
+
+/**
+ * @brief Prints the quantity of the given ingredient.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::querySpecificIngredient(const TokenList& tokenList) {
+    querySpecificIngredient(tokenList[2].getContent());
+}
+
+/**
+ * @brief Prints the quantity of the ingredient with the given name.
+ *
+ * @param name Queried ingredient.
+ */
+void Commands::querySpecificIngredient(const string& name) {
+    printAnswer(renderQuantity(TOTAL_SPECIFIC_INGREDIENT_QUERY, name, Geralt::getIngredients(),
+                               Geralt::getIngredientGenerations().membership));
+}
+
+/**
+ * @brief Prints the quantity of the given potion.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::querySpecificPotion(const TokenList& tokenList) {
+    querySpecificPotion(tokenList[2].getContent());
+}
+
+/**
+ * @brief Prints the quantity of the potion with the given name.
+ *
+ * @param name Queried potion.
+ */
+void Commands::querySpecificPotion(const string& name) {
+    printAnswer(renderQuantity(TOTAL_SPECIFIC_POTION_QUERY, name, Geralt::getPotions(),
+                               Geralt::getPotionGenerations().membership));
+}
+
+/**
+ * @brief Prints the quantity of the given trophy.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::querySpecificTrophy(const TokenList& tokenList) {
+    querySpecificTrophy(tokenList[2].getContent());
+}
+
+/**
+ * @brief Prints the quantity of the trophy with the given name.
+ *
+ * @param name Queried trophy.
+ */
+void Commands::querySpecificTrophy(const string& name) {
+    printAnswer(renderQuantity(TOTAL_SPECIFIC_TROPHY_QUERY, name, Geralt::getTrophies(),
+                               Geralt::getTrophyGenerations().membership));
+}
+
+/**
+ * @brief Prints all the ingredients and their quantities.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::queryAllIngredients(const TokenList& tokenList) {
+    printAnswer(renderListing(TOTAL_ALL_INGREDIENT_QUERY, Geralt::ingredientStock, Geralt::getIngredientGenerations().contents));
+}
+
+/**
+ * @brief Prints all the potions and their quantities.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::queryAllPotions(const TokenList& tokenList) {
+    printAnswer(renderListing(TOTAL_ALL_POTION_QUERY, Geralt::potionStock, Geralt::getPotionGenerations().contents));
+}
+
+/**
+ * @brief Prints all the trophies and their quantities.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::queryAllTrophies(const TokenList& tokenList) {
+    printAnswer(renderListing(TOTAL_ALL_TROPHY_QUERY, Geralt::trophyStock, Geralt::getTrophyGenerations().contents));
+}
+
+/**
+ * @brief Lists all known effective signs and potions against a monster.
+ *
+ * Prints them comma‑separated in alphabetical order, or “No knowledge of <monster>” if none exist.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::queryEffectiveness(const TokenList& tokenList) {
+    queryEffectiveness(tokenList[4].getContent());
+}
+
+/**
+ * @brief Lists the effective signs and potions against a monster given by name.
+ *
+ * @param monsterName Queried monster.
+ */
+void Commands::queryEffectiveness(const string& monsterName) {
+    if (const string* cached = QueryCache::find(BESTIARY_QUERY, monsterName)) {
+        printAnswer(*cached);
+        return;
+    }
+
+    auto& monsters = Geralt::getMonsters();
+    auto monster = monsters.find(monsterName);
+
+    // If the monster is not present in the monsters map, there is no knowledge about effective signs or potions
+    if (monster == monsters.end()) {
+        printAnswer(QueryCache::store(BESTIARY_QUERY, monsterName, "No knowledge of " + monsterName,
+                                      QueryCache::on(Geralt::getMonsterGenerations().membership)));
+        return;
+    }
+
+    pmr::vector<string_view> effective(CommandArena::resource());
+    Geralt::effectiveAgainst(monsterName, effective);
+
+    string output;
+
+    // Effective signs and potions are printed
+    for (string_view name : effective) {
+        if (!output.empty()) {
+            output.append(", ");
+        }
+        output.append(name);
+    }
+    // If the total size is zero, then there is no knowledge of signs or potions
+    if (effective.empty()) {
+        output = "No knowledge of " + monsterName;
+    }
+
+    printAnswer(QueryCache::store(BESTIARY_QUERY, monsterName, move(output), QueryCache::on(monster->second)));
+}
+
+/**
+ * @brief Prints the sorted formula for a potion.
+ *
+ * Sorts potions by descending quantity, secondary ascending by name.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryFormula(const TokenList& tokenList) {
+    queryFormula(tokenList[3].getContent());
+}
+
+/**
+ * @brief Prints the sorted formula of a potion given by name.
+ *
+ * @param potionName Queried potion.
+ */
+void Commands::queryFormula(const string& potionName) {
+    if (const string* cached = QueryCache::find(ALCHEMY_QUERY, potionName)) {
+        printAnswer(*cached);
+        return;
+    }
+
+    auto& potions = Geralt::getPotions();
+    auto potion = potions.find(potionName);
+
+    // If the potion does not exist, there is no formula for that
+    if (potion == potions.end()) {
+        printAnswer(QueryCache::store(ALCHEMY_QUERY, potionName, "No formula for " + potionName,
+                                      QueryCache::on(Geralt::getPotionGenerations().membership)));
+        return;
+    }
+
+    ItemList ingredientList(CommandArena::resource());
+
+    string output;
+
+    // If there is a formula that is defined, print it
+    if (Geralt::formula(potionName, ingredientList)) {
+        for (const ItemCount& ingredient : ingredientList) {
+            if (!output.empty()) {
+                output.append(", ");
+            }
+            appendInteger(output, ingredient.quantity);
+            output.append(" ").append(ingredient.name);
+        }
+    }
+    // If there is not a formula that is defined, print no formula
+    else {
+        output = "No formula for " + potionName;
+    }
+
+    printAnswer(QueryCache::store(ALCHEMY_QUERY, potionName, move(output), QueryCache::on(potion->second)));
+}
+
+/**
+ * @brief Prints the cheapest plan that gets Geralt ready for a monster.
+ *
+ * Outputs “Geralt is ready with <sign> sign” or “... with <potion> potion”, the commands
+ * to run, such as “Geralt trades 2 Harpy trophy for 1 Rebis; Geralt brews Swallow”,
+ * “Geralt cannot prepare for <monster>” or “No knowledge of <monster>”.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryPlan(const TokenList& tokenList) {
+    queryPlan(tokenList[5].getContent());
+}
+
+/**
+ * @brief Prints the cheapest plan for a monster given by name.
+ *
+ * @param monsterName Monster to prepare for.
+ */
+void Commands::queryPlan(string_view monsterName) {
+    const Plan& plan = Planner::prepare(monsterName);
+    OutputSink& sink = Output::sink();
+
+    switch (plan.status) {
+        case PLAN_READY:
+            sink.write("Geralt is ready with ");
+            sink.write(plan.means);
+            sink.write(plan.isSign ? " sign" : " potion");
+            break;
+        case PLAN_TRADE_AND_BREW:
+            sink.write("Geralt trades ");
+            writeItems(sink, plan.trophies);
+            sink.write(" trophy for ");
+            writeItems(sink, plan.ingredients);
+            sink.write("; ");
+            // The trade is followed by the brew
+            [[fallthrough]];
+        case PLAN_BREW:
+            sink.write("Geralt brews ");
+            sink.write(plan.means);
+            break;
+        case PLAN_IMPOSSIBLE:
+            sink.write("Geralt cannot prepare for ");
+            sink.write(monsterName);
+            break;
+        case PLAN_UNKNOWN_MONSTER:
+            sink.write("No knowledge of ");
+            sink.write(monsterName);
+            break;
+    }
+    sink.endAnswer();
+}
+
+/**
+ * @brief Prints the mix of potions that yields the most potions from the current stock.
+ *
+ * Outputs “<total> potions: <count> <potion>, ...” in alphabetical order, or “None” when
+ * no potion can be brewed. If the search stopped before proving the mix optimal, the
+ * bound follows as “ (at most <bound>)”.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryBrewMix(const TokenList&) {
+    const BrewMix& mix = BrewOptimizer::maximize();
+    OutputSink& sink = Output::sink();
+
+    if (mix.value == 0) {
+        sink.write("None");
+    } else {
+        sink.write(mix.value);
+        sink.write(mix.value == 1 ? " potion: " : " potions: ");
+        writeItems(sink, mix.potions);
+    }
+
+    if (mix.bound > mix.value) {
+        sink.write(" (at most ");
+        sink.write(mix.bound);
+        sink.write(")");
+    }
+    sink.endAnswer();
+}
+
+/**
+ * @brief Prints the ingredients missing to brew a list of potions.
+ *
+ * Outputs the missing quantities like an alchemy answer, by descending quantity and then
+ * by name, “Nothing” if the stock covers every formula, or “No formula for <potion>” for
+ * the first listed potion without a formula.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryShoppingList(const TokenList& tokenList) {
+    ItemList potionList(CommandArena::resource());
+    collectItems(tokenList, 5, tokenList.size() - 1, potionList);
+
+    queryShoppingList(potionList);
+}
+
+/**
+ * @brief Prints the ingredients missing to brew a given list of potions.
+ *
+ * @param potionList Potions to brew with the number of each.
+ */
+void Commands::queryShoppingList(Span<ItemCount> potionList) {
+    ItemList missing(CommandArena::resource());
+    string_view unknown = FormulaMatrix::current().shortfall(potionList, missing);
+    OutputSink& sink = Output::sink();
+
+    if (!unknown.empty()) {
+        sink.write("No formula for ");
+        sink.write(unknown);
+    } else if (missing.empty()) {
+        sink.write("Nothing");
+    } else {
+        writeItems(sink, missing);
+    }
+    sink.endAnswer();
+}
+
+namespace {
+
+/**
+ * @brief Prints a ranked listing: the largest stocks for "Top", the smallest for "Bottom".
+ *
+ * Entities are listed as "<quantity> <name>" by quantity, ties in alphabetical order,
+ * or "None" when nothing is in stock.
+ *
+ * @param scarcest Lists the smallest stocks instead of the largest.
+ * @param count Number of entities to list.
+ * @param ranked Geralt's ranked listing function of the collection.
+ */
+void printRanked(bool scarcest, size_t count, void (*ranked)(size_t, bool, pmr::vector<ItemCount>&)) {
+    ItemList items(CommandArena::resource());
+    ranked(count, scarcest, items);
+
+    if (items.empty()) {
+        printAnswer("None");
+        return;
+    }
+
+    OutputSink& sink = Output::sink();
+    writeItems(sink, items);
+    sink.endAnswer();
+}
+
+} // namespace
+
+/**
+ * @brief Prints the ingredients with the largest or smallest quantities.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryRankedIngredients(const TokenList& tokenList) {
+    queryRankedIngredients(tokenList[0].getContent() == "Bottom", stoul(tokenList[1].getContent()));
+}
+
+/**
+ * @brief Prints the @p count ingredients with the largest or, if @p scarcest, the smallest quantities.
+ */
+void Commands::queryRankedIngredients(bool scarcest, size_t count) {
+    printRanked(scarcest, count, Geralt::rankedIngredients);
+}
+
+/**
+ * @brief Prints the potions with the largest or smallest quantities.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryRankedPotions(const TokenList& tokenList) {
+    queryRankedPotions(tokenList[0].getContent() == "Bottom", stoul(tokenList[1].getContent()));
+}
+
+/**
+ * @brief Prints the @p count potions with the largest or, if @p scarcest, the smallest quantities.
+ */
+void Commands::queryRankedPotions(bool scarcest, size_t count) {
+    printRanked(scarcest, count, Geralt::rankedPotions);
+}
+
+/**
+ * @brief Prints the trophies with the largest or smallest quantities.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryRankedTrophies(const TokenList& tokenList) {
+    queryRankedTrophies(tokenList[0].getContent() == "Bottom", stoul(tokenList[1].getContent()));
+}
+
+/**
+ * @brief Prints the @p count trophies with the largest or, if @p scarcest, the smallest quantities.
+ */
+void Commands::queryRankedTrophies(bool scarcest, size_t count) {
+    printRanked(scarcest, count, Geralt::rankedTrophies);
+}
+
+namespace {
+
+/**
+ * @brief Prints the quantities of every name of a multi-get query, in the order they were asked.
+ *
+ * Outputs the quantities separated by commas on one line; unknown names count 0.
+ *
+ * @param names Queried names.
+ * @param quantities Geralt's multi-get function of the collection.
+ */
+void printQuantities(Span<string_view> names, void (*quantities)(Span<string_view>, pmr::vector<int>&)) {
+    pmr::vector<int> values(CommandArena::resource());
+    quantities(names, values);
+
+    OutputSink& sink = Output::sink();
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0) {
+            sink.write(", ");
+        }
+        sink.write(values[i]);
+    }
+    sink.endAnswer();
+}
+
+/// Collects the names of a multi-get query, at every other token from index 2.
+void collectNames(const TokenList& tokenList, pmr::vector<string_view>& names) {
+    names.reserve(tokenList.size() / 2);
+    for (size_t i = 2; i + 1 < tokenList.size(); i += 2) {
+        names.push_back(tokenList[i].getContent());
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Prints the quantities of several ingredients on one line.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryMultipleIngredients(const TokenList& tokenList) {
+    pmr::vector<string_view> names(CommandArena::resource());
+    collectNames(tokenList, names);
+    queryMultipleIngredients(names);
+}
+
+/**
+ * @brief Prints the quantities of the given ingredients on one line.
+ */
+void Commands::queryMultipleIngredients(Span<string_view> names) {
+    printQuantities(names, Geralt::ingredientQuantities);
+}
+
+/**
+ * @brief Prints the quantities of several potions on one line.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryMultiplePotions(const TokenList& tokenList) {
+    pmr::vector<string_view> names(CommandArena::resource());
+    collectNames(tokenList, names);
+    queryMultiplePotions(names);
+}
+
+/**
+ * @brief Prints the quantities of the given potions on one line.
+ */
+void Commands::queryMultiplePotions(Span<string_view> names) {
+    printQuantities(names, Geralt::potionQuantities);
+}
+
+/**
+ * @brief Prints the quantities of several trophies on one line.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryMultipleTrophies(const TokenList& tokenList) {
+    pmr::vector<string_view> names(CommandArena::resource());
+    collectNames(tokenList, names);
+    queryMultipleTrophies(names);
+}
+
+/**
+ * @brief Prints the quantities of the given trophies on one line.
+ */
+void Commands::queryMultipleTrophies(Span<string_view> names) {
+    printQuantities(names, Geralt::trophyQuantities);
+}
+
+namespace {
+
+/**
+ * @brief Prints the names found by a name search: by prefix for "Complete", by similarity for "Suggest".
+ *
+ * Names are separated by commas, or "None" when nothing matches.
+ *
+ * @param similar Searches by similarity instead of by prefix.
+ * @param text Searched text.
+ * @param search Geralt's name search function of the collection.
+ */
+void printNameSearch(bool similar, string_view text, void (*search)(string_view, bool, pmr::vector<string_view>&)) {
+    pmr::vector<string_view> names(CommandArena::resource());
+    search(text, similar, names);
+
+    if (names.empty()) {
+        printAnswer("None");
+        return;
+    }
+
+    OutputSink& sink = Output::sink();
+    for (size_t i = 0; i < names.size(); i++) {
+        if (i > 0) {
+            sink.write(", ");
+        }
+        sink.write(names[i]);
+    }
+    sink.endAnswer();
+}
+
+} // namespace
+
+/**
+ * @brief Prints the ingredient names that start with, or are close to, the given text.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::searchIngredientNames(const TokenList& tokenList) {
+    searchIngredientNames(tokenList[0].getContent() == "Suggest", tokenList[2].getContent());
+}
+
+/**
+ * @brief Prints the ingredient names that start with, or if @p similar are close to, @p text.
+ */
+void Commands::searchIngredientNames(bool similar, string_view text) {
+    printNameSearch(similar, text, Geralt::ingredientNamesLike);
+}
+
+/**
+ * @brief Prints the potion names that start with, or are close to, the given text.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::searchPotionNames(const TokenList& tokenList) {
+    searchPotionNames(tokenList[0].getContent() == "Suggest", tokenList[2].getContent());
+}
+
+/**
+ * @brief Prints the potion names that start with, or if @p similar are close to, @p text.
+ */
+void Commands::searchPotionNames(bool similar, string_view text) {
+    printNameSearch(similar, text, Geralt::potionNamesLike);
+}
+
+/**
+ * @brief Prints the trophy names that start with, or are close to, the given text.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::searchTrophyNames(const TokenList& tokenList) {
+    searchTrophyNames(tokenList[0].getContent() == "Suggest", tokenList[2].getContent());
+}
+
+/**
+ * @brief Prints the trophy names that start with, or if @p similar are close to, @p text.
+ */
+void Commands::searchTrophyNames(bool similar, string_view text) {
+    printNameSearch(similar, text, Geralt::trophyNamesLike);
+}
+
+namespace {
+
+/**
+ * @brief Answers a past query that the history cannot answer.
+ *
+ * Outputs “History is disabled” when no history is kept, or “Line <n> has not run yet”
+ * for a line after the current one, instead of passing the current state off as a past one.
+ *
+ * @param line Line the query asks about.
+ * @return true If an answer has been printed.
+ */
+bool rejectPastQuery(uint64_t line) {
+    if (!Geralt::isHistoryEnabled()) {
+        printAnswer("History is disabled");
+        return true;
+    }
+
+    if (line > Geralt::getVersion()) {
+        OutputSink& sink = Output::sink();
+        sink.write("Line ");
+        sink.write(line);
+        sink.write(" has not run yet");
+        sink.endAnswer();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Prints a listing of a collection as it was after an earlier line, like "Total <collection>?".
+ *
+ * Past states change no more, but the answers are not memoized: each line number would
+ * need an entry of its own.
+ *
+ * @param line Line after which the collection is listed.
+ * @param stockAt Geralt's past listing function of the collection.
+ */
+void printStockAt(uint64_t line, void (*stockAt)(uint64_t, pmr::vector<ItemCount>&)) {
+    if (rejectPastQuery(line)) {
+        return;
+    }
+
+    ItemList stock(CommandArena::resource());
+    stockAt(line, stock);
+
+    if (stock.empty()) {
+        printAnswer("None");
+        return;
+    }
+
+    OutputSink& sink = Output::sink();
+    writeItems(sink, stock);
+    sink.endAnswer();
+}
+
+/**
+ * @brief Prints the quantity of one entity after an earlier line, like "Total <collection> <name>?".
+ *
+ * @param name Queried name.
+ * @param line Line after which the quantity is read.
+ * @param quantityAt Geralt's past quantity function of the collection.
+ */
+void printQuantityAt(string_view name, uint64_t line, int (*quantityAt)(string_view, uint64_t)) {
+    if (rejectPastQuery(line)) {
+        return;
+    }
+
+    OutputSink& sink = Output::sink();
+    sink.write(quantityAt(name, line));
+    sink.endAnswer();
+}
+
+} // namespace
+
+/**
+ * @brief Prints all the ingredients and their quantities after the given line.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryAllIngredientsAt(const TokenList& tokenList) {
+    queryAllIngredientsAt(stoull(tokenList.back().getContent()));
+}
+
+/**
+ * @brief Prints all the ingredients and their quantities after line @p line.
+ */
+void Commands::queryAllIngredientsAt(uint64_t line) {
+    printStockAt(line, Geralt::ingredientStockAt);
+}
+
+/**
+ * @brief Prints all the potions and their quantities after the given line.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryAllPotionsAt(const TokenList& tokenList) {
+    queryAllPotionsAt(stoull(tokenList.back().getContent()));
+}
+
+/**
+ * @brief Prints all the potions and their quantities after line @p line.
+ */
+void Commands::queryAllPotionsAt(uint64_t line) {
+    printStockAt(line, Geralt::potionStockAt);
+}
+
+/**
+ * @brief Prints all the trophies and their quantities after the given line.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryAllTrophiesAt(const TokenList& tokenList) {
+    queryAllTrophiesAt(stoull(tokenList.back().getContent()));
+}
+
+/**
+ * @brief Prints all the trophies and their quantities after line @p line.
+ */
+void Commands::queryAllTrophiesAt(uint64_t line) {
+    printStockAt(line, Geralt::trophyStockAt);
+}
+
+/**
+ * @brief Prints the quantity of the given ingredient after the given line.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::querySpecificIngredientAt(const TokenList& tokenList) {
+    querySpecificIngredientAt(tokenList[2].getContent(), stoull(tokenList.back().getContent()));
+}
+
+/**
+ * @brief Prints the quantity of the ingredient @p name after line @p line.
+ */
+void Commands::querySpecificIngredientAt(string_view name, uint64_t line) {
+    printQuantityAt(name, line, Geralt::ingredientQuantityAt);
+}
+
+/**
+ * @brief Prints the quantity of the given potion after the given line.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::querySpecificPotionAt(const TokenList& tokenList) {
+    querySpecificPotionAt(tokenList[2].getContent(), stoull(tokenList.back().getContent()));
+}
+
+/**
+ * @brief Prints the quantity of the potion @p name after line @p line.
+ */
+void Commands::querySpecificPotionAt(string_view name, uint64_t line) {
+    printQuantityAt(name, line, Geralt::potionQuantityAt);
+}
+
+/**
+ * @brief Prints the quantity of the given trophy after the given line.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::querySpecificTrophyAt(const TokenList& tokenList) {
+    querySpecificTrophyAt(tokenList[2].getContent(), stoull(tokenList.back().getContent()));
+}
+
+/**
+ * @brief Prints the quantity of the trophy @p name after line @p line.
+ */
+void Commands::querySpecificTrophyAt(string_view name, uint64_t line) {
+    printQuantityAt(name, line, Geralt::trophyQuantityAt);
+}
+
+namespace {
+
+/**
+ * @class OpenAnswerSink
+ * @brief Passes an answer on to another sink without ending it, so that more can be appended to it.
+ */
+class OpenAnswerSink : public OutputSink {
+private:
+    OutputSink& target;
+
+public:
+    explicit OpenAnswerSink(OutputSink& target) : target(target) {}
+
+    using OutputSink::write;
+    void write(string_view text) override { target.write(text); }
+    void endAnswer() override {}
+};
+
+/**
+ * @struct WhatIfSentence
+ * @brief The action of a "What if" sentence, as it would be tokenized on its own line.
+ */
+struct WhatIfSentence {
+    ParserActionType action;
+    const TokenList& tokenList;
+};
+
+/**
+ * @brief Runs a state-changing action with the adapter of its sentence.
+ *
+ * @param context The WhatIfSentence to run.
+ */
+void runSentence(void* context) {
+    const WhatIfSentence& sentence = *static_cast<const WhatIfSentence*>(context);
+    const TokenList& tokenList = sentence.tokenList;
+
+    switch (sentence.action) {
+        case LOOT_ACTION: Commands::loot(tokenList); break;
+        case TRADE_ACTION: Commands::trade(tokenList); break;
+        case BREW_ACTION: Commands::brew(tokenList); break;
+        case KNOWLEDGE_EFFECTIVENESS_SIGN: Commands::learnSign(tokenList); break;
+        case KNOWLEDGE_EFFECTIVENESS_POTION: Commands::learnPotion(tokenList); break;
+        case KNOWLEDGE_POTION_FORMULA: Commands::learnFormula(tokenList); break;
+        case ENCOUNTER: Commands::encounter(tokenList); break;
+        default: break;
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Runs an action without keeping its effects.
+ *
+ * Outputs the answer the action would give, followed by the quantities it would
+ * change, in parentheses: “Trade successful (1 Quebrith, 0 Harpy)”. The action runs
+ * on the live state and Geralt puts back every entity it touched afterwards.
+ *
+ * @param tokenList Tokenized query line.
+ */
+void Commands::queryWhatIf(const TokenList& tokenList) {
+    // The action between "What if" and the question mark, as it would be tokenized on its own line
+    TokenList actionTokens(tokenList.begin() + 2, tokenList.end() - 1, CommandArena::resource());
+    WhatIfSentence sentence{*matchCommand(actionTokens), actionTokens};
+
+    queryWhatIf(runSentence, &sentence);
+}
+
+/**
+ * @brief Runs an action without keeping its effects, given as a function that runs it.
+ *
+ * @param run Runs the action and prints its answer.
+ * @param context Argument of @p run.
+ */
+void Commands::queryWhatIf(void (*run)(void*), void* context) {
+    OutputSink& sink = Output::sink();
+    OpenAnswerSink answer(sink);
+
+    Geralt::beginWhatIf();
+    OutputSink* previous = Output::redirect(&answer);
+    run(context);
+    Output::redirect(previous);
+
+    ItemList changes(CommandArena::resource());
+    Geralt::whatIfChanges(changes);
+    if (!changes.empty()) {
+        sink.write(" (");
+        for (size_t i = 0; i < changes.size(); i++) {
+            if (i > 0) {
+                sink.write(", ");
+            }
+            sink.write(changes[i].quantity);
+            sink.write(" ");
+            sink.write(changes[i].name);
+        }
+        sink.write(")");
+    }
+    Geralt::discardWhatIf();
+
+    sink.endAnswer();
+}
+
+/**
+ * @brief Opens a transaction: the actions until "Commit" or "Rollback" apply together or not at all.
+ *
+ * Outputs “Transaction started” or “Transaction already in progress”.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::beginTransaction(const TokenList&) {
+    if (Geralt::beginTransaction()) {
+        printAnswer("Transaction started");
+    } else {
+        printAnswer("Transaction already in progress");
+    }
+}
+
+/**
+ * @brief Keeps the changes of the open transaction.
+ *
+ * Outputs “Transaction committed” or “No transaction in progress”.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::commitTransaction(const TokenList&) {
+    if (Geralt::commitTransaction()) {
+        printAnswer("Transaction committed");
+    } else {
+        printAnswer("No transaction in progress");
+    }
+}
+
+/**
+ * @brief Undoes every change of the open transaction.
+ *
+ * Outputs “Transaction rolled back” or “No transaction in progress”.
+ *
+ * @param tokenList Tokenized input line.
+ */
+void Commands::rollbackTransaction(const TokenList&) {
+    if (Geralt::rollbackTransaction()) {
+        printAnswer("Transaction rolled back");
+    } else {
+        printAnswer("No transaction in progress");
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+/**
+ * @file commands.h
+ * @brief Declares the adapters between parsed sentences and Geralt's typed calls.
+ *
+ * Each function takes the refined tokens of a line that matched its grammar rule,
+ * pulls the names and quantities out of them, calls the corresponding typed method
+ * of Geralt and prints its result as the answer required by the specification.
+ * Query answers are rendered once and memoized in the QueryCache.
+ */
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "token.h"
+#include "geralt.h"
+
+/**
+ * @class Commands
+ * @brief Static entry points of the command language, one per grammar rule.
+ *
+ * Every sentence form has a typed form that takes the names and quantities themselves,
+ * for callers that never had a sentence, such as the compiled command replay. The
+ * sentence form pulls the arguments out of the tokens and calls the typed form, so both
+ * print the same answers.
+ */
+class Commands {
+public:
+    /// Functions that execute the corresponding action and print its outcome
+    static void loot(const TokenList& tokenList);
+    static void trade(const TokenList& tokenList);
+    static void brew(const TokenList& tokenList);
+    static void learnSign(const TokenList& tokenList);
+    static void learnPotion(const TokenList& tokenList);
+    static void learnFormula(const TokenList& tokenList);
+    static void encounter(const TokenList& tokenList);
+
+    static void loot(Span<ItemCount> ingredientList);
+    static void trade(Span<ItemCount> trophyList, Span<ItemCount> ingredientList);
+    static void brew(std::string_view potionName);
+    static void learnSign(std::string_view signName, std::string_view monsterName);
+    static void learnPotion(std::string_view potionName, std::string_view monsterName);
+    static void learnFormula(std::string_view potionName, Span<ItemCount> ingredientList);
+    static void encounter(std::string_view monsterName);
+
+    /// Functions that print the answer to the corresponding query
+    static void querySpecificIngredient(const TokenList& tokenList);
+    static void querySpecificPotion(const TokenList& tokenList);
+    static void querySpecificTrophy(const TokenList& tokenList);
+    static void queryAllIngredients(const TokenList& tokenList);
+    static void queryAllPotions(const TokenList& tokenList);
+    static void queryAllTrophies(const TokenList& tokenList);
+    static void queryEffectiveness(const TokenList& tokenList);
+    static void queryFormula(const TokenList& tokenList);
+    static void queryPlan(const TokenList& tokenList);
+    static void queryBrewMix(const TokenList& tokenList);
+    static void queryShoppingList(const TokenList& tokenList);
+    static void queryRankedIngredients(const TokenList& tokenList);
+    static void queryRankedPotions(const TokenList& tokenList);
+    static void queryRankedTrophies(const TokenList& tokenList);
+    static void queryMultipleIngredients(const TokenList& tokenList);
+    static void queryMultiplePotions(const TokenList& tokenList);
+    static void queryMultipleTrophies(const TokenList& tokenList);
+    static void searchIngredientNames(const TokenList& tokenList);
+    static void searchPotionNames(const TokenList& tokenList);
+    static void searchTrophyNames(const TokenList& tokenList);
+    static void queryAllIngredientsAt(const TokenList& tokenList);
+    static void queryAllPotionsAt(const TokenList& tokenList);
+    static void queryAllTrophiesAt(const TokenList& tokenList);
+    static void querySpecificIngredientAt(const TokenList& tokenList);
+    static void querySpecificPotionAt(const TokenList& tokenList);
+    static void querySpecificTrophyAt(const TokenList& tokenList);
+    static void queryWhatIf(const TokenList& tokenList);
+
+    // Names that key the QueryCache are strings, which is what the cache stores
+    static void querySpecificIngredient(const std::string& name);
+    static void querySpecificPotion(const std::string& name);
+    static void querySpecificTrophy(const std::string& name);
+    static void queryEffectiveness(const std::string& monsterName);
+    static void queryFormula(const std::string& potionName);
+    static void queryPlan(std::string_view monsterName);
+    static void queryShoppingList(Span<ItemCount> potionList);
+    static void queryRankedIngredients(bool scarcest, size_t count);
+    static void queryRankedPotions(bool scarcest, size_t count);
+    static void queryRankedTrophies(bool scarcest, size_t count);
+    static void queryMultipleIngredients(Span<std::string_view> names);
+    static void queryMultiplePotions(Span<std::string_view> names);
+    static void queryMultipleTrophies(Span<std::string_view> names);
+    static void searchIngredientNames(bool similar, std::string_view text);
+    static void searchPotionNames(bool similar, std::string_view text);
+    static void searchTrophyNames(bool similar, std::string_view text);
+    static void queryAllIngredientsAt(uint64_t line);
+    static void queryAllPotionsAt(uint64_t line);
+    static void queryAllTrophiesAt(uint64_t line);
+    static void querySpecificIngredientAt(std::string_view name, uint64_t line);
+    static void querySpecificPotionAt(std::string_view name, uint64_t line);
+    static void querySpecificTrophyAt(std::string_view name, uint64_t line);
+
+    /**
+     * @brief Typed form of queryWhatIf: runs an action without keeping its effects.
+     *
+     * @param run Runs the action through its typed form, which prints the answer.
+     * @param context Passed to @p run, typically the decoded arguments of the action.
+     */
+    static void queryWhatIf(void (*run)(void*), void* context);
+
+    /// Functions that open and close a transaction
+    static void beginTransaction(const TokenList& tokenList);
+    static void commitTransaction(const TokenList& tokenList);
+    static void rollbackTransaction(const TokenList& tokenList);
+};
+
+#endif
@@ -0,0 +1,520 @@
+/**
+ * @file compiler.cpp
+ * @brief Compilation of text command logs into binary records and their fast replay.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <optional>
+#include <cstring>
+
+#include "compiler.h"
+#include "token.h"
+#include "arena.h"
+#include "output.h"
+#include "geralt.h"
+#include "commands.h"
+#include "stats.h"
+
+using namespace std;
+
+optional<TokenList> tokenizeLine(const string&);
+
+CommandCompiler::CommandCompiler(ostream& out) : out_(out) {
+    uint32_t version = COMPILED_VERSION;
+    out_.write(COMPILED_MAGIC, sizeof(COMPILED_MAGIC));
+    out_.write(reinterpret_cast<const char*>(&version), sizeof(version));
+}
+
+void CommandCompiler::putVarint(uint64_t value) {
+    while (value >= 0x80) {
+        record_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    record_.push_back(static_cast<char>(value));
+}
+
+/**
+ * @brief Writes the ID of a name, defining the name first if it has not been seen yet.
+ *
+ * The definition is written straight to the output so that it precedes the record
+ * that is being assembled in record_.
+ */
+void CommandCompiler::putName(const string& name) {
+    auto it = nameIds_.find(name);
+
+    if (it == nameIds_.end()) {
+        string definition(1, static_cast<char>(OPCODE_NAME));
+        uint64_t length = name.size();
+        while (length >= 0x80) {
+            definition.push_back(static_cast<char>((length & 0x7F) | 0x80));
+            length >>= 7;
+        }
+        definition.push_back(static_cast<char>(length));
+        definition.append(name);
+        out_.write(definition.data(), definition.size());
+
+        it = nameIds_.emplace(name, static_cast<uint32_t>(nameIds_.size())).first;
+    }
+
+    putVarint(it->second);
+}
+
+/**
+ * @brief Encodes a comma separated `<quantity> <name>` list that starts at token @p i.
+ *
+ * @param tokens Refined tokens of the line.
+ * @param i Index of the first quantity; left at the first token after the list.
+ */
+void CommandCompiler::putList(const TokenList& tokens, size_t& i) {
+    size_t count = 0;
+    for (size_t j = i; j + 1 < tokens.size() && tokens[j].getType() == TOKEN_QUANTITY; j += 3) {
+        count++;
+        if (j + 2 >= tokens.size() || tokens[j + 2].getType() != TOKEN_COMMA) {
+            break;
+        }
+    }
+
+    putVarint(count);
+    for (size_t n = 0; n < count; n++, i += 3) {
+        putVarint(stoul(tokens[i].getContent()));
+        putName(tokens[i + 1].getContent());
+    }
+
+    // The loop steps over the comma that follows every pair, including the last one
+    i--;
+}
+
+bool CommandCompiler::compileLine(const string& line) {
+    CommandArena::Scope arena;
+    record_.clear();
+
+    optional<TokenList> tokensOpt = tokenizeLine(line);
+    optional<ParserActionType> action;
+    if (tokensOpt) {
+        action = matchCommand(*tokensOpt);
+    }
+
+    if (!action) {
+        record_.push_back(static_cast<char>(OPCODE_INVALID));
+        out_.write(record_.data(), record_.size());
+        return false;
+    }
+
+    record_.push_back(static_cast<char>(*action));
+    putOperands(*action, *tokensOpt);
+
+    out_.write(record_.data(), record_.size());
+    return true;
+}
+
+/**
+ * @brief Encodes the operands of an action, which follow its opcode in the record.
+ *
+ * @param action Action matched for the tokens.
+ * @param tokens Refined tokens of the line.
+ */
+void CommandCompiler::putOperands(ParserActionType action, const TokenList& tokens) {
+    size_t i;
+
+    switch (action) {
+        case LOOT_ACTION:
+            i = 2;
+            putList(tokens, i);
+            break;
+        case TRADE_ACTION:
+            i = 2;
+            putList(tokens, i);
+            i += 2; // "trophy for"
+            putList(tokens, i);
+            break;
+        case BREW_ACTION:
+            putName(tokens[2].getContent());
+            break;
+        case KNOWLEDGE_EFFECTIVENESS_SIGN:
+        case KNOWLEDGE_EFFECTIVENESS_POTION:
+            putName(tokens[2].getContent());
+            putName(tokens[7].getContent());
+            break;
+        case KNOWLEDGE_POTION_FORMULA:
+            putName(tokens[2].getContent());
+            i = 6;
+            putList(tokens, i);
+            break;
+        case ENCOUNTER:
+            putName(tokens[3].getContent());
+            break;
+        case TOTAL_SPECIFIC_INGREDIENT_QUERY:
+        case TOTAL_SPECIFIC_POTION_QUERY:
+        case TOTAL_SPECIFIC_TROPHY_QUERY:
+            putName(tokens[2].getContent());
+            break;
+        case BESTIARY_QUERY:
+            putName(tokens[4].getContent());
+            break;
+        case ALCHEMY_QUERY:
+            putName(tokens[3].getContent());
+            break;
+        case PLAN_QUERY:
+            putName(tokens[5].getContent());
+            break;
+        case SHOPPING_LIST_QUERY:
+            i = 5;
+            putList(tokens, i);
+            break;
+        case RANKED_INGREDIENT_QUERY:
+        case RANKED_POTION_QUERY:
+        case RANKED_TROPHY_QUERY:
+            putVarint(tokens[0].getContent() == "Bottom" ? 1 : 0);
+            putVarint(stoul(tokens[1].getContent()));
+            break;
+        case TOTAL_MULTI_INGREDIENT_QUERY:
+        case TOTAL_MULTI_POTION_QUERY:
+        case TOTAL_MULTI_TROPHY_QUERY:
+            // Names sit at every other token between the keyword and the question mark
+            putVarint(tokens.size() / 2 - 1);
+            for (i = 2; i + 1 < tokens.size(); i += 2) {
+                putName(tokens[i].getContent());
+            }
+            break;
+        case NAME_SEARCH_INGREDIENT_QUERY:
+        case NAME_SEARCH_POTION_QUERY:
+        case NAME_SEARCH_TROPHY_QUERY:
+            putVarint(tokens[0].getContent() == "Suggest" ? 1 : 0);
+            putName(tokens[2].getContent());
+            break;
+        case TOTAL_ALL_INGREDIENT_AT_QUERY:
+        case TOTAL_ALL_POTION_AT_QUERY:
+        case TOTAL_ALL_TROPHY_AT_QUERY:
+            putVarint(stoull(tokens[4].getContent()));
+            break;
+        case TOTAL_SPECIFIC_INGREDIENT_AT_QUERY:
+        case TOTAL_SPECIFIC_POTION_AT_QUERY:
+        case TOTAL_SPECIFIC_TROPHY_AT_QUERY:
+            putName(tokens[2].getContent());
+            putVarint(stoull(tokens[5].getContent()));
+            break;
+        case WHAT_IF_QUERY: {
+            // The nested action is encoded as its own record would be, opcode first
+            TokenList actionTokens(tokens.begin() + 2, tokens.end() - 1, CommandArena::resource());
+            ParserActionType nested = *matchCommand(actionTokens);
+            record_.push_back(static_cast<char>(nested));
+            putOperands(nested, actionTokens);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+namespace {
+
+/**
+ * @struct DecodedCommand
+ * @brief The operands of one compiled record, in the form the typed Commands entry points take.
+ *
+ * Names point into the decoder's table of interned names, and the lists live in the
+ * command arena, so decoding a record builds neither tokens nor strings.
+ */
+struct DecodedCommand {
+    ParserActionType action;
+    const string* name = nullptr;       ///< Potion, monster, sign or queried name
+    const string* monster = nullptr;    ///< Monster of a learned effectiveness
+    pmr::vector<ItemCount> items;       ///< Looted, received, learned or listed items
+    pmr::vector<ItemCount> trophies;    ///< Trophies given away in a trade
+    pmr::vector<string_view> names;     ///< Names of a multi-get query
+    uint64_t number = 0;                ///< Ranked count or history line
+    bool flag = false;                  ///< "Bottom" of a ranked query, "Suggest" of a name search
+
+    explicit DecodedCommand(ParserActionType action)
+        : action(action), items(CommandArena::resource()), trophies(CommandArena::resource()),
+          names(CommandArena::resource()) {}
+};
+
+/**
+ * @brief Calls the typed entry point of a decoded command, which prints its answer.
+ *
+ * @param context The DecodedCommand to run, passed untyped so that queryWhatIf() can call it back.
+ */
+void runDecoded(void* context) {
+    DecodedCommand& command = *static_cast<DecodedCommand*>(context);
+
+    switch (command.action) {
+        case LOOT_ACTION: Commands::loot(command.items); break;
+        case TRADE_ACTION: Commands::trade(command.trophies, command.items); break;
+        case BREW_ACTION: Commands::brew(*command.name); break;
+        case KNOWLEDGE_EFFECTIVENESS_SIGN: Commands::learnSign(*command.name, *command.monster); break;
+        case KNOWLEDGE_EFFECTIVENESS_POTION: Commands::learnPotion(*command.name, *command.monster); break;
+        case KNOWLEDGE_POTION_FORMULA: Commands::learnFormula(*command.name, command.items); break;
+        case ENCOUNTER: Commands::encounter(*command.name); break;
+        case TOTAL_SPECIFIC_INGREDIENT_QUERY: Commands::querySpecificIngredient(*command.name); break;
+        case TOTAL_SPECIFIC_POTION_QUERY: Commands::querySpecificPotion(*command.name); break;
+        case TOTAL_SPECIFIC_TROPHY_QUERY: Commands::querySpecificTrophy(*command.name); break;
+        case BESTIARY_QUERY: Commands::queryEffectiveness(*command.name); break;
+        case ALCHEMY_QUERY: Commands::queryFormula(*command.name); break;
+        case PLAN_QUERY: Commands::queryPlan(*command.name); break;
+        case SHOPPING_LIST_QUERY: Commands::queryShoppingList(command.items); break;
+        case RANKED_INGREDIENT_QUERY: Commands::queryRankedIngredients(command.flag, command.number); break;
+        case RANKED_POTION_QUERY: Commands::queryRankedPotions(command.flag, command.number); break;
+        case RANKED_TROPHY_QUERY: Commands::queryRankedTrophies(command.flag, command.number); break;
+        case TOTAL_MULTI_INGREDIENT_QUERY: Commands::queryMultipleIngredients(command.names); break;
+        case TOTAL_MULTI_POTION_QUERY: Commands::queryMultiplePotions(command.names); break;
+        case TOTAL_MULTI_TROPHY_QUERY: Commands::queryMultipleTrophies(command.names); break;
+        case NAME_SEARCH_INGREDIENT_QUERY: Commands::searchIngredientNames(command.flag, *command.name); break;
+        case NAME_SEARCH_POTION_QUERY: Commands::searchPotionNames(command.flag, *command.name); break;
+        case NAME_SEARCH_TROPHY_QUERY: Commands::searchTrophyNames(command.flag, *command.name); break;
+        case TOTAL_ALL_INGREDIENT_AT_QUERY: Commands::queryAllIngredientsAt(command.number); break;
+        case TOTAL_ALL_POTION_AT_QUERY: Commands::queryAllPotionsAt(command.number); break;
+        case TOTAL_ALL_TROPHY_AT_QUERY: Commands::queryAllTrophiesAt(command.number); break;
+        case TOTAL_SPECIFIC_INGREDIENT_AT_QUERY: Commands::querySpecificIngredientAt(*command.name, command.number); break;
+        case TOTAL_SPECIFIC_POTION_AT_QUERY: Commands::querySpecificPotionAt(*command.name, command.number); break;
+        case TOTAL_SPECIFIC_TROPHY_AT_QUERY: Commands::querySpecificTrophyAt(*command.name, command.number); break;
+        default: {
+            // Commands without operands take no tokens either
+            static const TokenList noTokens;
+            dispatchCommand(command.action, noTokens);
+            break;
+        }
+    }
+}
+
+/**
+ * @class ReplayDecoder
+ * @brief Decodes compiled records into the typed operands of their actions.
+ *
+ * Interned names are kept as strings indexed by ID, and quantities are read straight
+ * off their varints, so a replayed record never goes through the tokenizer, the
+ * grammar matcher or a Token.
+ */
+class ReplayDecoder {
+private:
+    const unsigned char* pos_;
+    const unsigned char* end_;
+    vector<string> names_;
+
+    bool getVarint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; pos_ < end_ && shift < 64; shift += 7) {
+            unsigned char byte = *pos_++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool getName(const string*& name) {
+        uint64_t id;
+        if (!getVarint(id) || id >= names_.size()) {
+            return false;
+        }
+        name = &names_[id];
+        return true;
+    }
+
+    bool getList(pmr::vector<ItemCount>& items) {
+        uint64_t count, quantity;
+        const string* name;
+        if (!getVarint(count)) {
+            return false;
+        }
+
+        for (uint64_t n = 0; n < count; n++) {
+            if (!getVarint(quantity) || !getName(name)) {
+                return false;
+            }
+            items.push_back(ItemCount{*name, static_cast<int>(quantity)});
+        }
+        return true;
+    }
+
+public:
+    ReplayDecoder(const unsigned char* begin, const unsigned char* end) : pos_(begin), end_(end) {}
+
+    bool atEnd() const { return pos_ >= end_; }
+
+    /**
+     * @brief Decodes the opcode of the next record.
+     *
+     * Name definitions are consumed silently, so on success @p action holds a command,
+     * or nullopt for a line that was compiled as INVALID. The operands follow with
+     * getOperands().
+     *
+     * @return false If the record is malformed.
+     */
+    bool next(optional<ParserActionType>& action) {
+        // The table only grows between records, so names handed out for a record stay put
+        while (pos_ < end_ && *pos_ == OPCODE_NAME) {
+            pos_++;
+            uint64_t length;
+            if (!getVarint(length) || length > static_cast<uint64_t>(end_ - pos_)) {
+                return false;
+            }
+            names_.emplace_back(reinterpret_cast<const char*>(pos_), length);
+            pos_ += length;
+        }
+
+        if (pos_ >= end_) {
+            return false;
+        }
+
+        unsigned char opcode = *pos_++;
+        if (opcode == OPCODE_INVALID) {
+            action = nullopt;
+            return true;
+        }
+
+        if (opcode >= PARSER_ACTION_COUNT) {
+            return false;
+        }
+
+        action = static_cast<ParserActionType>(opcode);
+        return true;
+    }
+
+    /// Reads the operands of a command whose opcode was just decoded.
+    bool getOperands(DecodedCommand& command) {
+        switch (command.action) {
+            case LOOT_ACTION:
+            case SHOPPING_LIST_QUERY:
+                return getList(command.items);
+            case TRADE_ACTION:
+                return getList(command.trophies) && getList(command.items);
+            case KNOWLEDGE_EFFECTIVENESS_SIGN:
+            case KNOWLEDGE_EFFECTIVENESS_POTION:
+                return getName(command.name) && getName(command.monster);
+            case KNOWLEDGE_POTION_FORMULA:
+                return getName(command.name) && getList(command.items);
+            case BREW_ACTION:
+            case ENCOUNTER:
+            case TOTAL_SPECIFIC_INGREDIENT_QUERY:
+            case TOTAL_SPECIFIC_POTION_QUERY:
+            case TOTAL_SPECIFIC_TROPHY_QUERY:
+            case BESTIARY_QUERY:
+            case ALCHEMY_QUERY:
+            case PLAN_QUERY:
+                return getName(command.name);
+            case RANKED_INGREDIENT_QUERY:
+            case RANKED_POTION_QUERY:
+            case RANKED_TROPHY_QUERY:
+            case NAME_SEARCH_INGREDIENT_QUERY:
+            case NAME_SEARCH_POTION_QUERY:
+            case NAME_SEARCH_TROPHY_QUERY: {
+                uint64_t flag;
+                if (!getVarint(flag)) {
+                    return false;
+                }
+                command.flag = flag != 0;
+                return command.action <= RANKED_TROPHY_QUERY ? getVarint(command.number) : getName(command.name);
+            }
+            case TOTAL_MULTI_INGREDIENT_QUERY:
+            case TOTAL_MULTI_POTION_QUERY:
+            case TOTAL_MULTI_TROPHY_QUERY: {
+                uint64_t count;
+                const string* name;
+                if (!getVarint(count)) {
+                    return false;
+                }
+                for (uint64_t n = 0; n < count; n++) {
+                    if (!getName(name)) {
+                        return false;
+                    }
+                    command.names.push_back(*name);
+                }
+                return true;
+            }
+            case TOTAL_ALL_INGREDIENT_AT_QUERY:
+            case TOTAL_ALL_POTION_AT_QUERY:
+            case TOTAL_ALL_TROPHY_AT_QUERY:
+                return getVarint(command.number);
+            case TOTAL_SPECIFIC_INGREDIENT_AT_QUERY:
+            case TOTAL_SPECIFIC_POTION_AT_QUERY:
+            case TOTAL_SPECIFIC_TROPHY_AT_QUERY:
+                return getName(command.name) && getVarint(command.number);
+            default:
+                return true;
+        }
+    }
+
+    /// Reads the opcode of the action nested in a what-if query; only state-changing actions are allowed.
+    bool getNestedAction(ParserActionType& action) {
+        if (pos_ >= end_ || *pos_ >= PARSER_ACTION_COUNT ||
+            !isStateChangingAction(static_cast<ParserActionType>(*pos_))) {
+            return false;
+        }
+        action = static_cast<ParserActionType>(*pos_++);
+        return true;
+    }
+};
+
+} // namespace
+
+bool replayCompiledLog(const string& path, uint64_t historyInterval, string& error) {
+    ifstream input(path, ios::binary);
+    if (!input) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    vector<char> data((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+
+    uint32_t version;
+    if (data.size() < sizeof(COMPILED_MAGIC) + sizeof(version) ||
+        memcmp(data.data(), COMPILED_MAGIC, sizeof(COMPILED_MAGIC)) != 0) {
+        error = "not a compiled command file";
+        return false;
+    }
+
+    memcpy(&version, data.data() + sizeof(COMPILED_MAGIC), sizeof(version));
+    if (version != COMPILED_VERSION) {
+        error = "unsupported compiled command version " + to_string(version);
+        return false;
+    }
+
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(data.data());
+    ReplayDecoder decoder(begin + sizeof(COMPILED_MAGIC) + sizeof(version), begin + data.size());
+
+    optional<ParserActionType> action;
+
+    // Every record is one line of the original log, so "at <line>" refers to the same lines
+    if (historyInterval != 0) {
+        Geralt::enableHistory(historyInterval);
+    }
+
+    while (!decoder.atEnd()) {
+        CommandArena::Scope arena;
+        Geralt::beginVersion();
+        if (!decoder.next(action)) {
+            error = "malformed record in " + path;
+            return false;
+        }
+
+        if (!action) {
+            Output::sink().write("INVALID");
+            Output::sink().endAnswer();
+            continue;
+        } else if (*action == EXIT_COMMAND) {
+            break;
+        }
+
+        // A what-if record carries the opcode of its action before the operands
+        DecodedCommand command(*action);
+        if ((*action == WHAT_IF_QUERY && !decoder.getNestedAction(command.action)) || !decoder.getOperands(command)) {
+            error = "malformed record in " + path;
+            return false;
+        }
+
+        Stats::Span span(Stats::STAGE_EXECUTE, *action);
+        if (*action == WHAT_IF_QUERY) {
+            Commands::queryWhatIf(runDecoded, &command);
+        } else {
+            runDecoded(&command);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,115 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+/**
+ * @file compiler.h
+ * @brief Declares the compact binary command format and its replay engine.
+ *
+ * Text command logs are compiled once into a stream of binary records. Replaying the
+ * binary stream decodes each record into the names and quantities of its action and
+ * calls the typed Commands entry points, skipping the tokenizer, the grammar matching
+ * and the Token strings that a text line has to go through.
+ *
+ * File layout:
+ * @code
+ * "WTCMDS\0\0" magic, uint32 version
+ * record*
+ * @endcode
+ *
+ * Every record starts with an opcode byte. The opcode is either a ParserActionType,
+ * followed by the operands of that action, or one of the special opcodes below.
+ * Names are interned: the first time a name appears, a NAME record defines it and it
+ * receives the next ID. Quantities, counts and IDs are unsigned LEB128 varints.
+ *
+ * | Action                          | Operands                                          |
+ * |---------------------------------|---------------------------------------------------|
+ * | LOOT_ACTION                     | count, (quantity, ingredient)*                    |
+ * | TRADE_ACTION                    | count, (quantity, trophy)*, count, (quantity, ingredient)* |
+ * | BREW_ACTION                     | potion                                            |
+ * | KNOWLEDGE_EFFECTIVENESS_SIGN    | sign, monster                                     |
+ * | KNOWLEDGE_EFFECTIVENESS_POTION  | potion, monster                                   |
+ * | KNOWLEDGE_POTION_FORMULA        | potion, count, (quantity, ingredient)*            |
+ * | ENCOUNTER                       | monster                                           |
+ * | TOTAL_SPECIFIC_*_QUERY          | name                                              |
+ * | BESTIARY_QUERY                  | monster                                           |
+ * | ALCHEMY_QUERY                   | potion                                            |
+ * | PLAN_QUERY                      | monster                                           |
+ * | SHOPPING_LIST_QUERY             | count, (quantity, potion)*                        |
+ * | RANKED_*_QUERY                  | scarcest (0 or 1), count                          |
+ * | TOTAL_MULTI_*_QUERY             | count, name*                                      |
+ * | NAME_SEARCH_*_QUERY             | similar (0 or 1), name                            |
+ * | TOTAL_ALL_*_AT_QUERY            | line                                              |
+ * | TOTAL_SPECIFIC_*_AT_QUERY       | name, line                                        |
+ * | WHAT_IF_QUERY                   | action opcode, operands of the action             |
+ * | TOTAL_ALL_*_QUERY, EXIT_COMMAND | none                                              |
+ * | BREW_MIX_QUERY                  | none                                              |
+ * | BEGIN/COMMIT/ROLLBACK_COMMAND   | none                                              |
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+
+#include "parser.h"
+
+class Token;
+
+/// Magic bytes at the start of every compiled command file.
+constexpr char COMPILED_MAGIC[8] = {'W', 'T', 'C', 'M', 'D', 'S', '\0', '\0'};
+
+/// Current version of the compiled command format.
+constexpr uint32_t COMPILED_VERSION = 1;
+
+/// Opcode that defines the next name ID: varint length followed by the bytes of the name.
+constexpr uint8_t OPCODE_NAME = 0xFF;
+
+/// Opcode of a line that was rejected as INVALID when it was compiled.
+constexpr uint8_t OPCODE_INVALID = 0xFE;
+
+/**
+ * @class CommandCompiler
+ * @brief Translates text command lines into binary records, interning names as it goes.
+ */
+class CommandCompiler {
+private:
+    std::ostream& out_;
+    std::unordered_map<std::string, uint32_t> nameIds_;
+    std::string record_;    ///< Reused buffer for the record being encoded
+
+    void putVarint(uint64_t value);
+    void putName(const std::string& name);
+    void putList(const TokenList& tokens, size_t& i);
+    void putOperands(ParserActionType action, const TokenList& tokens);
+
+public:
+    /**
+     * @brief Starts a compiled file by writing its magic and version.
+     *
+     * @param out Binary output stream.
+     */
+    explicit CommandCompiler(std::ostream& out);
+
+    /**
+     * @brief Compiles one text command line (escape sequences already replaced).
+     *
+     * @param line Command line as it would be passed to execute_line.
+     * @return true If the line was valid; invalid lines are recorded as INVALID.
+     */
+    bool compileLine(const std::string& line);
+};
+
+/**
+ * @brief Replays a compiled command file, printing the answer of every command.
+ *
+ * Replay stops at the end of the file or at a compiled exit command.
+ *
+ * @param path Path of the compiled file.
+ * @param historyInterval Lines between two checkpoints of the "at <line>" history; 0 keeps none.
+ * @param error Receives a human readable reason when the file is malformed.
+ * @return true If the whole file was replayed.
+ */
+bool replayCompiledLog(const std::string& path, uint64_t historyInterval, std::string& error);
+
+#endif
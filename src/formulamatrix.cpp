@@ -0,0 +1,229 @@
+/**
+ * @file formulamatrix.cpp
+ * @brief Implementation of the shared formula matrix and the shortfall kernel.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "formulamatrix.h"
+#include "arena.h"
+
+using namespace std;
+
+FormulaMatrix FormulaMatrix::matrix;
+
+const FormulaMatrix& FormulaMatrix::current() {
+    if (matrix.formulaGeneration != Geralt::getFormulaGeneration()) {
+        matrix.build();
+    } else if (matrix.ingredientMembership != Geralt::getIngredientGenerations().membership) {
+        matrix.resolve();
+    }
+    return matrix;
+}
+
+uint32_t FormulaMatrix::row(string_view potionName) const {
+    if (rowIndex.empty()) {
+        return NO_ROW;
+    }
+
+    size_t mask = rowIndex.size() - 1;
+    for (size_t slot = hash<string_view>()(potionName) & mask; rowIndex[slot] != NO_ROW; slot = (slot + 1) & mask) {
+        if (potions[rowIndex[slot]] == potionName) {
+            return rowIndex[slot];
+        }
+    }
+    return NO_ROW;
+}
+
+/**
+ * @brief Numbers the rows and columns again from Geralt's potions.
+ *
+ * Entries with the same ingredient in one formula are merged, and entries that need
+ * nothing are dropped, so every stored amount is positive.
+ */
+void FormulaMatrix::build() {
+    auto& potionMap = Geralt::getPotions();
+
+    size_t entries = 0;
+    for (auto& potionPair : potionMap) {
+        entries += potionPair.second->getFormula().size();
+    }
+
+    potions.clear();
+    rowStart.clear();
+    column.clear();
+    amount.clear();
+    ingredientNames.clear();
+
+    potions.reserve(potionMap.size());
+    rowStart.reserve(potionMap.size() + 1);
+    rowStart.push_back(0);
+    column.reserve(entries);
+    amount.reserve(entries);
+    ingredientNames.reserve(entries);
+
+    pmr::unordered_map<string_view, uint32_t> columnOf(CommandArena::resource());
+
+    for (auto& potionPair : potionMap) {
+        Potion& potion = *potionPair.second;
+        if (!potion.isFormulaDefined()) {
+            continue;
+        }
+
+        size_t rowBegin = column.size();
+
+        for (const pair<Name, int>& entry : potion.getFormula()) {
+            auto slot = columnOf.emplace(entry.first.view(), static_cast<uint32_t>(ingredientNames.size()));
+            if (slot.second) {
+                ingredientNames.push_back(entry.first.view());
+            }
+
+            // An ingredient listed twice in one formula is needed in the sum of both quantities
+            size_t k = rowBegin;
+            while (k < column.size() && column[k] != slot.first->second) {
+                k++;
+            }
+            if (k == column.size()) {
+                column.push_back(slot.first->second);
+                amount.push_back(0);
+            }
+            amount[k] += entry.second;
+        }
+
+        size_t kept = rowBegin;
+        for (size_t k = rowBegin; k < column.size(); k++) {
+            if (amount[k] > 0) {
+                column[kept] = column[k];
+                amount[kept] = amount[k];
+                kept++;
+            }
+        }
+        column.resize(kept);
+        amount.resize(kept);
+
+        potions.push_back(potionPair.first.view());
+        rowStart.push_back(static_cast<uint32_t>(column.size()));
+    }
+
+    // Columns are numbered in the alphabetical order of their ingredients, so IDs sort like names
+    pmr::vector<uint32_t> byName(ingredientNames.size(), 0, CommandArena::resource());
+    for (uint32_t c = 0; c < byName.size(); c++) {
+        byName[c] = c;
+    }
+    sort(byName.begin(), byName.end(), [this](uint32_t a, uint32_t b) {
+        return ingredientNames[a] < ingredientNames[b];
+    });
+
+    pmr::vector<uint32_t> renumbered(byName.size(), 0, CommandArena::resource());
+    pmr::vector<string_view> names(CommandArena::resource());
+    names.reserve(byName.size());
+    for (uint32_t c = 0; c < byName.size(); c++) {
+        renumbered[byName[c]] = c;
+        names.push_back(ingredientNames[byName[c]]);
+    }
+    copy(names.begin(), names.end(), ingredientNames.begin());
+    for (uint32_t& c : column) {
+        c = renumbered[c];
+    }
+
+    // Open addressing with linear probing, at most half full
+    size_t slots = 1;
+    while (slots < 2 * potions.size()) {
+        slots *= 2;
+    }
+    rowIndex.assign(potions.empty() ? 0 : slots, NO_ROW);
+    for (uint32_t p = 0; p < potions.size(); p++) {
+        size_t slot = hash<string_view>()(potions[p]) & (slots - 1);
+        while (rowIndex[slot] != NO_ROW) {
+            slot = (slot + 1) & (slots - 1);
+        }
+        rowIndex[slot] = p;
+    }
+
+    ingredients.assign(ingredientNames.size(), nullptr);
+    accumulator.assign(ingredientNames.size(), 0);
+    ingredientMembership = UINT64_MAX;
+    resolve();
+
+    formulaGeneration = Geralt::getFormulaGeneration();
+    version++;
+}
+
+/**
+ * @brief Looks up the Ingredient of every column that has none yet.
+ *
+ * Ingredients are removed by reset() and by rolling back a what-if or a transaction that
+ * added them. A formula enters its ingredients when it is learned, so an erased column
+ * comes with an undone formula and a rebuild; rather than rely on that, every column is
+ * looked up again once the removal counter of the ingredients moves.
+ */
+void FormulaMatrix::resolve() {
+    auto& ingredientMap = Geralt::getIngredients();
+
+    const CollectionGenerations& generations = Geralt::getIngredientGenerations();
+    if (ingredientRemovals != generations.removals) {
+        fill(ingredients.begin(), ingredients.end(), nullptr);
+        ingredientRemovals = generations.removals;
+    }
+
+    for (size_t c = 0; c < ingredients.size(); c++) {
+        if (ingredients[c] == nullptr) {
+            auto ingredient = ingredientMap.find(ingredientNames[c]);
+            if (ingredient != ingredientMap.end()) {
+                ingredients[c] = ingredient->second.get();
+            }
+        }
+    }
+
+    ingredientMembership = generations.membership;
+}
+
+string_view FormulaMatrix::shortfall(Span<ItemCount> potionList, pmr::vector<ItemCount>& missing) const {
+    missing.clear();
+
+    // Columns with a nonzero sum, so that only they have to be read and cleared again
+    pmr::vector<uint32_t> touched(CommandArena::resource());
+    string_view unknown;
+
+    for (const ItemCount& item : potionList) {
+        uint32_t p = row(item.name);
+        if (p == NO_ROW) {
+            unknown = item.name;
+            break;
+        }
+
+        for (uint32_t k = rowStart[p]; k < rowStart[p + 1]; k++) {
+            long long& sum = accumulator[column[k]];
+            if (sum == 0) {
+                touched.push_back(column[k]);
+            }
+            sum += amount[k] * item.quantity;
+        }
+    }
+
+    // Sorted by the negated deficit and then the column, which is the order of the names
+    pmr::vector<pair<long long, uint32_t>> deficits(CommandArena::resource());
+
+    for (uint32_t c : touched) {
+        long long deficit = accumulator[c] - stock(c);
+        accumulator[c] = 0;
+
+        if (unknown.empty() && deficit > 0) {
+            deficits.emplace_back(-min<long long>(deficit, INT_MAX), c);
+        }
+    }
+
+    sort(deficits.begin(), deficits.end());
+
+    missing.reserve(deficits.size());
+    for (const auto& [negated, c] : deficits) {
+        missing.push_back(ItemCount{ingredientNames[c], static_cast<int>(-negated)});
+    }
+
+    return unknown;
+}
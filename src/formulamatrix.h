@@ -0,0 +1,98 @@
+#ifndef FORMULAMATRIX_H
+#define FORMULAMATRIX_H
+
+/**
+ * @file formulamatrix.h
+ * @brief Declares the sparse matrix of every known formula over interned ingredient IDs.
+ *
+ * Each potion with a formula is a row and each ingredient named by a formula is a
+ * column, numbered once when the matrix is built. The entries of a row are stored
+ * contiguously in compressed row form, so kernels over many formulas walk flat arrays
+ * of integers instead of looking names up in Geralt's maps. Columns keep a pointer to
+ * their Ingredient, so the current stock is one load away, and a flat hash table maps
+ * potion names to rows.
+ *
+ * The matrix is rebuilt only when a formula is learned. When a new ingredient appears,
+ * only the columns that had no Ingredient yet are resolved again; when one is removed,
+ * every column is.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+#include "geralt.h"
+
+/**
+ * @class FormulaMatrix
+ * @brief Geralt's formulas as one matrix, shared by the queries that work on many formulas at once.
+ */
+class FormulaMatrix {
+public:
+    /// Row of a potion that has no formula.
+    static constexpr uint32_t NO_ROW = UINT32_MAX;
+
+    /**
+     * @brief Returns the matrix of Geralt's current formulas, rebuilding it if needed.
+     *
+     * @return const FormulaMatrix& The matrix; valid until the next formula is learned or the state is reset.
+     */
+    static const FormulaMatrix& current();
+
+    /// Changes whenever rows or columns are numbered again, so that state kept per row or column can be dropped.
+    uint64_t getVersion() const { return version; }
+
+    size_t rows() const { return potions.size(); }
+    size_t columns() const { return ingredients.size(); }
+
+    /// Row of a potion, or NO_ROW if the potion has no formula.
+    uint32_t row(std::string_view potionName) const;
+
+    /// Quantity of the ingredient of column @p c in stock; 0 if Geralt never had it.
+    long long stock(uint32_t c) const {
+        return ingredients[c] != nullptr ? std::max(0, ingredients[c]->getQuantity()) : 0;
+    }
+
+    /**
+     * @brief Computes the ingredients missing to brew a list of potions.
+     *
+     * The formulas are scaled by their counts and summed in a sparse accumulator
+     * indexed by column, so a potion listed twice and ingredients shared between
+     * formulas are added up before the stock is subtracted.
+     *
+     * @param potionList Potions to brew, with the number of each.
+     * @param missing Receives each ingredient whose stock falls short with the missing
+     *        quantity, by descending quantity, then by name. Quantities beyond INT_MAX are clamped.
+     * @return std::string_view Empty on success, or the first listed potion that has no formula.
+     */
+    std::string_view shortfall(Span<ItemCount> potionList, std::pmr::vector<ItemCount>& missing) const;
+
+    // Row p is the formula of potions[p]: columns column[rowStart[p] .. rowStart[p + 1]) with their amounts
+    std::vector<std::string_view> potions;          ///< Potion of every row, in alphabetical order
+    std::vector<uint32_t> rowStart;
+    std::vector<uint32_t> column;
+    std::vector<long long> amount;
+    std::vector<std::string_view> ingredientNames;  ///< Ingredient name of every column, in alphabetical order
+    std::vector<Ingredient*> ingredients;           ///< Ingredient of every column; nullptr while Geralt never had it
+
+private:
+    uint64_t version = 0;
+    uint64_t formulaGeneration = UINT64_MAX;
+    uint64_t ingredientMembership = UINT64_MAX;
+    uint64_t ingredientRemovals = UINT64_MAX;
+
+    /// Hash table from potion name to row, in one flat array: each slot holds a row or NO_ROW.
+    std::vector<uint32_t> rowIndex;
+
+    /// Per column sums of shortfall(); all zero between calls.
+    mutable std::vector<long long> accumulator;
+
+    static FormulaMatrix matrix;
+
+    void build();
+    void resolve();
+};
+
+#endif
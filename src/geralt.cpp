@@ -11,31 +11,55 @@
  * query helpers for inventory, bestiary and alchemy
  *
  * Each public method directly corresponds to a grammar rule in the assignment
- * specification and produces exactly the console output prescribed by the spec.
+ * specification and returns a typed result; Commands prints the answer prescribed by the spec.
  *
  * @author  Akin Tuna Sakalli
  * @date    June 1, 2025
  */
 
-#include <iostream>
 #include <string>
+#include <string_view>
 #include <map>
 #include <vector>
-#include <set>
 #include <memory>
 #include <algorithm>
-#include <functional>
 
 #include "geralt.h"
-#include "tokenizer.h"
-#include "token.h"
+#include "querycache.h"
+#include "pool.h"
+#include "arena.h"
+#include "changefeed.h"
 
 using namespace std;
 
-map<string, shared_ptr<Ingredient>> Geralt::ingredients;
-map<string, shared_ptr<Potion>> Geralt::potions;
-map<string, shared_ptr<Monster>> Geralt::monsters;
-map<string, shared_ptr<Trophy>> Geralt::trophies;
+EntityMap<Ingredient> Geralt::ingredients(EntityPool::resource());
+EntityMap<Potion> Geralt::potions(EntityPool::resource());
+EntityMap<Monster> Geralt::monsters(EntityPool::resource());
+EntityMap<Trophy> Geralt::trophies(EntityPool::resource());
+
+StockRanking Geralt::ingredientRanking(EntityPool::resource());
+StockRanking Geralt::potionRanking(EntityPool::resource());
+StockRanking Geralt::trophyRanking(EntityPool::resource());
+
+NameIndex Geralt::ingredientNames(EntityPool::resource());
+NameIndex Geralt::potionNames(EntityPool::resource());
+NameIndex Geralt::trophyNames(EntityPool::resource());
+
+StockHistory Geralt::ingredientHistory(EntityPool::resource());
+StockHistory Geralt::potionHistory(EntityPool::resource());
+StockHistory Geralt::trophyHistory(EntityPool::resource());
+uint64_t Geralt::version = 0;
+uint64_t Geralt::historyInterval = 0;
+uint64_t Geralt::lastCheckpoint = 0;
+
+Geralt::UndoLog Geralt::whatIfLog;
+Geralt::UndoLog Geralt::transactionLog;
+
+CollectionGenerations Geralt::ingredientGenerations;
+CollectionGenerations Geralt::potionGenerations;
+CollectionGenerations Geralt::monsterGenerations;
+CollectionGenerations Geralt::trophyGenerations;
+uint64_t Geralt::formulaGeneration = 0;
 
 /**
  * @brief Returns a modifiable reference to the global ingredients map.
@@ -43,9 +67,9 @@ map<string, shared_ptr<Trophy>> Geralt::trophies;
  * The returned reference allows callers to read or mutate the shared
  * container that represents Geralt’s current ingredient inventory.
  *
- * @return Reference to the underlying `std::map`.
+ * @return Reference to the underlying map.
  */
-map<string, shared_ptr<Ingredient>>& Geralt::getIngredients() {
+EntityMap<Ingredient>& Geralt::getIngredients() {
     return ingredients;
 }
 
@@ -55,9 +79,9 @@ map<string, shared_ptr<Ingredient>>& Geralt::getIngredients() {
  * The returned reference allows callers to read or mutate the shared
  * container that represents Geralt’s current potion inventory.
  *
- * @return Reference to the underlying `std::map`.
+ * @return Reference to the underlying map.
  */
-map<string, shared_ptr<Potion>>& Geralt::getPotions() {
+EntityMap<Potion>& Geralt::getPotions() {
     return potions;
 }
 
@@ -67,9 +91,9 @@ map<string, shared_ptr<Potion>>& Geralt::getPotions() {
  * The returned reference allows callers to read or mutate the shared
  * container that represents Geralt’s current bestiary knowledge.
  *
- * @return Reference to the underlying `std::map`.
+ * @return Reference to the underlying map.
  */
-map<string, shared_ptr<Monster>>& Geralt::getMonsters() {
+EntityMap<Monster>& Geralt::getMonsters() {
     return monsters;
 }
 
@@ -79,215 +103,338 @@ map<string, shared_ptr<Monster>>& Geralt::getMonsters() {
  * The returned reference allows callers to read or mutate the shared
  * container that represents Geralt’s current trophy inventory.
  *
- * @return Reference to the underlying `std::map`.
+ * @return Reference to the underlying map.
  */
-map<string, shared_ptr<Trophy>>& Geralt::getTrophies() {
+EntityMap<Trophy>& Geralt::getTrophies() {
     return trophies;
 }
 
+const CollectionGenerations& Geralt::getIngredientGenerations() {
+    return ingredientGenerations;
+}
+
+const CollectionGenerations& Geralt::getPotionGenerations() {
+    return potionGenerations;
+}
+
+const CollectionGenerations& Geralt::getMonsterGenerations() {
+    return monsterGenerations;
+}
+
+const CollectionGenerations& Geralt::getTrophyGenerations() {
+    return trophyGenerations;
+}
+
+const uint64_t& Geralt::getFormulaGeneration() {
+    return formulaGeneration;
+}
+
 /**
- * @brief Handles the loot action.
- * 
- * Increases the quantity of each looted ingredient by the specified amount.
- *
- * Outputs: “Alchemy ingredients obtained”
+ * @brief Clears the inventory, bestiary and alchemy knowledge.
  *
- * @param tokenList Tokenized user input line.
+ * Used before restoring a snapshot so that the restored state does not
+ * mix with whatever was already tracked.
  */
-void Geralt::loot(const vector<Token>& tokenList) {
-    int i = 2;
-    auto& ingredients = Geralt::getIngredients();
+void Geralt::reset() {
+    // The logs point into the maps, and an open transaction ends with the state it changed
+    whatIfLog = UndoLog();
+    transactionLog = UndoLog();
+
+    ingredients.clear();
+    potions.clear();
+    monsters.clear();
+    trophies.clear();
+
+    for (CollectionGenerations* generations : {&ingredientGenerations, &potionGenerations, &monsterGenerations, &trophyGenerations}) {
+        generations->contents++;
+        generations->membership++;
+        generations->removals++;
+    }
+    formulaGeneration++;
+
+    ingredientRanking.invalidate();
+    potionRanking.invalidate();
+    trophyRanking.invalidate();
+    ingredientNames.invalidate();
+    potionNames.invalidate();
+    trophyNames.invalidate();
+    ingredientHistory.clear();
+    potionHistory.clear();
+    trophyHistory.clear();
+    historyInterval = 0;
+    QueryCache::clear();
+}
 
-    while (i+1 < tokenList.size()) {
-        int ingredientQuantity = stoi(tokenList[i].getContent());
-        string ingredientName = tokenList[i+1].getContent();
-        
-        // The corresponding ingredient is already present in the map, increase its quantity
-        if (ingredients.count(ingredientName) > 0) {
-            ingredients[ingredientName]->increaseQuantity(ingredientQuantity);
-        }
-        // It is the first time that ingredient is encountered, add it to the map
-        else {
-            shared_ptr<Ingredient> newIngredient = make_shared<Ingredient>(ingredientName, ingredientQuantity);
-            ingredients.emplace(ingredientName, newIngredient);
+/**
+ * @brief Returns the ingredient with the given name, adding it with quantity 0 if it is new.
+ *
+ * @param name Ingredient name.
+ * @return Reference to the map slot holding the ingredient.
+ */
+shared_ptr<Ingredient>& Geralt::ingredientEntry(string_view name) {
+    auto it = ingredients.find(name);
+
+    if (it == ingredients.end()) {
+        Name key(name);
+        it = ingredients.emplace(key, EntityPool::make<Ingredient>(key, 0)).first;
+        ingredientGenerations.membership++;
+        ingredientGenerations.contents++;
+        it->second->setId(static_cast<uint32_t>(ingredients.size() - 1));
+        if (undoing()) {
+            touch(&UndoLog::ingredients, it, true);
+        } else {
+            ingredientNames.update(it->second->getName().view());
         }
-    // If this ingredient is the last ingredient in the input sentence, break the iteration
-    if (i+2 >= tokenList.size()) {
-        break;
-    }
-    // If there are still ingredients remaining in the input sentence, keep iterating to loot those as well
-    i += 3;
+    } else if (undoing()) {
+        touch(&UndoLog::ingredients, it, false);
     }
-    // Print the output
-    cout << "Alchemy ingredients obtained" << endl;
+
+    return it->second;
 }
 
 /**
- * @brief Processes a **trade** action.
+ * @brief Returns the potion with the given name, adding it with quantity 0 and no formula if it is new.
  *
- * Verifies that Geralt owns every trophy requested in sufficient quantity.
- * If so, decrements trophies and increases ingredients; otherwise leaves state unchanged.
- *
- * Outputs:  
- * “Trade successful” on success  
- * “Not enough trophies” on failure
- *
- * @param tokenList Tokenized input line.
+ * @param name Potion name.
+ * @return Reference to the map slot holding the potion.
  */
-void Geralt::trade(const vector<Token>& tokenList) {
-    int i = 2;
-    bool neededTrophiesExist = true;
-    auto& trophies = Geralt::getTrophies();
-    auto& ingredients = Geralt::getIngredients();
-
-    // Iterate through the input sentence if there are still quantities and trophies that need to be processed
-    while (tokenList[i].getType() == TOKEN_QUANTITY && tokenList[i+1].getType() == TOKEN_WORD) {
-        int neededQuantity = stoi(tokenList[i].getContent());
-        string trophyName = tokenList[i+1].getContent();
+shared_ptr<Potion>& Geralt::potionEntry(string_view name) {
+    auto it = potions.find(name);
+
+    if (it == potions.end()) {
+        Name key(name);
+        it = potions.emplace(key, EntityPool::make<Potion>(key)).first;
+        potionGenerations.membership++;
+        potionGenerations.contents++;
+        it->second->setId(static_cast<uint32_t>(potions.size() - 1));
+        if (undoing()) {
+            touch(&UndoLog::potions, it, true);
+        } else {
+            potionNames.update(it->second->getName().view());
+        }
+    } else if (undoing()) {
+        touch(&UndoLog::potions, it, false);
+    }
 
-        bool enoughTrophies = true;
+    return it->second;
+}
 
-        // Trophy is in the trophy list
-        if (trophies.count(trophyName) > 0) {
-            // If the trophy quantity is insufficient, there are not enough trophies
-            if (trophies[trophyName]->getQuantity() < neededQuantity) {
-                enoughTrophies = false;
-            }
-        }
-        // If the trophy is not in the trophy list, there are not any trophies
-        else {
-            enoughTrophies = false;
+/**
+ * @brief Returns the bestiary entry of the given monster, adding an empty entry if it is new.
+ *
+ * @param name Monster name.
+ * @return Reference to the map slot holding the monster.
+ */
+shared_ptr<Monster>& Geralt::monsterEntry(string_view name) {
+    auto it = monsters.find(name);
+
+    if (it == monsters.end()) {
+        Name key(name);
+        it = monsters.emplace(key, EntityPool::make<Monster>(key)).first;
+        monsterGenerations.membership++;
+        monsterGenerations.contents++;
+        it->second->setId(static_cast<uint32_t>(monsters.size() - 1));
+        if (undoing()) {
+            touch(&UndoLog::monsters, it, true);
         }
+    } else if (undoing()) {
+        touch(&UndoLog::monsters, it, false);
+    }
 
-        if (!enoughTrophies) {
-            neededTrophiesExist = false;
-            break;
-        }
-        
-        // If there are not any trophies that need to be processed, get out of the loop
-        if (tokenList[i+2].getType() == TOKEN_TROPHY) {
-            break;
-        }
-        // If there are still more trophies, keep iterating through the input sentence
-        else {
-            i += 3;
+    return it->second;
+}
+
+/**
+ * @brief Returns the trophy of the given monster, adding it with quantity 0 if it is new.
+ *
+ * @param name Monster name of the trophy.
+ * @return Reference to the map slot holding the trophy.
+ */
+shared_ptr<Trophy>& Geralt::trophyEntry(string_view name) {
+    auto it = trophies.find(name);
+
+    if (it == trophies.end()) {
+        Name key(name);
+        it = trophies.emplace(key, EntityPool::make<Trophy>(key)).first;
+        trophyGenerations.membership++;
+        trophyGenerations.contents++;
+        it->second->setId(static_cast<uint32_t>(trophies.size() - 1));
+        if (undoing()) {
+            touch(&UndoLog::trophies, it, true);
+        } else {
+            trophyNames.update(it->second->getName().view());
         }
+    } else if (undoing()) {
+        touch(&UndoLog::trophies, it, false);
     }
-    
-    // There are enough trophies
-    if (neededTrophiesExist) {
-        i = 2;
-        cout << "Trade successful" << endl;
-
-        // The trophy quantities are decreased by an amount equal to the quantity that is needed
-        while (tokenList[i].getType() == TOKEN_QUANTITY && tokenList[i+1].getType() == TOKEN_WORD) {
-            int neededQuantity = stoi(tokenList[i].getContent());
-            string trophyName = tokenList[i+1].getContent();
-    
-            trophies[trophyName]->decreaseQuantity(neededQuantity);
-
-            // If there are not any trophies that need to be processed, get out of the loop
-            if (tokenList[i+2].getType() == TOKEN_TROPHY) {
-                break;
-            }
-            // If there are still more trophies, keep iterating through the input sentence
-            else {
-                i += 3;
-            }
-        }
 
-        // Ingredients are processed and incremented by amount that is equal to the given quantity
-        i += 4;
-        while (i + 1 < tokenList.size()) {
-            int quantity = stoi(tokenList[i].getContent());
-            string ingredientName = tokenList[i+1].getContent();
-            
-            // If that ingredient already exists, increase its quantity
-            if (ingredients.count(ingredientName) > 0) {
-                ingredients[ingredientName]->increaseQuantity(quantity);
-            }
-            // If the ingredient does not exist, it is added to the list
-            else {
-                shared_ptr<Ingredient> newIngredient = make_shared<Ingredient>(ingredientName, quantity);
-                ingredients.emplace(ingredientName, newIngredient);
-            }
+    return it->second;
+}
 
+/**
+ * @brief Adds a positive or negative amount to an ingredient, adding the ingredient if it is new.
+ *
+ * @param name Ingredient name.
+ * @param amount Amount to add; negative values consume the ingredient.
+ */
+void Geralt::changeIngredientQuantity(string_view name, int amount) {
+    shared_ptr<Ingredient>& ingredient = ingredientEntry(name);
+    int before = ingredient->getQuantity();
+
+    if (amount >= 0) {
+        ingredient->increaseQuantity(amount);
+    } else {
+        ingredient->decreaseQuantity(-amount);
+    }
+    ingredientRanking.update(ingredient->getName().view(), before, ingredient->getQuantity());
+    if (historyInterval != 0 && !undoing()) {
+        ingredientHistory.record(version, ingredient->getId(), ingredient->getQuantity());
+    }
+    if (ChangeFeed::isOpen() && !undoing() && ingredient->getQuantity() != before) {
+        ChangeFeed::publish(ChangeFeed::INGREDIENT, ingredient->getId(), ingredient->getName().view(), before, ingredient->getQuantity(),
+                            version);
+    }
+    ingredientGenerations.contents++;
+}
 
-            // If there are not any ingredients that need to be processed, get out of the loop
-            if (i+2 >= tokenList.size()) {
-                break;
-            }
-            // If there are still more ingredients, keep iterating through the input sentence
-            else {
-                i += 3;
-            }
+/**
+ * @brief Adds a positive or negative amount to a potion, adding the potion if it is new.
+ *
+ * @param name Potion name.
+ * @param amount Amount to add; negative values consume the potion.
+ */
+void Geralt::changePotionQuantity(string_view name, int amount) {
+    shared_ptr<Potion>& potion = potionEntry(name);
+    int before = potion->getQuantity();
+
+    if (amount >= 0) {
+        potion->increaseQuantity(amount);
+    } else {
+        potion->decreaseQuantity(-amount);
+    }
+    potionRanking.update(potion->getName().view(), before, potion->getQuantity());
+    if (historyInterval != 0 && !undoing()) {
+        potionHistory.record(version, potion->getId(), potion->getQuantity());
+    }
+    if (ChangeFeed::isOpen() && !undoing() && potion->getQuantity() != before) {
+        ChangeFeed::publish(ChangeFeed::POTION, potion->getId(), potion->getName().view(), before, potion->getQuantity(),
+                            version);
+    }
+    potionGenerations.contents++;
+}
+
+/**
+ * @brief Adds a positive or negative amount to a trophy, adding the trophy if it is new.
+ *
+ * @param name Monster name of the trophy.
+ * @param amount Amount to add; negative values give the trophy away.
+ */
+void Geralt::changeTrophyQuantity(string_view name, int amount) {
+    shared_ptr<Trophy>& trophy = trophyEntry(name);
+    int before = trophy->getQuantity();
+
+    if (amount >= 0) {
+        trophy->increaseQuantity(amount);
+    } else {
+        trophy->decreaseQuantity(-amount);
+    }
+    trophyRanking.update(trophy->getName().view(), before, trophy->getQuantity());
+    if (historyInterval != 0 && !undoing()) {
+        trophyHistory.record(version, trophy->getId(), trophy->getQuantity());
+    }
+    if (ChangeFeed::isOpen() && !undoing() && trophy->getQuantity() != before) {
+        ChangeFeed::publish(ChangeFeed::TROPHY, trophy->getId(), trophy->getName().view(), before, trophy->getQuantity(),
+                            version);
+    }
+    trophyGenerations.contents++;
+}
+
+/**
+ * @brief Handles the loot action.
+ * 
+ * Increases the quantity of each looted ingredient by the specified amount.
+ *
+ * @param ingredientList Looted ingredients and their quantities.
+ */
+void Geralt::loot(Span<ItemCount> ingredientList) {
+    // Increase each ingredient's quantity; it is added to the map if it is the first time that ingredient is encountered
+    for (const ItemCount& ingredient : ingredientList) {
+        changeIngredientQuantity(ingredient.name, ingredient.quantity);
+    }
+}
+
+/**
+ * @brief Processes a **trade** action.
+ *
+ * Verifies that Geralt owns every trophy requested in sufficient quantity.
+ * If so, decrements trophies and increases ingredients; otherwise leaves state unchanged.
+ *
+ * @param trophyList Trophies given away and their quantities.
+ * @param ingredientList Ingredients received and their quantities.
+ * @return TradeResult TRADE_SUCCESSFUL, or TRADE_NOT_ENOUGH_TROPHIES if nothing was traded.
+ */
+TradeResult Geralt::trade(Span<ItemCount> trophyList, Span<ItemCount> ingredientList) {
+    // Every trophy must be present with a sufficient quantity
+    for (const ItemCount& neededTrophy : trophyList) {
+        auto trophy = trophies.find(neededTrophy.name);
+
+        // If the trophy is not in the trophy list or its quantity is insufficient, there are not enough trophies
+        if (trophy == trophies.end() || trophy->second->getQuantity() < neededTrophy.quantity) {
+            return TRADE_NOT_ENOUGH_TROPHIES;
         }
+    }
 
+    // The trophy quantities are decreased by an amount equal to the quantity that is needed
+    for (const ItemCount& neededTrophy : trophyList) {
+        changeTrophyQuantity(neededTrophy.name, -neededTrophy.quantity);
     }
-    // There are not enough trophies
-    else {
-        cout << "Not enough trophies" << endl;
+
+    // Increase the ingredients' quantities; if an ingredient does not exist, it is added to the list
+    for (const ItemCount& ingredient : ingredientList) {
+        changeIngredientQuantity(ingredient.name, ingredient.quantity);
     }
+
+    return TRADE_SUCCESSFUL;
 }
 
 /**
  * @brief Handles the **brew** action.
  *
- * Checks if the formula for the potion is known. If not, prints “No formula for <potion>”.
- * If the formula is known, checks if all required ingredients are present in sufficient quantity.
- * On success, decrements ingredient quantities and increases potion count, printing
- * “Alchemy item created: <potion>”. If ingredients are insufficient, prints “Not enough ingredients”.
- *
- * @param tokenList Tokenized input line.
- */
-void Geralt::brew(const vector<Token>& tokenList){
-    string potionName = tokenList[2].getContent();
-    auto& potions = Geralt::getPotions();
-    auto& ingredients = Geralt::getIngredients();
-
-    // Potion is in the potions list
-    if (potions.count(potionName) > 0) {
-
-        // If the formula is defined, then check if there are enough ingredients
-        if (potions[potionName]->isFormulaDefined()) {
-            bool enoughIngredients = true;
-
-            // Traverse the formulae list in order to check if all ingredients are present with enough quantity
-            for (const pair<string, int>& formulaIngredient : potions[potionName]->getFormula()) {
-                // Check if the needed ingredient exists in the ingredients list, if it does not exist, mark there are not enough ingredients
-                if (ingredients.count(formulaIngredient.first) == 0) {
-                    enoughIngredients = false;
-                    break;
-                }
-                // If the ingredient exists, check if its quantity is sufficient, if it is insufficient, mark there are not enough ingredients
-                if (ingredients[formulaIngredient.first]->getQuantity() < formulaIngredient.second) {
-                    enoughIngredients = false;
-                    break;
-                }
-            }
+ * Checks if the formula for the potion is known, then if all required ingredients are
+ * present in sufficient quantity. On success, decrements ingredient quantities and
+ * increases the potion count. Brewing stops at the first potion that cannot be made.
+ *
+ * @param potionName Potion to brew.
+ * @param count Number of potions to brew.
+ * @return BrewResult How many potions were created, and why the next one could not be.
+ */
+BrewResult Geralt::brew(string_view potionName, int count) {
+    auto potion = potions.find(potionName);
 
-            // If there are enough ingredients, decrease each of their quantity by the specified amount, and increase the potion's quantity
-            if (enoughIngredients) {
-                for (const pair<string, int>& formulaIngredient : potions[potionName]->getFormula())  {
-                    ingredients[formulaIngredient.first]->decreaseQuantity(formulaIngredient.second);
-                }
-                potions[potionName]->increaseQuantity(1);
+    // Potion is not in the potions list or its formula is not known
+    if (potion == potions.end() || !potion->second->isFormulaDefined()) {
+        return {BREW_NO_FORMULA, 0};
+    }
 
-                cout << "Alchemy item created: " <<  potionName << endl;
-            }
-            else {
-            cout << "Not enough ingredients" << endl;
+    for (int brewed = 0; brewed < count; brewed++) {
+        // Traverse the formulae list in order to check if all ingredients are present with enough quantity
+        for (const pair<Name, int>& formulaIngredient : potion->second->getFormula()) {
+            auto ingredient = ingredients.find(formulaIngredient.first);
+
+            // If the needed ingredient does not exist or its quantity is insufficient, there are not enough ingredients
+            if (ingredient == ingredients.end() || ingredient->second->getQuantity() < formulaIngredient.second) {
+                return {BREW_NOT_ENOUGH_INGREDIENTS, brewed};
             }
         }
-        // Potion formula is not known
-        else {
-            cout << "No formula for " << potionName << endl;
+
+        // There are enough ingredients: decrease each of their quantity by the specified amount, and increase the potion's quantity
+        for (const pair<Name, int>& formulaIngredient : potion->second->getFormula()) {
+            changeIngredientQuantity(formulaIngredient.first, -formulaIngredient.second);
         }
+        changePotionQuantity(potionName, 1);
     }
-    // Potion formula is not known
-    else {
-        cout << "No formula for " << potionName << endl;
-    }
+
+    return {BREW_CREATED, count};
 }
 
 /**
@@ -295,485 +442,650 @@ void Geralt::brew(const vector<Token>& tokenList){
  *
  * Updates the bestiary knowledge by associating the specified sign with the monster.
  * If the monster is new, adds the monster to the bestiary; otherwise, updates its effectiveness list.
- * Prints appropriate output depending on whether knowledge is new or already known.
  *
- * @param tokenList Tokenized input line.
+ * @param signName Sign that is effective.
+ * @param monsterName Monster it is effective against.
+ * @return LearnResult LEARN_NEW_ENTRY for a new monster, LEARN_UPDATED or LEARN_ALREADY_KNOWN otherwise.
  */
-void Geralt::learnSign(const vector<Token>& tokenList) {
-    string signName = tokenList[2].getContent();
-    string monsterName = tokenList[7].getContent();
-    auto& monsters = Geralt::getMonsters();
-
-    // If it is the first time monster is mentioned, it is added to the list and effective sign is added
-    if (monsters.count(monsterName) == 0) {
-        shared_ptr<Monster> newMonster = make_shared<Monster>(monsterName);
-        monsters.emplace(monsterName, newMonster);
-
-        vector<string> effectiveSigns = monsters[monsterName]->getEffectiveSigns();
+LearnResult Geralt::learnSign(string_view signName, string_view monsterName) {
+    uint64_t membership = monsterGenerations.membership;
 
-        // Add the sign if it is not already in the list
-        if (std::find(effectiveSigns.begin(), effectiveSigns.end(), signName) == effectiveSigns.end()) {
-            monsters[monsterName]->addEffectiveSign(signName);
-        }
+    // If it is the first time monster is mentioned, it is added to the list
+    shared_ptr<Monster>& monster = monsterEntry(monsterName);
+    bool newMonster = monsterGenerations.membership != membership;
+    const vector<Name>& effectiveSigns = monster->getEffectiveSigns();
 
-        cout << "New bestiary entry added: " << monsterName << endl;
+    // Sign is already in the list
+    if (std::find(effectiveSigns.begin(), effectiveSigns.end(), signName) != effectiveSigns.end()) {
+        return newMonster ? LEARN_NEW_ENTRY : LEARN_ALREADY_KNOWN;
     }
-    // If the monster is already in the list, add the effective sign
-    else {
-        vector<string> effectiveSigns = monsters[monsterName]->getEffectiveSigns();
 
-        // Add the sign if it is not already in the list
-        if (std::find(effectiveSigns.begin(), effectiveSigns.end(), signName) == effectiveSigns.end()) {
-            monsters[monsterName]->addEffectiveSign(signName);
-            cout << "Bestiary entry updated: " << monsterName << endl;
-        }
-        // Sign is already in the list
-        else {
-            cout << "Already known effectiveness" << endl;
-        }
-    }
+    monster->addEffectiveSign(signName);
+    monsterGenerations.contents++;
+    return newMonster ? LEARN_NEW_ENTRY : LEARN_UPDATED;
 }
 
 /**
  * @brief Registers a new potion as effective against a monster in the bestiary and potion inventory.
  *
  * Updates bestiary and potion knowledge. Adds the monster or potion if new, and associates
- * the potion as effective against the monster. Prints output according to whether knowledge is new or already known.
+ * the potion as effective against the monster.
  *
- * @param tokenList Tokenized input line.
+ * @param potionName Potion that is effective.
+ * @param monsterName Monster it is effective against.
+ * @return LearnResult LEARN_NEW_ENTRY for a new monster, LEARN_UPDATED or LEARN_ALREADY_KNOWN otherwise.
  */
-void Geralt::learnPotion(const vector<Token>& tokenList) {
-    string potionName = tokenList[2].getContent();
-    string monsterName = tokenList[7].getContent();
-    auto& monsters = Geralt::getMonsters();
-    auto& potions = Geralt::getPotions();
-
-    // If it is the first time monster is mentioned, it is added to the list and effective potion is added
-    if (monsters.count(monsterName) == 0) {
-        shared_ptr<Monster> newMonster = make_shared<Monster>(monsterName);
-        monsters.emplace(monsterName, newMonster);
+LearnResult Geralt::learnPotion(string_view potionName, string_view monsterName) {
+    uint64_t membership = monsterGenerations.membership;
 
-        vector<string> effectivePotions = monsters[monsterName]->getEffectivePotions();
+    // If it is the first time monster is mentioned, it is added to the list
+    shared_ptr<Monster>& monster = monsterEntry(monsterName);
+    bool newMonster = monsterGenerations.membership != membership;
+    const vector<Name>& effectivePotions = monster->getEffectivePotions();
 
-        // Add the potion if it is not already in the list
-        if (std::find(effectivePotions.begin(), effectivePotions.end(), potionName) == effectivePotions.end()) {
-            monsters[monsterName]->addEffectivePotion(potionName);
-        }
-        // If this is the first time potion is encountered, it is added to the potions list
-        if (potions.count(potionName) == 0) {
-            shared_ptr<Potion> newPotion = make_shared<Potion>(potionName);
-            potions.emplace(potionName, newPotion);
-        }
+    // If this is the first time potion is encountered, it is added to the potions list
+    potionEntry(potionName);
 
-        cout << "New bestiary entry added: " << monsterName << endl;
+    // Potion is already in the list
+    if (std::find(effectivePotions.begin(), effectivePotions.end(), potionName) != effectivePotions.end()) {
+        return newMonster ? LEARN_NEW_ENTRY : LEARN_ALREADY_KNOWN;
     }
-    // If the monster is already in the list, effective potion is added
-    else {
-        vector<string> effectivePotions = monsters[monsterName]->getEffectivePotions();
 
-        // If this is the first time potion is encountered, it is added to the potion list
-        if (potions.count(potionName) == 0) {
-            shared_ptr<Potion> newPotion = make_shared<Potion>(potionName);
-            potions.emplace(potionName, newPotion);
-        }
-
-        // Add the potion if it is not already in the effective potions list
-        if (std::find(effectivePotions.begin(), effectivePotions.end(), potionName) == effectivePotions.end()) {
-            monsters[monsterName]->addEffectivePotion(potionName);
-            cout << "Bestiary entry updated: " << monsterName << endl;
-        }
-        // Potion is already in the list
-        else {
-            cout << "Already known effectiveness" << endl;
-        }
-    }
+    monster->addEffectivePotion(potionName);
+    monsterGenerations.contents++;
+    return newMonster ? LEARN_NEW_ENTRY : LEARN_UPDATED;
 }
 
 /**
  * @brief Learns and stores a new alchemy formula for a potion.
  *
- * Parses `<quantity> <ingredient>` pairs and defines the potion's formula if not already known.
- * Adds new ingredients to inventory if needed. Prints output indicating new formula or if already known.
+ * Defines the potion's formula if not already known, adding new ingredients to the inventory if needed.
  *
- * @param tokenList Tokenized input line.
+ * @param potionName Potion whose formula is learned.
+ * @param ingredientList Ingredients of the formula and their quantities.
+ * @return LearnResult LEARN_NEW_ENTRY, or LEARN_ALREADY_KNOWN if the potion already had a formula.
  */
-void Geralt::learnFormula(const vector<Token>& tokenList) {
-    string potionName = tokenList[2].getContent();
-    auto& potions = Geralt::getPotions();
-    auto& ingredients = Geralt::getIngredients();
-
+LearnResult Geralt::learnFormula(string_view potionName, Span<ItemCount> ingredientList) {
     // If this is the first time potion is encountered, it is added to the potion list
-    if (potions.count(potionName) == 0) {
-        shared_ptr<Potion> newPotion = make_shared<Potion>(potionName);
-        potions.emplace(potionName, newPotion);
-    }
-        
+    shared_ptr<Potion>& potion = potionEntry(potionName);
+
     // If the formula is already defined, do not update the formula
-    if (potions[potionName]->isFormulaDefined()) {
-        cout << "Already known formula" << endl; 
-    }
-    // If the formula is not already known, the formula is added to the potion
-    else {
-        int i = 6;
-        while (i+1 < tokenList.size()) {
-            int quantity = stoi(tokenList[i].getContent());
-            string ingredientName = tokenList[i+1].getContent();
-
-            // If this is the first time that ingredient is encountered, it is added to the ingredient list
-            if (ingredients.count(ingredientName) == 0) {
-                shared_ptr<Ingredient> newIngredient = make_shared<Ingredient>(ingredientName, 0);
-                ingredients.emplace(ingredientName, newIngredient);
-            }
+    if (potion->isFormulaDefined()) {
+        return LEARN_ALREADY_KNOWN;
+    }
 
-            potions[potionName]->addToFormula(quantity, ingredientName);
+    for (const ItemCount& ingredient : ingredientList) {
+        // If this is the first time that ingredient is encountered, it is added to the ingredient list
+        ingredientEntry(ingredient.name);
 
-            // If there are not any ingredients that need to be added to the formula, get out of the loop
-            if (i+2 >= tokenList.size()) {
-                break;
-            }
-            // If there are still more ingredients, keep iterating through the input sentence
-            i += 3;
-        }
-        potions[potionName]->defineFormula();
-
-        cout << "New alchemy formula obtained: " << potionName << endl;
+        potion->addToFormula(ingredient.quantity, ingredient.name);
     }
+    potion->defineFormula();
+    potionGenerations.contents++;
+    formulaGeneration++;
+
+    return LEARN_NEW_ENTRY;
 }
 
 /**
  * @brief Resolves a monster encounter.
  *
  * Determines whether Geralt can defeat the monster based on known effective
- * signs/potions and available potion quantities, updates trophies and potion
- * counts accordingly, and prints the outcome line defined by the spec.
+ * signs/potions and available potion quantities, and updates trophies and potion
+ * counts accordingly.
  *
- * @param tokenList Tokenized input line.
+ * @param monsterName Monster that is encountered.
+ * @return EncounterResult ENCOUNTER_DEFEATED or ENCOUNTER_UNPREPARED.
  */
-void Geralt::encounter(const vector<Token>& tokenList) {
-    string monsterName = tokenList[3].getContent();
-    auto& monsters = Geralt::getMonsters();
-    auto& potions = Geralt::getPotions();
-    auto& trophies = Geralt::getTrophies();
-    
+EncounterResult Geralt::encounter(string_view monsterName) {
+    auto monster = monsters.find(monsterName);
+
     // If this is the first time this monster's name is encountered, 
     // there are not any effective signs or potions, so Geralt is defeated
-    if (monsters.count(monsterName) == 0) {
-        cout << "Geralt is unprepared and barely escapes with his life" << endl;
-    }
-    // Monster is encountered before
-    else {
-        bool can_defeat = false;
-        // If there is an effective sign, Geralt can defeat the monster
-        if (monsters[monsterName]->getEffectiveSigns().size() > 0) {
+    if (monster == monsters.end()) {
+        return ENCOUNTER_UNPREPARED;
+    }
+
+    const vector<Name>& effectivePotions = monster->second->getEffectivePotions();
+    bool can_defeat = false;
+    // If there is an effective sign, Geralt can defeat the monster
+    if (monster->second->getEffectiveSigns().size() > 0) {
+        can_defeat = true;
+    }
+    // If there is an effective potion, and its quantity is greater than 0, Geralt can defeat the monster
+    for (const Name& potionName : effectivePotions) {
+        auto potion = potions.find(potionName);
+        if (potion != potions.end() && potion->second->getQuantity() > 0) {
             can_defeat = true;
+            break;
         }
-        // If there is an effective potion, and its quantity is greater than 0, Geralt can defeat the monster
-        if (monsters[monsterName]->getEffectivePotions().size() > 0) {
-            for (string potionName : monsters[monsterName]->getEffectivePotions()) {
-                if (potions[potionName]->getQuantity() > 0) {
-                    can_defeat = true;
-                    break;
-                }
-            }
+    }
+
+    // If Geralt does not have enough knowledge or resources, he is defeated
+    if (!can_defeat) {
+        return ENCOUNTER_UNPREPARED;
+    }
+
+    // Geralt consumes each potion he has against the monster
+    for (const Name& potionName : effectivePotions) {
+        auto potion = potions.find(potionName);
+        if (potion != potions.end() && potion->second->getQuantity() >= 1) {
+            changePotionQuantity(potionName, -1);
         }
+    }
+    // Geralt earns a trophy
+    // If the trophy is earned before, its quantity is incremented
+    // If it is the first time that Geralt earns this trophy, it is added to the trophy list, and its quantity is incremented
+    changeTrophyQuantity(monsterName, 1);
 
-        if (can_defeat) {
-            cout << "Geralt defeats " << monsterName << endl;
-
-            // Geralt consumes each potion he has against the monster
-            for (string potionName : monsters[monsterName]->getEffectivePotions()) {
-                // If that potion is present, consume it
-                if (potions.count(potionName) > 0) {
-                    if (potions[potionName]->getQuantity() >= 1) {
-                        potions[potionName]->decreaseQuantity(1);
-                    }
-                }
-            }
-            // Geralt earns a trophy
-            // If the trophy is earned before, its quantity is incremented
-            if (trophies.count(monsterName) > 0) {
-                trophies[monsterName]->increaseQuantity(1);
-            }
-            // If it is the first time that Geralt earns this trophy, it is added to the trophy list, and its quantity is incremented
-            else {
-                shared_ptr<Trophy> newTrophy = make_shared<Trophy>(monsterName);
-                trophies.emplace(monsterName, newTrophy);
-                trophies[monsterName]->increaseQuantity(1);
-            }
+    return ENCOUNTER_DEFEATED;
+}
+
+/**
+ * @brief Returns the quantity of an entity, or 0 if it is not in the collection.
+ */
+template <typename Entity>
+static int quantityOf(EntityMap<Entity>& collection, string_view name) {
+    auto it = collection.find(name);
+    return it == collection.end() ? 0 : it->second->getQuantity();
+}
+
+int Geralt::ingredientQuantity(string_view name) {
+    return quantityOf(ingredients, name);
+}
+
+int Geralt::potionQuantity(string_view name) {
+    return quantityOf(potions, name);
+}
+
+int Geralt::trophyQuantity(string_view name) {
+    return quantityOf(trophies, name);
+}
+
+/**
+ * @brief Looks up many names in one sorted pass over a collection.
+ *
+ * Each name is searched from the position of the previous one: a few steps forward
+ * find it when the names are close in the map, and a lower_bound from there otherwise.
+ */
+template <typename Entity>
+static void quantitiesOf(EntityMap<Entity>& collection, Span<string_view> names, pmr::vector<int>& quantities) {
+    constexpr int MAX_STEPS = 2;
+
+    quantities.assign(names.size(), 0);
+
+    pmr::vector<uint32_t> order(names.size(), 0, quantities.get_allocator().resource());
+    for (uint32_t k = 0; k < order.size(); k++) {
+        order[k] = k;
+    }
+    sort(order.begin(), order.end(), [&names](uint32_t a, uint32_t b) {
+        return names[a] < names[b];
+    });
+
+    auto it = collection.begin();
+    for (uint32_t k : order) {
+        int steps = 0;
+        while (it != collection.end() && it->first.view() < names[k] && steps < MAX_STEPS) {
+            ++it;
+            steps++;
+        }
+        if (steps == MAX_STEPS) {
+            it = collection.lower_bound(names[k]);
         }
-        // If Geralt does not have enough knowledge or resources, he is defeated
-        else {
-            cout << "Geralt is unprepared and barely escapes with his life" << endl;
+
+        if (it != collection.end() && it->first.view() == names[k]) {
+            quantities[k] = it->second->getQuantity();
         }
     }
 }
 
+void Geralt::ingredientQuantities(Span<string_view> names, pmr::vector<int>& quantities) {
+    quantitiesOf(ingredients, names, quantities);
+}
+
+void Geralt::potionQuantities(Span<string_view> names, pmr::vector<int>& quantities) {
+    quantitiesOf(potions, names, quantities);
+}
+
+void Geralt::trophyQuantities(Span<string_view> names, pmr::vector<int>& quantities) {
+    quantitiesOf(trophies, names, quantities);
+}
+
 /**
- * @brief Prints the quantity of the given ingredient.
- *
- * @param tokenList Tokenized input line.
+ * @brief Lists the entities of a collection whose quantity is greater than 0, in alphabetical order.
  */
-void Geralt::querySpecificIngredient(const vector<Token>& tokenList) {
-    string ingredientName = tokenList[2].getContent();
-    auto& ingredients = Geralt::getIngredients();
-    
-    // Ingredient is not in the inventory
-    if (ingredients.count(ingredientName) == 0) {
-        cout << 0 << endl;
+template <typename Entity>
+static void stockOf(EntityMap<Entity>& collection, pmr::vector<ItemCount>& stock) {
+    stock.clear();
+    for (const auto& entityPair : collection) {
+        int quantity = entityPair.second->getQuantity();
+        if (quantity > 0) {
+            stock.push_back({entityPair.first.view(), quantity});
+        }
     }
-    // Ingredient is in the inventory, print its quantity
-    else {
-        int quantity = ingredients[ingredientName]->getQuantity();
-        cout << quantity << endl;
+}
+
+void Geralt::ingredientStock(pmr::vector<ItemCount>& stock) {
+    stockOf(ingredients, stock);
+}
+
+void Geralt::potionStock(pmr::vector<ItemCount>& stock) {
+    stockOf(potions, stock);
+}
+
+void Geralt::trophyStock(pmr::vector<ItemCount>& stock) {
+    stockOf(trophies, stock);
+}
+
+void Geralt::enableHistory(uint64_t interval) {
+    ingredientHistory.clear();
+    potionHistory.clear();
+    trophyHistory.clear();
+
+    // The current state is the first checkpoint
+    for (const auto& entityPair : ingredients) {
+        ingredientHistory.record(version, entityPair.second->getId(), entityPair.second->getQuantity());
+    }
+    for (const auto& entityPair : potions) {
+        potionHistory.record(version, entityPair.second->getId(), entityPair.second->getQuantity());
     }
+    for (const auto& entityPair : trophies) {
+        trophyHistory.record(version, entityPair.second->getId(), entityPair.second->getQuantity());
+    }
+    ingredientHistory.checkpoint(version);
+    potionHistory.checkpoint(version);
+    trophyHistory.checkpoint(version);
+
+    historyInterval = interval > 0 ? interval : 1;
+    lastCheckpoint = version;
+}
+
+void Geralt::beginVersion() {
+    // The versions of the interval that just ended are folded into a checkpoint
+    if (historyInterval != 0 && version - lastCheckpoint >= historyInterval) {
+        ingredientHistory.checkpoint(version);
+        potionHistory.checkpoint(version);
+        trophyHistory.checkpoint(version);
+        lastCheckpoint = version;
+    }
+    version++;
+}
+
+bool Geralt::isHistoryEnabled() {
+    return historyInterval != 0;
+}
+
+uint64_t Geralt::getVersion() {
+    return version;
 }
 
 /**
- * @brief Prints the quantity of the given potion.
- *
- * @param tokenList Tokenized input line.
+ * @brief Reads the quantity of an entity after a past version, or its current quantity.
  */
-void Geralt::querySpecificPotion(const vector<Token>& tokenList) {
-    string potionName = tokenList[2].getContent();
-    auto& potions = Geralt::getPotions();
+template <typename Entity>
+static int quantityAt(EntityMap<Entity>& collection, const StockHistory& history, uint64_t historyInterval,
+                      uint64_t version, string_view name, uint64_t at) {
+    if (historyInterval == 0 || at >= version) {
+        return quantityOf(collection, name);
+    }
 
-    // Potion is not in the inventory
-    if (potions.count(potionName) == 0) {
-        cout << 0 << endl;
+    auto it = collection.find(name);
+    if (it == collection.end()) {
+        return 0;
     }
-    // Potion is in the inventory, print its quantity
-    else {
-        int quantity = potions[potionName]->getQuantity();
-        cout << quantity << endl;
+    return history.at(at, CommandArena::resource()).quantity(it->second->getId());
+}
+
+/**
+ * @brief Lists the entities of a collection with a positive quantity after a past version, in alphabetical order.
+ *
+ * Entities that are gone now were gone then too, since only a reset removes entities.
+ */
+template <typename Entity>
+static void stockAt(EntityMap<Entity>& collection, const StockHistory& history, uint64_t historyInterval,
+                    uint64_t version, uint64_t at, pmr::vector<ItemCount>& stock) {
+    if (historyInterval == 0 || at >= version) {
+        stockOf(collection, stock);
+        return;
     }
+
+    StockHistory::View past = history.at(at, stock.get_allocator().resource());
+    stock.clear();
+    for (const auto& entityPair : collection) {
+        int quantity = past.quantity(entityPair.second->getId());
+        if (quantity > 0) {
+            stock.push_back({entityPair.first.view(), quantity});
+        }
+    }
+}
+
+int Geralt::ingredientQuantityAt(string_view name, uint64_t at) {
+    return quantityAt(ingredients, ingredientHistory, historyInterval, version, name, at);
+}
+
+int Geralt::potionQuantityAt(string_view name, uint64_t at) {
+    return quantityAt(potions, potionHistory, historyInterval, version, name, at);
+}
+
+int Geralt::trophyQuantityAt(string_view name, uint64_t at) {
+    return quantityAt(trophies, trophyHistory, historyInterval, version, name, at);
+}
+
+void Geralt::ingredientStockAt(uint64_t at, pmr::vector<ItemCount>& stock) {
+    stockAt(ingredients, ingredientHistory, historyInterval, version, at, stock);
+}
+
+void Geralt::potionStockAt(uint64_t at, pmr::vector<ItemCount>& stock) {
+    stockAt(potions, potionHistory, historyInterval, version, at, stock);
+}
+
+void Geralt::trophyStockAt(uint64_t at, pmr::vector<ItemCount>& stock) {
+    stockAt(trophies, trophyHistory, historyInterval, version, at, stock);
+}
+
+bool Geralt::undoing() {
+    return whatIfLog.open || transactionLog.open;
 }
 
 /**
- * @brief Prints the quantity of the given trophy.
+ * @brief Keeps a copy of an entity in the innermost open undo log, the first time the log reaches it.
  *
- * @param tokenList Tokenized input line.
+ * @param records Records of the entity's collection in an UndoLog.
+ * @param slot Map slot of the entity about to be changed.
+ * @param added true when the entity has just been added.
  */
-void Geralt::querySpecificTrophy(const vector<Token>& tokenList) {
-    string trophyName = tokenList[2].getContent();
-    auto& trophies = Geralt::getTrophies();
+template <typename Entity>
+void Geralt::touch(UndoRecords<Entity> UndoLog::*records, typename EntityMap<Entity>::iterator slot, bool added) {
+    UndoRecords<Entity>& log = (whatIfLog.open ? whatIfLog : transactionLog).*records;
+    uint32_t id = slot->second->getId();
 
-    // Trophy is not in the inventory
-    if (trophies.count(trophyName) == 0) {
-        cout << 0 << endl;
+    if (id < log.recorded.size() && log.recorded[id]) {
+        return;
     }
-    // Trophy is in the inventory, print its quantity
-    else {
-        int quantity = trophies[trophyName]->getQuantity();
-        cout << quantity << endl;
+    if (id >= log.recorded.size()) {
+        log.recorded.resize(id + 1);
     }
+    log.recorded[id] = true;
+    log.records.push_back(UndoRecord<Entity>{slot, *slot->second, added});
 }
 
 /**
- * @brief Prints all the ingredients and their quantities.
+ * @brief Puts back the recorded entities of a collection, newest first, and removes the added ones.
  *
- * @param tokenList Tokenized input line.
+ * The entities get their own generation counters back along with the rest of their
+ * state, so an answer cached meanwhile would look valid again once the counter climbs
+ * back; rollbackTransaction() drops the query cache for that reason. A what-if runs no
+ * query, so the answers cached before it stay valid. The collection counters move
+ * forward instead, since structures built meanwhile describe the undone state.
+ *
+ * @param ranking Stock ranking of the collection; nullptr for the bestiary.
+ * @param names Name index of the collection, dropped when an entity is removed, since a
+ *        search may have indexed it meanwhile; nullptr for the bestiary.
  */
-void Geralt::queryAllIngredients(const vector<Token>& tokenList) {
-    auto& ingredients = Geralt::getIngredients();
-
-    // There are no ingredients in the inventory
-    if (ingredients.size() == 0) {
-        cout << "None" << endl;
+template <typename Entity>
+void Geralt::undo(EntityMap<Entity>& collection, UndoRecords<Entity>& log, StockRanking* ranking, NameIndex* names,
+                  CollectionGenerations& generations) {
+    if (log.records.empty()) {
+        return;
     }
-    else {
-        bool first = true;
-        bool ingredientExists = false;
-        // For each element in the ingredients map, print out the ingredient name with its quantity
-        for (const auto& ingredientPair : ingredients) {
-            string ingredientName = ingredientPair.first;
-            int quantity = ingredientPair.second->getQuantity();
-            // Ingredient is printed with its quantity if its quantity is greater than 0
-            if (quantity > 0) {
-                if (!first) {
-                    cout << ", ";
-                }
-                first = false;
-                ingredientExists = true;
-                cout << quantity << " " << ingredientName;
-            }
-        }
-        // Go to new line
-        if (ingredientExists) {
-            cout << endl;
+
+    for (auto it = log.records.rbegin(); it != log.records.rend(); ++it) {
+        Entity& entity = *it->slot->second;
+        log.recorded[it->before.getId()] = false;
+
+        if constexpr (!is_same_v<Entity, Monster>) {
+            ranking->update(it->slot->first.view(), entity.getQuantity(), it->added ? 0 : it->before.getQuantity());
         }
-        // If none of the ingredients have a quantity greater than 0, print none
-        else {
-            cout << "None" << endl;
+
+        // Entities are added at the end of the IDs, and removed newest first, so IDs stay dense
+        if (it->added) {
+            collection.erase(it->slot);
+            generations.membership++;
+            generations.removals++;
+            if (names != nullptr) {
+                names->invalidate();
+            }
+        } else {
+            entity = it->before;
         }
     }
+
+    generations.contents++;
+    log.records.clear();
 }
 
 /**
- * @brief Prints all the potions and their quantities.
+ * @brief Forgets the records of a collection, catching up with what was held back for them.
  *
- * @param tokenList Tokenized input line.
+ * New names go into the name index, and every entity whose quantity changed gets one
+ * history change and one feed delta, from its quantity before the first record to now.
  */
-void Geralt::queryAllPotions(const vector<Token>& tokenList) {
-    auto& potions = Geralt::getPotions();
+template <typename Entity>
+void Geralt::keep(UndoRecords<Entity>& log, NameIndex& names, StockHistory& history, ChangeFeed::Collection collection) {
+    for (UndoRecord<Entity>& record : log.records) {
+        Entity& entity = *record.slot->second;
+        log.recorded[entity.getId()] = false;
+
+        if (record.added) {
+            names.update(record.slot->first.view());
+        }
 
-    // There are no potions in the inventory
-    if (potions.size() == 0) {
-        cout << "None" << endl;
+        int before = record.before.getQuantity();
+        if (entity.getQuantity() == before) {
+            continue;
+        }
+        if (historyInterval != 0) {
+            history.record(version, entity.getId(), entity.getQuantity());
+        }
+        if (ChangeFeed::isOpen()) {
+            ChangeFeed::publish(collection, entity.getId(), entity.getName().view(), before, entity.getQuantity(), version);
+        }
     }
-    else {
-        bool first = true;
-        bool potionExists = false;
-        // For each element in the potions map, print out the potion name with its quantity
-        for (const auto& potionPair : potions) {
-            string potionName = potionPair.first;
-            int quantity = potionPair.second->getQuantity();
-            // Ingredient is printed with its quantity if its quantity is greater than 0
-            if (quantity > 0) {
-                if (!first) {
-                    cout << ", ";
-                }
-                first = false;
-                potionExists = true;
-                cout << quantity << " " << potionName;
-            }
+
+    log.records.clear();
+}
+
+/// Undoes every record of a log, newest first, and closes it.
+void Geralt::rollback(UndoLog& log) {
+    bool formulasTouched = !log.potions.records.empty();
+
+    undo(ingredients, log.ingredients, &ingredientRanking, &ingredientNames, ingredientGenerations);
+    undo(potions, log.potions, &potionRanking, &potionNames, potionGenerations);
+    undo(monsters, log.monsters, nullptr, nullptr, monsterGenerations);
+    undo(trophies, log.trophies, &trophyRanking, &trophyNames, trophyGenerations);
+
+    if (formulasTouched) {
+        formulaGeneration++;
+    }
+    log.open = false;
+}
+
+void Geralt::beginWhatIf() {
+    whatIfLog.open = true;
+}
+
+void Geralt::whatIfChanges(pmr::vector<ItemCount>& changes) {
+    changes.clear();
+    for (auto& record : whatIfLog.ingredients.records) {
+        if (record.slot->second->getQuantity() != record.before.getQuantity()) {
+            changes.push_back({record.slot->first.view(), record.slot->second->getQuantity()});
         }
-        // Go to new line
-        if (potionExists) {
-            cout << endl;
+    }
+    for (auto& record : whatIfLog.potions.records) {
+        if (record.slot->second->getQuantity() != record.before.getQuantity()) {
+            changes.push_back({record.slot->first.view(), record.slot->second->getQuantity()});
         }
-        // If none of the potions have a quantity greater than 0, print none
-        else {
-            cout << "None" << endl;
+    }
+    for (auto& record : whatIfLog.trophies.records) {
+        if (record.slot->second->getQuantity() != record.before.getQuantity()) {
+            changes.push_back({record.slot->first.view(), record.slot->second->getQuantity()});
         }
     }
 }
 
+void Geralt::discardWhatIf() {
+    rollback(whatIfLog);
+}
+
+bool Geralt::beginTransaction() {
+    if (transactionLog.open || whatIfLog.open) {
+        return false;
+    }
+    transactionLog.open = true;
+    return true;
+}
+
+bool Geralt::commitTransaction() {
+    if (!transactionLog.open || whatIfLog.open) {
+        return false;
+    }
+
+    // Closed first, so that the held back work is done as for any change outside a transaction
+    transactionLog.open = false;
+    keep(transactionLog.ingredients, ingredientNames, ingredientHistory, ChangeFeed::INGREDIENT);
+    keep(transactionLog.potions, potionNames, potionHistory, ChangeFeed::POTION);
+    keep(transactionLog.trophies, trophyNames, trophyHistory, ChangeFeed::TROPHY);
+
+    // The bestiary has neither names nor history to catch up with
+    for (UndoRecord<Monster>& record : transactionLog.monsters.records) {
+        transactionLog.monsters.recorded[record.before.getId()] = false;
+    }
+    transactionLog.monsters.records.clear();
+    return true;
+}
+
+bool Geralt::rollbackTransaction() {
+    if (!transactionLog.open || whatIfLog.open) {
+        return false;
+    }
+    rollback(transactionLog);
+
+    // Queries inside the transaction cached answers under generations that undo() took back
+    QueryCache::clear();
+    return true;
+}
+
+bool Geralt::inTransaction() {
+    return transactionLog.open;
+}
+
 /**
- * @brief Prints all the trophies and their quantities.
- *
- * @param tokenList Tokenized input line.
+ * @brief Lists the largest or smallest stocks of a collection from its ranking, building the ranking first if needed.
  */
-void Geralt::queryAllTrophies(const vector<Token>& tokenList) {
-    auto& trophies = Geralt::getTrophies();
+template <typename Entity>
+static void rankedOf(EntityMap<Entity>& collection, StockRanking& ranking, size_t count, bool scarcest,
+                     pmr::vector<ItemCount>& ranked) {
+    if (!ranking.isBuilt()) {
+        for (const auto& entityPair : collection) {
+            ranking.insert(entityPair.second->getName().view(), entityPair.second->getQuantity());
+        }
+        ranking.markBuilt();
+    }
 
-    // There are no trophies in the inventory
-    if (trophies.size() == 0) {
-        cout << "None" << endl;
+    if (scarcest) {
+        ranking.smallest(count, ranked);
+    } else {
+        ranking.largest(count, ranked);
     }
-    else {
-        bool first = true;
-        bool trophyExists = false;
-        // For each element in the trophies map, print out the trophy name with its quantity
-        for (const auto& trophyPair : trophies) {
-            string trophyName = trophyPair.first;
-            int quantity = trophyPair.second->getQuantity();
-            // Ingredient is printed with its quantity if its quantity is greater than 0
-            if (quantity > 0) {
-                if (!first) {
-                    cout << ", ";
-                }
-                first = false;
-                trophyExists = true;
-                cout << quantity << " " << trophyName;
-            }
-        }
-        // Go to new line
-        if (trophyExists) {
-            cout << endl;
-        }
-        // If none of the trophies have a quantity greater than 0, print none
-        else {
-            cout << "None" << endl;
+}
+
+void Geralt::rankedIngredients(size_t count, bool scarcest, pmr::vector<ItemCount>& ranked) {
+    rankedOf(ingredients, ingredientRanking, count, scarcest, ranked);
+}
+
+void Geralt::rankedPotions(size_t count, bool scarcest, pmr::vector<ItemCount>& ranked) {
+    rankedOf(potions, potionRanking, count, scarcest, ranked);
+}
+
+void Geralt::rankedTrophies(size_t count, bool scarcest, pmr::vector<ItemCount>& ranked) {
+    rankedOf(trophies, trophyRanking, count, scarcest, ranked);
+}
+
+/**
+ * @brief Searches the names of a collection in its index, building the index first if needed.
+ */
+template <typename Entity>
+static void namesLike(EntityMap<Entity>& collection, NameIndex& index, string_view text, bool similar,
+                      pmr::vector<string_view>& names) {
+    if (!index.isBuilt()) {
+        for (const auto& entityPair : collection) {
+            index.insert(entityPair.second->getName().view());
         }
+        index.markBuilt();
+    }
+
+    if (similar) {
+        index.similar(text, names);
+    } else {
+        index.withPrefix(text, names);
     }
 }
 
+void Geralt::ingredientNamesLike(string_view text, bool similar, pmr::vector<string_view>& names) {
+    namesLike(ingredients, ingredientNames, text, similar, names);
+}
+
+void Geralt::potionNamesLike(string_view text, bool similar, pmr::vector<string_view>& names) {
+    namesLike(potions, potionNames, text, similar, names);
+}
+
+void Geralt::trophyNamesLike(string_view text, bool similar, pmr::vector<string_view>& names) {
+    namesLike(trophies, trophyNames, text, similar, names);
+}
+
 /**
  * @brief Lists all known effective signs and potions against a monster.
  *
- * Merges two vectors, sorts, and prints them comma‑separated,
- * or prints “No knowledge of <monster>” if none exist.
+ * Signs and potions are merged into one list and sorted alphabetically.
  *
- * @param tokenList Tokenized input line.
+ * @param monsterName Monster to look up.
+ * @param effective Receives the names; empty if nothing is known.
  */
-void Geralt::queryEffectiveness(const vector<Token>& tokenList) {
-    auto& monsters = Geralt::getMonsters();
+void Geralt::effectiveAgainst(string_view monsterName, pmr::vector<string_view>& effective) {
+    effective.clear();
 
-    string monsterName = tokenList[4].getContent();
-
-    // If the monster is present in the monsters map, print its effective signs and potions
-    if (monsters.count(monsterName) > 0) {
-        vector<string> effectiveSigns = monsters[monsterName]->getEffectiveSigns();
-        vector<string> effectivePotions = monsters[monsterName]->getEffectivePotions();
+    auto monster = monsters.find(monsterName);
+    if (monster == monsters.end()) {
+        return;
+    }
 
-        // Merge signs and potions in order to sort and print them in descending order
-        vector<string> mergedVector;
+    const vector<Name>& effectiveSigns = monster->second->getEffectiveSigns();
+    const vector<Name>& effectivePotions = monster->second->getEffectivePotions();
 
-        // Add the sign names
-        for (string signName : effectiveSigns) {
-            mergedVector.push_back(signName);
-        }
-        // Add the potion names
-        for (string potionName : effectivePotions) {
-            mergedVector.push_back(potionName);
-        }
-        // Sort the merged vector
-        sort(mergedVector.begin(), mergedVector.end());
-        
-        // Effective signs and potions are printed
-        if (mergedVector.size() > 0) {
-            bool first = true;
-            for (string elem : mergedVector) {
-                if (!first) {
-                    cout << ", ";
-                }
-                cout << elem;
-                first = false;
-            }
-            cout << endl;
-        }
-        // If the total size is zero, then there is no knowledge of signs or potions
-        else {
-            cout << "No knowledge of " << monsterName << endl;
-        }
+    // Merge signs and potions in order to sort them together
+    effective.reserve(effectiveSigns.size() + effectivePotions.size());
+    for (const Name& signName : effectiveSigns) {
+        effective.push_back(signName.view());
     }
-    // If the monster is not present in the monsters map, there is no knowledge about effective signs or potions
-    else {
-        cout << "No knowledge of " << monsterName << endl;
+    for (const Name& potionName : effectivePotions) {
+        effective.push_back(potionName.view());
     }
+    sort(effective.begin(), effective.end());
 }
 
 /**
- * @brief Prints the sorted formula for a potion.
+ * @brief Returns the sorted formula for a potion.
  *
- * Sorts potions by descending quantity, secondary ascending by name.
+ * Ingredients are sorted by descending quantity, secondary ascending by name.
  *
- * @param tokenList Tokenized query line.
+ * @param potionName Potion to look up.
+ * @param ingredientList Receives the formula.
+ * @return true If the potion has a known formula.
  */
-void Geralt::queryFormula(const vector<Token>& tokenList) {
-    auto& potions = Geralt::getPotions();
+bool Geralt::formula(string_view potionName, pmr::vector<ItemCount>& ingredientList) {
+    ingredientList.clear();
 
-    string potionName = tokenList[3].getContent();
-    // If the potion does not exist, there is no formula for that
-    if (potions.count(potionName) == 0) {
-        cout << "No formula for " << potionName << endl;
+    auto potion = potions.find(potionName);
+
+    // If the potion does not exist or its formula is not defined, there is no formula for that
+    if (potion == potions.end() || !potion->second->isFormulaDefined()) {
+        return false;
     }
-    else {
-        // If there is a formula that is defined, print it
-        if (potions[potionName]->isFormulaDefined()) {
-            bool first = true;
-            for (pair<string, int> formulaPair : potions[potionName]->getSortedFormula()) {
-                if (!first) {
-                    cout << ", ";
-                }
-                first = false;
-                cout << formulaPair.second << " " << formulaPair.first;
-            }
-            cout << endl;
-        }
-        // If there is not a formula that is defined, print no formula
-        else {
-            cout << "No formula for " << potionName << endl;
-        }
+
+    const vector<pair<Name, int>>& sortedFormula = potion->second->getSortedFormula();
+    ingredientList.reserve(sortedFormula.size());
+    for (const pair<Name, int>& formulaPair : sortedFormula) {
+        ingredientList.push_back({formulaPair.first.view(), formulaPair.second});
     }
-} 
+    return true;
+}
@@ -8,59 +8,329 @@
  * The class stores four static maps that model Geralt’s inventory, bestiary
  * and trophies, and offers high-level actions that correspond to the grammar rules.
  *
- * Every method accepts a tokenized command line and either mutates the
- * shared state or prints the answer required by the specification.
+ * Every method takes typed arguments and returns a typed result; nothing is parsed
+ * or printed here. The sentences of the command language are turned into these calls,
+ * and their results into the answers required by the specification, by Commands.
  */
 
 #include <map>
+#include <memory_resource>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <cstdint>
 
 #include "ingredient.h"
 #include "potion.h"
 #include "sign.h"
 #include "monster.h"
 #include "trophy.h"
-#include "token.h"
+#include "name.h"
+#include "span.h"
+#include "ranking.h"
+#include "nameindex.h"
+#include "history.h"
+#include "changefeed.h"
+
+/**
+ * @brief Map from names to the entities of one of Geralt's collections.
+ *
+ * Both the nodes and the entities live in the EntityPool (see pool.h); keys are compact
+ * Names that can be looked up with any string.
+ */
+template <typename Entity>
+using EntityMap = std::pmr::map<Name, std::shared_ptr<Entity>, NameLess>;
+
+/**
+ * @struct CollectionGenerations
+ * @brief Version counters of one of Geralt's maps, used to validate cached query answers.
+ */
+struct CollectionGenerations {
+    uint64_t contents = 0;      ///< Bumped by any change to the collection or to one of its entities
+    uint64_t membership = 0;    ///< Bumped only when a name is added to or removed from the collection
+    uint64_t removals = 0;      ///< Bumped only when a name is removed from the collection
+};
+
+/**
+ * @struct ItemCount
+ * @brief A name with a quantity: a line of a loot, a trade, a formula or a listing.
+ *
+ * Names returned by queries point into Geralt's state and stay valid until the next
+ * call that changes it.
+ */
+struct ItemCount {
+    std::string_view name;
+    int quantity;
+};
+
+/**
+ * @brief Results of the actions; each value corresponds to one answer of the specification.
+ */
+typedef enum {
+    TRADE_SUCCESSFUL = 0,           // "Trade successful"
+    TRADE_NOT_ENOUGH_TROPHIES       // "Not enough trophies"
+} TradeResult;
+
+typedef enum {
+    BREW_CREATED = 0,               // "Alchemy item created: <potion>"
+    BREW_NOT_ENOUGH_INGREDIENTS,    // "Not enough ingredients"
+    BREW_NO_FORMULA                 // "No formula for <potion>"
+} BrewStatus;
+
+typedef enum {
+    LEARN_NEW_ENTRY = 0,            // "New bestiary entry added: <monster>" / "New alchemy formula obtained: <potion>"
+    LEARN_UPDATED,                  // "Bestiary entry updated: <monster>"
+    LEARN_ALREADY_KNOWN             // "Already known effectiveness" / "Already known formula"
+} LearnResult;
+
+typedef enum {
+    ENCOUNTER_DEFEATED = 0,         // "Geralt defeats <monster>"
+    ENCOUNTER_UNPREPARED            // "Geralt is unprepared and barely escapes with his life"
+} EncounterResult;
+
+/**
+ * @struct BrewResult
+ * @brief Outcome of brewing a potion one or more times.
+ */
+struct BrewResult {
+    BrewStatus status;  ///< BREW_CREATED if every requested potion was brewed, otherwise why the first one failed
+    int brewed;         ///< Number of potions created
+};
 
 /**
  * @class Geralt
  * @brief Class that represents the Witcher’s knowledge and inventory.
  *
- * All members are static; the class is never instantiated.  
+ * All members are static; the class is never instantiated.
  * Users interact with the state via the high-level action/query functions.
  */
 class Geralt {
 private:
     /// These are the data fields that stores the ingredient, potion, monster and trophy data.
-    static std::map<std::string, std::shared_ptr<Ingredient>> ingredients;
-    static std::map<string, shared_ptr<Potion>> potions;
-    static std::map<string, shared_ptr<Monster>> monsters;
-    static std::map<string, shared_ptr<Trophy>> trophies;
+    static EntityMap<Ingredient> ingredients;
+    static EntityMap<Potion> potions;
+    static EntityMap<Monster> monsters;
+    static EntityMap<Trophy> trophies;
+
+    /// Generation counters of the four maps above.
+    static CollectionGenerations ingredientGenerations;
+    static CollectionGenerations potionGenerations;
+    static CollectionGenerations monsterGenerations;
+    static CollectionGenerations trophyGenerations;
+
+    /// Bumped whenever a formula is defined, so that the set of formulas can be cached.
+    static uint64_t formulaGeneration;
+
+    /// Stock of the three counted collections by quantity, moved on every quantity change.
+    static StockRanking ingredientRanking;
+    static StockRanking potionRanking;
+    static StockRanking trophyRanking;
+
+    /// Names of the three counted collections in radix tries, extended by the entry functions below.
+    static NameIndex ingredientNames;
+    static NameIndex potionNames;
+    static NameIndex trophyNames;
+
+    /// Quantities of the three counted collections at every version, while the history is enabled.
+    static StockHistory ingredientHistory;
+    static StockHistory potionHistory;
+    static StockHistory trophyHistory;
+
+    static uint64_t version;            ///< Version of the command being executed; 0 before the first one
+    static uint64_t historyInterval;    ///< Versions between two checkpoints; 0 while the history is off
+    static uint64_t lastCheckpoint;     ///< Version of the newest checkpoint
+
+    /**
+     * @struct UndoRecord
+     * @brief An entity that a what-if or a transaction changed or added, with a copy of it from before.
+     */
+    template <typename Entity>
+    struct UndoRecord {
+        typename EntityMap<Entity>::iterator slot;
+        Entity before;
+        bool added;     ///< The entity was added meanwhile, so undoing removes it
+    };
+
+    /**
+     * @struct UndoRecords
+     * @brief Undo records of one collection, one per entity, in the order the entities were first touched.
+     */
+    template <typename Entity>
+    struct UndoRecords {
+        std::vector<UndoRecord<Entity>> records;
+        std::vector<bool> recorded;     ///< By entity ID: the entity has a record already
+    };
+
+    /**
+     * @struct UndoLog
+     * @brief Undo records of the four collections, kept while a what-if or a transaction is open.
+     */
+    struct UndoLog {
+        bool open = false;
+        UndoRecords<Ingredient> ingredients;
+        UndoRecords<Potion> potions;
+        UndoRecords<Monster> monsters;
+        UndoRecords<Trophy> trophies;
+    };
+
+    /// A what-if can run inside a transaction; entities are recorded in the innermost open log only.
+    static UndoLog whatIfLog;
+    static UndoLog transactionLog;
+
+    /// Returns true while changes are undoable, and their history, feed deltas and names wait.
+    static bool undoing();
+
+    template <typename Entity>
+    static void touch(UndoRecords<Entity> UndoLog::*records, typename EntityMap<Entity>::iterator slot, bool added);
+    template <typename Entity>
+    static void undo(EntityMap<Entity>& collection, UndoRecords<Entity>& log, StockRanking* ranking,
+                     NameIndex* names, CollectionGenerations& generations);
+    template <typename Entity>
+    static void keep(UndoRecords<Entity>& log, NameIndex& names, StockHistory& history, ChangeFeed::Collection collection);
+    static void rollback(UndoLog& log);
+
+    /// Find functions return the entity with the given name, adding it with quantity 0 when it is new.
+    static shared_ptr<Ingredient>& ingredientEntry(std::string_view name);
+    static shared_ptr<Potion>& potionEntry(std::string_view name);
+    static shared_ptr<Monster>& monsterEntry(std::string_view name);
+    static shared_ptr<Trophy>& trophyEntry(std::string_view name);
+
+    /// Every quantity change goes through these functions, which keep the generation counters up to date.
+    static void changeIngredientQuantity(std::string_view name, int amount);
+    static void changePotionQuantity(std::string_view name, int amount);
+    static void changeTrophyQuantity(std::string_view name, int amount);
 public:
     /// Getter functions return the private data fields which are encapsulated and declared private.
-    static std::map<string, shared_ptr<Ingredient>>& getIngredients();
-    static std::map<string, shared_ptr<Potion>>& getPotions();
-    static std::map<string, shared_ptr<Monster>>& getMonsters();
-    static std::map<string, shared_ptr<Trophy>>& getTrophies();
-    
+    static EntityMap<Ingredient>& getIngredients();
+    static EntityMap<Potion>& getPotions();
+    static EntityMap<Monster>& getMonsters();
+    static EntityMap<Trophy>& getTrophies();
+
+    /// Generation counters of the maps, for answers cached outside of this class.
+    static const CollectionGenerations& getIngredientGenerations();
+    static const CollectionGenerations& getPotionGenerations();
+    static const CollectionGenerations& getMonsterGenerations();
+    static const CollectionGenerations& getTrophyGenerations();
+    static const uint64_t& getFormulaGeneration();
+
+    /// Clears every map, returning Geralt to the empty state of a fresh program run.
+    /// The history is dropped and turned off, since loading a state does not go through it.
+    static void reset();
+
+    /// Default number of versions between two checkpoints of the history.
+    static constexpr uint64_t DEFAULT_HISTORY_INTERVAL = 1000;
+
+    /**
+     * @brief Starts recording the quantities of every version, from the current state on.
+     *
+     * @param interval Versions between two checkpoints: a larger interval stores fewer
+     *        copied paths, a smaller one replays fewer changes per past query.
+     */
+    static void enableHistory(uint64_t interval = DEFAULT_HISTORY_INTERVAL);
+
+    /// Returns true once enableHistory() has been called, until the next reset().
+    static bool isHistoryEnabled();
+
+    /// Starts the next version; the driver calls it before every command line.
+    static void beginVersion();
+    static uint64_t getVersion();
+
+    /// Time-travel queries: quantities after the command of version @p at. Versions from the
+    /// current one on give the current quantities; check isHistoryEnabled() first, since
+    /// without a history every version does.
+    static int ingredientQuantityAt(std::string_view name, uint64_t at);
+    static int potionQuantityAt(std::string_view name, uint64_t at);
+    static int trophyQuantityAt(std::string_view name, uint64_t at);
+    static void ingredientStockAt(uint64_t at, std::pmr::vector<ItemCount>& stock);
+    static void potionStockAt(uint64_t at, std::pmr::vector<ItemCount>& stock);
+    static void trophyStockAt(uint64_t at, std::pmr::vector<ItemCount>& stock);
+
+    /**
+     * @brief Starts a what-if: the actions until discardWhatIf() run as usual, but their
+     * changes are undone then.
+     *
+     * The first time an action reaches an entity through an entry function, a copy of the
+     * entity is kept in an undo log, so a what-if costs the entities it touches, not the
+     * size of the collections. Changes made during a what-if are not recorded in the
+     * history, not published to the change feed, and not added to the name indexes.
+     */
+    static void beginWhatIf();
+
+    /**
+     * @brief Lists the counted entities whose quantity the running what-if changed, with
+     * their quantity now: ingredients, then potions, then trophies, each in the order
+     * they were touched. Names stay valid until discardWhatIf().
+     */
+    static void whatIfChanges(std::pmr::vector<ItemCount>& changes);
+
+    /// Puts back every touched entity and removes the ones the what-if added.
+    static void discardWhatIf();
+
+    /**
+     * @brief Starts a transaction: the actions until commitTransaction() or
+     * rollbackTransaction() apply together or not at all.
+     *
+     * Changes are visible to queries at once and kept in an undo log like those of a
+     * what-if. Their history, change feed deltas and new names wait for the commit, which
+     * records them all at its own version, one delta per changed entity.
+     *
+     * @return false If a transaction is open already.
+     */
+    static bool beginTransaction();
+
+    /// Keeps the changes of the transaction; false if none is open. Costs O(entities touched).
+    static bool commitTransaction();
+
+    /// Puts back every entity the transaction touched; false if none is open. Costs O(entities touched).
+    static bool rollbackTransaction();
+
+    static bool inTransaction();
+
     /// Functions that execute the corresponding action
-    static void loot(const std::vector<Token>& tokenList);
-    static void trade(const std::vector<Token>& tokenList);
-    static void brew(const std::vector<Token>& tokenList);
-    static void learnSign(const std::vector<Token>& tokenList);
-    static void learnPotion(const std::vector<Token>& tokenList);
-    static void learnFormula(const std::vector<Token>& tokenList);
-    static void encounter(const std::vector<Token>& tokenList);
-    static void querySpecificIngredient(const std::vector<Token>& tokenList);
-    static void querySpecificPotion(const std::vector<Token>& tokenList);
-    static void querySpecificTrophy(const std::vector<Token>& tokenList);
-    static void queryAllIngredients(const std::vector<Token>& tokenList);
-    static void queryAllPotions(const std::vector<Token>& tokenList);
-    static void queryAllTrophies(const std::vector<Token>& tokenList);
-    static void queryEffectiveness(const std::vector<Token>& tokenList);
-    static void queryFormula(const std::vector<Token>& tokenList);
+    static void loot(Span<ItemCount> ingredientList);
+    static TradeResult trade(Span<ItemCount> trophyList, Span<ItemCount> ingredientList);
+    static BrewResult brew(std::string_view potionName, int count = 1);
+    static LearnResult learnSign(std::string_view signName, std::string_view monsterName);
+    static LearnResult learnPotion(std::string_view potionName, std::string_view monsterName);
+    static LearnResult learnFormula(std::string_view potionName, Span<ItemCount> ingredientList);
+    static EncounterResult encounter(std::string_view monsterName);
+
+    /// Functions that answer the corresponding query; unknown names have quantity 0
+    static int ingredientQuantity(std::string_view name);
+    static int potionQuantity(std::string_view name);
+    static int trophyQuantity(std::string_view name);
+
+    /// Multi-get: the quantity of every name, in the order of @p names. The names are probed
+    /// in sorted order, so that neighbouring names are found by stepping through the map.
+    static void ingredientQuantities(Span<std::string_view> names, std::pmr::vector<int>& quantities);
+    static void potionQuantities(Span<std::string_view> names, std::pmr::vector<int>& quantities);
+    static void trophyQuantities(Span<std::string_view> names, std::pmr::vector<int>& quantities);
+
+    /// Listing queries replace the contents of the given vector. It is a pmr vector so that the
+    /// caller chooses where it allocates, and can reuse its capacity from one call to the next.
+    /// Stock is every entity with a positive quantity, in alphabetical order.
+    static void ingredientStock(std::pmr::vector<ItemCount>& stock);
+    static void potionStock(std::pmr::vector<ItemCount>& stock);
+    static void trophyStock(std::pmr::vector<ItemCount>& stock);
+
+    /// Ranked listings: the @p count entities with the largest quantities, or with the smallest
+    /// positive ones if @p scarcest is set; ties in alphabetical order. They cost O(count log n).
+    static void rankedIngredients(size_t count, bool scarcest, std::pmr::vector<ItemCount>& ranked);
+    static void rankedPotions(size_t count, bool scarcest, std::pmr::vector<ItemCount>& ranked);
+    static void rankedTrophies(size_t count, bool scarcest, std::pmr::vector<ItemCount>& ranked);
+
+    /// Name searches: every name starting with @p prefix in alphabetical order, or with
+    /// @p similar set, the names at most NameIndex::MAX_EDITS edits away by distance then name.
+    static void ingredientNamesLike(std::string_view text, bool similar, std::pmr::vector<std::string_view>& names);
+    static void potionNamesLike(std::string_view text, bool similar, std::pmr::vector<std::string_view>& names);
+    static void trophyNamesLike(std::string_view text, bool similar, std::pmr::vector<std::string_view>& names);
+
+    /// Effective signs and potions in alphabetical order; empty for an unknown monster.
+    static void effectiveAgainst(std::string_view monsterName, std::pmr::vector<std::string_view>& effective);
+
+    /// Formula by descending quantity, then name; false if the formula is not known.
+    static bool formula(std::string_view potionName, std::pmr::vector<ItemCount>& ingredientList);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,125 @@
+/**
+ * @file history.cpp
+ * @brief Implementation of the versioned quantities of a collection.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "history.h"
+
+using namespace std;
+
+StockHistory::StockHistory(pmr::memory_resource* resource)
+    : changes(resource), checkpoints(resource), nodes(resource) {}
+
+StockHistory::Node* StockHistory::newNode(uint32_t owner, const Node* copyOf) {
+    Node* node = static_cast<Node*>(nodes.allocate(sizeof(Node), alignof(Node)));
+    if (copyOf != nullptr) {
+        memcpy(node, copyOf, sizeof(Node));
+    } else {
+        memset(node, 0, sizeof(Node));
+    }
+    node->owner = owner;
+    return node;
+}
+
+int StockHistory::lookup(const Node* root, uint32_t height, uint32_t id) {
+    if (root == nullptr || ((height + 1) * FANOUT_BITS < 32 && id >> ((height + 1) * FANOUT_BITS) != 0)) {
+        return 0;
+    }
+
+    const Node* node = root;
+    for (uint32_t level = height; level > 0 && node != nullptr; level--) {
+        node = node->children[(id >> (level * FANOUT_BITS)) & (FANOUT - 1)];
+    }
+    return node != nullptr ? node->quantities[id & (FANOUT - 1)] : 0;
+}
+
+void StockHistory::checkpoint(uint64_t version) {
+    size_t changeBegin = checkpoints.empty() ? 0 : checkpoints.back().changeEnd;
+    if (!checkpoints.empty() && changeBegin == changes.size()) {
+        return;
+    }
+
+    uint32_t owner = static_cast<uint32_t>(checkpoints.size());
+    const Node* previous = checkpoints.empty() ? nullptr : checkpoints.back().root;
+    uint32_t height = checkpoints.empty() ? 0 : checkpoints.back().height;
+
+    // The root is copied once; below it, nodes of this checkpoint are written in place
+    // and shared ones are copied on the way down, so each changed path is copied once
+    Node* root = newNode(owner, previous);
+
+    for (size_t k = changeBegin; k < changes.size(); k++) {
+        uint32_t id = changes[k].id;
+
+        while ((height + 1) * FANOUT_BITS < 32 && id >> ((height + 1) * FANOUT_BITS) != 0) {
+            Node* taller = newNode(owner, nullptr);
+            taller->children[0] = root;
+            root = taller;
+            height++;
+        }
+
+        Node* node = root;
+        for (uint32_t level = height; level > 0; level--) {
+            Node*& child = node->children[(id >> (level * FANOUT_BITS)) & (FANOUT - 1)];
+            if (child == nullptr || child->owner != owner) {
+                child = newNode(owner, child);
+            }
+            node = child;
+        }
+        node->quantities[id & (FANOUT - 1)] = changes[k].quantity;
+    }
+
+    checkpoints.push_back(Checkpoint{version, root, height, changes.size()});
+}
+
+StockHistory::View StockHistory::at(uint64_t version, pmr::memory_resource* scratch) const {
+    static const Checkpoint empty{0, nullptr, 0, 0};
+
+    // The last checkpoint at or before the version, or the first one for an older version
+    auto after = upper_bound(checkpoints.begin(), checkpoints.end(), version,
+                             [](uint64_t v, const Checkpoint& checkpoint) { return v < checkpoint.version; });
+    const Checkpoint& base = checkpoints.empty() ? empty : after == checkpoints.begin() ? *after : *prev(after);
+
+    View view(base, scratch);
+    if (base.version >= version) {
+        return view;
+    }
+
+    // Changes up to the version, after the checkpoint; the stable sort keeps the last change of an entity last
+    auto end = upper_bound(changes.begin() + base.changeEnd, changes.end(), version,
+                           [](uint64_t v, const Change& change) { return v < change.version; });
+    for (auto it = changes.begin() + base.changeEnd; it != end; ++it) {
+        view.overrides.emplace_back(it->id, it->quantity);
+    }
+    stable_sort(view.overrides.begin(), view.overrides.end(),
+                [](const pair<uint32_t, int>& a, const pair<uint32_t, int>& b) { return a.first < b.first; });
+
+    size_t kept = 0;
+    for (size_t k = 0; k < view.overrides.size(); k++) {
+        if (kept > 0 && view.overrides[kept - 1].first == view.overrides[k].first) {
+            view.overrides[kept - 1] = view.overrides[k];
+        } else {
+            view.overrides[kept++] = view.overrides[k];
+        }
+    }
+    view.overrides.resize(kept);
+
+    return view;
+}
+
+int StockHistory::View::quantity(uint32_t id) const {
+    auto replayed = lower_bound(overrides.begin(), overrides.end(), id,
+                                [](const pair<uint32_t, int>& entry, uint32_t key) { return entry.first < key; });
+    if (replayed != overrides.end() && replayed->first == id) {
+        return replayed->second;
+    }
+    return lookup(root, height, id);
+}
+
+void StockHistory::clear() {
+    changes.clear();
+    checkpoints.clear();
+    nodes.release();
+}
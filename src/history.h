@@ -0,0 +1,148 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/**
+ * @file history.h
+ * @brief Declares the versioned record of a collection's quantities behind the "at <line>" queries.
+ *
+ * Every command line is a version of the state. A StockHistory keeps the quantity of
+ * every entity of one collection at every version without copying the collection:
+ *
+ * - Each quantity change is appended to a log as (version, entity, new quantity).
+ * - Every K versions the changes since the previous checkpoint are folded into a
+ *   persistent radix tree indexed by entity ID. Only the paths from the root to the
+ *   changed leaves are copied; every other node is shared with the previous checkpoint.
+ *
+ * Entities are identified by the dense IDs Geralt gives them as they are added, so
+ * recording a change is a single append.
+ *
+ * The quantities after version N are those of the last checkpoint at or before N,
+ * overridden by the logged changes between that checkpoint and N, so at most one
+ * interval of changes is replayed. Both the log and the copied paths grow with the
+ * number of changes, not with the size of the collection.
+ *
+ * Geralt owns one history per counted collection; see Geralt::enableHistory().
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+/**
+ * @class StockHistory
+ * @brief Quantities of one collection at every version since the history started.
+ */
+class StockHistory {
+private:
+    static constexpr int FANOUT_BITS = 4;
+    static constexpr uint32_t FANOUT = 1u << FANOUT_BITS;
+
+    /**
+     * @struct Node
+     * @brief A node of the radix tree: child nodes above the last level, quantities on it.
+     *
+     * A node is only written while the checkpoint that created it is being folded;
+     * after that it is shared and never changes.
+     */
+    struct Node {
+        uint32_t owner;     ///< Index of the checkpoint that created the node
+        union {
+            Node* children[FANOUT];
+            int quantities[FANOUT];
+        };
+    };
+
+    /// A quantity change: the entity with ID @p id has quantity @p quantity after @p version.
+    struct Change {
+        uint64_t version;
+        uint32_t id;
+        int quantity;
+    };
+
+    /// The tree after version @p version, which covers the changes before changes[changeEnd].
+    struct Checkpoint {
+        uint64_t version;
+        const Node* root;
+        uint32_t height;    ///< Levels above the last one
+        size_t changeEnd;
+    };
+
+    std::pmr::vector<Change> changes;
+    std::pmr::vector<Checkpoint> checkpoints;
+
+    /// Nodes are never freed one by one: they all go at once on clear().
+    std::pmr::monotonic_buffer_resource nodes;
+
+    Node* newNode(uint32_t owner, const Node* copyOf);
+    static int lookup(const Node* root, uint32_t height, uint32_t id);
+
+public:
+    /**
+     * @class View
+     * @brief The quantities of the collection after one past version.
+     */
+    class View {
+    public:
+        /// Quantity of the entity with the given ID after the version; 0 for an entity that did not exist yet.
+        int quantity(uint32_t id) const;
+
+    private:
+        friend class StockHistory;
+
+        View(const Checkpoint& checkpoint, std::pmr::memory_resource* scratch)
+            : root(checkpoint.root), height(checkpoint.height), overrides(scratch) {}
+
+        const Node* root;
+        uint32_t height;
+
+        /// Changes replayed on top of the checkpoint, the last one of each entity, by ID.
+        std::pmr::vector<std::pair<uint32_t, int>> overrides;
+    };
+
+    explicit StockHistory(std::pmr::memory_resource* resource);
+
+    /// true between the first checkpoint and clear().
+    bool isStarted() const { return !checkpoints.empty(); }
+
+    /**
+     * @brief Records the new quantity of an entity, set by the command of the given version.
+     *
+     * Versions must not decrease from one call to the next. Before the first checkpoint,
+     * recorded quantities form the state the history starts from.
+     *
+     * @param version Version of the command that changed the quantity.
+     * @param id Entity ID.
+     * @param quantity Quantity after the change.
+     */
+    void record(uint64_t version, uint32_t id, int quantity) {
+        changes.push_back(Change{version, id, quantity});
+    }
+
+    /**
+     * @brief Folds the changes recorded since the previous checkpoint into a new tree.
+     *
+     * @param version The version that the new checkpoint is the state after.
+     */
+    void checkpoint(uint64_t version);
+
+    /**
+     * @brief Reconstructs the quantities after a version.
+     *
+     * Versions before the first checkpoint give the state of the first checkpoint.
+     *
+     * @param version Version to look at; must be older than any version recorded after it.
+     * @param scratch Resource of the replayed changes, which the view keeps.
+     * @return View The quantities after @p version.
+     */
+    View at(uint64_t version, std::pmr::memory_resource* scratch) const;
+
+    /// Drops every version; the history starts again with the next checkpoint.
+    void clear();
+
+    /// Number of changes recorded since the history started.
+    size_t changeCount() const { return changes.size(); }
+};
+
+#endif
@@ -1,8 +1,8 @@
 #include "ingredient.h"
 #include <string>
 
-Ingredient::Ingredient(const string& name, int quantity) 
-    : name(name), quantity(quantity) {}
+Ingredient::Ingredient(const Name& name, int quantity) 
+    : name(name), quantity(quantity), id(0), generation(0) {}
 
 int Ingredient::getQuantity() {
     return this->quantity;
@@ -10,8 +10,26 @@ int Ingredient::getQuantity() {
 
 void Ingredient::increaseQuantity(int amount) {
     this->quantity += amount;
+    this->generation++;
 }
 
 void Ingredient::decreaseQuantity(int amount) {
     this->quantity -= amount;
-}
\ No newline at end of file
+    this->generation++;
+}
+
+const Name& Ingredient::getName() const {
+    return this->name;
+}
+
+const uint64_t& Ingredient::getGeneration() const {
+    return this->generation;
+}
+
+uint32_t Ingredient::getId() const {
+    return this->id;
+}
+
+void Ingredient::setId(uint32_t id) {
+    this->id = id;
+}
@@ -7,6 +7,9 @@
  */
 
 #include <string>
+#include <cstdint>
+
+#include "name.h"
 
 using namespace std;
 
@@ -19,8 +22,10 @@ using namespace std;
 class Ingredient {
 private:
     /// Data fields are declared private in order to encapsulate the data.
-    string name;
+    Name name;
     int quantity;
+    uint32_t id;            ///< Dense index of the entity in its collection, in the order of addition
+    uint64_t generation;
 
 public:
     /**
@@ -28,7 +33,7 @@ public:
      * @param name      Ingredient identifier (e.g., "Rebis").
      * @param quantity  Initial amount to store (must be non‑negative).
      */
-    Ingredient(const string& name, int quantity);
+    Ingredient(const Name& name, int quantity);
 
     /**
      * @brief Retrieve current quantity of the ingredient owned by Geralt.
@@ -47,6 +52,22 @@ public:
      * @param amount Amount to subtract.
      */
     void decreaseQuantity(int amount);
+
+    /**
+     * @brief Get the name, stored in the ingredient itself.
+     */
+    const Name& getName() const;
+
+    /**
+     * @brief Version counter bumped on every change, used to validate cached query answers.
+     */
+    const uint64_t& getGeneration() const;
+
+    /**
+     * @brief ID of the entity in its collection, used by the history, the change feed and the undo log; set by Geralt.
+     */
+    uint32_t getId() const;
+    void setId(uint32_t id);
 };
 
 #endif
\ No newline at end of file
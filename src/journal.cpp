@@ -0,0 +1,429 @@
+/**
+ * @file journal.cpp
+ * @brief Implementation of the command journal, background checkpoints and compaction.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include <cerrno>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "journal.h"
+#include "snapshot.h"
+#include "geralt.h"
+#include "output.h"
+#include "trace.h"
+#include "changefeed.h"
+
+using namespace std;
+
+bool execute_line(const string&);
+
+string Journal::directory;
+FILE* Journal::segment = nullptr;
+uint64_t Journal::segmentNumber = 0;
+uint64_t Journal::checkpointInterval = Journal::DEFAULT_CHECKPOINT_INTERVAL;
+uint64_t Journal::commandsSinceCheckpoint = 0;
+pid_t Journal::checkpointPid = 0;
+uint64_t Journal::pendingCheckpoint = 0;
+uint64_t Journal::verifiedCheckpoint = 0;
+bool Journal::holding = false;
+string Journal::heldLines;
+uint64_t Journal::heldCommands = 0;
+
+namespace {
+
+/// Kind of file found in the journal directory.
+enum JournalFileKind { JOURNAL_SEGMENT, JOURNAL_CHECKPOINT };
+
+/**
+ * @brief A numbered file in the journal directory.
+ */
+struct JournalFile {
+    JournalFileKind kind;
+    uint64_t number;
+    string name;
+};
+
+/// Parses "<prefix><number><suffix>" file names; returns false for unrelated files.
+bool parseNumberedName(const string& name, const string& prefix, const string& suffix, uint64_t& number) {
+    if (name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return false;
+    }
+
+    string digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+    if (!all_of(digits.begin(), digits.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); })) {
+        return false;
+    }
+
+    number = stoull(digits);
+    return true;
+}
+
+/// Lists the segments and checkpoints of a journal directory, sorted by number.
+vector<JournalFile> listJournalFiles(const string& directory) {
+    vector<JournalFile> files;
+
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return files;
+    }
+
+    while (dirent* entry = readdir(dir)) {
+        string name = entry->d_name;
+        uint64_t number;
+
+        if (parseNumberedName(name, "journal-", ".log", number)) {
+            files.push_back({JOURNAL_SEGMENT, number, name});
+        } else if (parseNumberedName(name, "checkpoint-", ".snap", number)) {
+            files.push_back({JOURNAL_CHECKPOINT, number, name});
+        }
+    }
+
+    closedir(dir);
+
+    sort(files.begin(), files.end(), [](const JournalFile& a, const JournalFile& b) { return a.number < b.number; });
+    return files;
+}
+
+/**
+ * @brief Escapes the control characters that main() decodes from "\n" and "\t",
+ *        so that every journaled command stays on a single line.
+ */
+string escapeLine(const string& line) {
+    string escaped;
+    escaped.reserve(line.size());
+
+    for (char c : line) {
+        if (c == '\n') {
+            escaped.append("\\n");
+        } else if (c == '\t') {
+            escaped.append("\\t");
+        } else {
+            escaped.push_back(c);
+        }
+    }
+
+    return escaped;
+}
+
+/// Reverses escapeLine.
+string unescapeLine(const string& line) {
+    string unescaped;
+    unescaped.reserve(line.size());
+
+    for (size_t i = 0; i < line.size(); i++) {
+        if (line[i] == '\\' && i + 1 < line.size() && (line[i + 1] == 'n' || line[i + 1] == 't')) {
+            unescaped.push_back(line[i + 1] == 'n' ? '\n' : '\t');
+            i++;
+        } else {
+            unescaped.push_back(line[i]);
+        }
+    }
+
+    return unescaped;
+}
+
+} // namespace
+
+string Journal::segmentPath(uint64_t number) {
+    char name[32];
+    snprintf(name, sizeof(name), "journal-%08llu.log", static_cast<unsigned long long>(number));
+    return directory + "/" + name;
+}
+
+string Journal::checkpointPath(uint64_t number) {
+    char name[32];
+    snprintf(name, sizeof(name), "checkpoint-%08llu.snap", static_cast<unsigned long long>(number));
+    return directory + "/" + name;
+}
+
+bool Journal::openSegment(uint64_t number) {
+    if (segment != nullptr) {
+        fclose(segment);
+    }
+
+    segment = fopen(segmentPath(number).c_str(), "a");
+    segmentNumber = number;
+    return segment != nullptr;
+}
+
+bool Journal::isOpen() {
+    return !directory.empty();
+}
+
+bool Journal::open(const string& path, uint64_t interval, string& error) {
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        error = "cannot create journal directory " + path;
+        return false;
+    }
+
+    directory = path;
+    checkpointInterval = max<uint64_t>(interval, 1);
+
+    vector<JournalFile> files = listJournalFiles(directory);
+
+    // Restore the newest checkpoint that validates; a crash may have left a broken one behind
+    uint64_t firstSegment = 0;
+    for (auto it = files.rbegin(); it != files.rend(); ++it) {
+        if (it->kind != JOURNAL_CHECKPOINT) {
+            continue;
+        }
+
+        string snapshotError;
+        if (loadSnapshot(directory + "/" + it->name, snapshotError)) {
+            firstSegment = it->number;
+            break;
+        }
+
+        cerr << "Skipping checkpoint " << it->name << ": " << snapshotError << endl;
+    }
+
+    // The segments after the restored checkpoint must all be there, or commands would be lost silently
+    uint64_t expectedSegment = max<uint64_t>(firstSegment, 1);
+    for (const JournalFile& file : files) {
+        if (file.kind != JOURNAL_SEGMENT || file.number < firstSegment) {
+            continue;
+        }
+        if (file.number != expectedSegment) {
+            error = "journal segment " + segmentPath(expectedSegment) + " is missing, and no checkpoint covers it";
+            directory.clear();
+            return false;
+        }
+        expectedSegment++;
+    }
+    verifiedCheckpoint = firstSegment;
+
+    // Replay the bounded tail of commands without printing their answers again
+    uint64_t lastSegment = firstSegment;
+    uint64_t replayedCommands = 0;
+    NullSink discard;
+    OutputSink* console = Output::redirect(&discard);
+
+    for (const JournalFile& file : files) {
+        if (file.kind != JOURNAL_SEGMENT || file.number < firstSegment) {
+            continue;
+        }
+
+        string segmentFile = directory + "/" + file.name;
+        ifstream input(segmentFile, ios::binary);
+        string contents((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+        input.close();
+
+        // A crash in the middle of a write leaves a last line without its newline; it never ran
+        size_t lastNewline = contents.rfind('\n');
+        size_t complete = lastNewline == string::npos ? 0 : lastNewline + 1;
+        if (complete < contents.size()) {
+            cerr << "Dropping torn line at the end of " << file.name << ": " << contents.substr(complete) << endl;
+            contents.resize(complete);
+            if (truncate(segmentFile.c_str(), static_cast<off_t>(complete)) != 0) {
+                cerr << "Could not truncate " << file.name << endl;
+            }
+        }
+
+        for (size_t start = 0; start < contents.size();) {
+            size_t end = contents.find('\n', start);
+            execute_line(unescapeLine(contents.substr(start, end - start)));
+            replayedCommands++;
+            start = end + 1;
+        }
+
+        // A transaction block is written at once, so an unfinished one was cut short by a crash
+        Geralt::rollbackTransaction();
+
+        lastSegment = max(lastSegment, file.number);
+    }
+
+    Output::redirect(console);
+
+    // New commands always go to a fresh segment, after whatever a crash left behind
+    if (!openSegment(lastSegment + 1)) {
+        error = "cannot open journal segment in " + path;
+        directory.clear();
+        return false;
+    }
+
+    // Start from a compact directory: checkpoint everything that was just replayed
+    commandsSinceCheckpoint = 0;
+    if (replayedCommands > 0) {
+        startCheckpoint();
+    }
+
+    return true;
+}
+
+void Journal::append(const string& line) {
+    if (segment == nullptr) {
+        return;
+    }
+
+    string escaped = escapeLine(line);
+    escaped.push_back('\n');
+
+    if (holding) {
+        heldLines += escaped;
+        heldCommands++;
+        return;
+    }
+
+    fwrite(escaped.data(), 1, escaped.size(), segment);
+    fflush(segment);
+
+    finishCheckpoint(false);
+
+    if (++commandsSinceCheckpoint >= checkpointInterval && checkpointPid == 0) {
+        startCheckpoint();
+    }
+}
+
+void Journal::beginTransaction() {
+    // Commands replayed during recovery are on disk already
+    if (segment == nullptr) {
+        return;
+    }
+
+    holding = true;
+    heldLines.clear();
+    heldCommands = 0;
+}
+
+void Journal::commitTransaction() {
+    holding = false;
+    if (segment == nullptr || heldCommands == 0) {
+        return;
+    }
+
+    // One write, and no checkpoint in the middle, which would cover only part of the block
+    string block = "Begin\n" + heldLines + "Commit\n";
+    fwrite(block.data(), 1, block.size(), segment);
+    fflush(segment);
+    heldLines.clear();
+
+    finishCheckpoint(false);
+
+    commandsSinceCheckpoint += heldCommands;
+    if (commandsSinceCheckpoint >= checkpointInterval && checkpointPid == 0) {
+        startCheckpoint();
+    }
+}
+
+void Journal::rollbackTransaction() {
+    holding = false;
+    heldLines.clear();
+}
+
+/**
+ * @brief Rotates the journal and forks a child that writes a checkpoint of the current state.
+ *
+ * The child owns a copy-on-write image of the parent's memory at the moment of the fork,
+ * which is exactly the state after every command in the segments below the new one.
+ * The child holds only the forking thread, so a lock that the trace writer or the change
+ * feed dispatcher held at that moment would never be released in it; while either thread
+ * runs, the checkpoint is written in place instead.
+ */
+void Journal::startCheckpoint() {
+    uint64_t covered = segmentNumber;
+
+    if (!openSegment(segmentNumber + 1)) {
+        return;
+    }
+
+    commandsSinceCheckpoint = 0;
+    fflush(nullptr);
+
+    bool threaded = Trace::isOpen() || ChangeFeed::isOpen();
+    pid_t pid = threaded ? -1 : fork();
+
+    if (pid == 0) {
+        bool written = writeSnapshot(checkpointPath(covered + 1));
+        _exit(written ? 0 : 1);
+    }
+
+    if (pid > 0) {
+        checkpointPid = pid;
+        pendingCheckpoint = covered + 1;
+    } else {
+        // Without fork the checkpoint is written in place, which still bounds recovery time
+        if (writeSnapshot(checkpointPath(covered + 1))) {
+            compact(covered + 1);
+        }
+    }
+}
+
+/**
+ * @brief Reaps a finished checkpoint child and compacts the journal behind it.
+ *
+ * @param wait Block until the child has finished instead of polling.
+ */
+void Journal::finishCheckpoint(bool wait) {
+    if (checkpointPid == 0) {
+        return;
+    }
+
+    int status = 0;
+    pid_t result = waitpid(checkpointPid, &status, wait ? 0 : WNOHANG);
+
+    if (result == 0) {
+        return; // Still writing
+    }
+
+    checkpointPid = 0;
+
+    if (result > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        compact(pendingCheckpoint);
+    }
+}
+
+/**
+ * @brief Deletes the segments and checkpoints made redundant by a new checkpoint, once it reads back valid.
+ *
+ * The previous checkpoint and the segments after it are kept, so that recovery still has
+ * a complete fallback if the new checkpoint is damaged on disk later; only what lies
+ * below the previous checkpoint is deleted.
+ *
+ * @param coveredSegment Number of the new checkpoint.
+ */
+void Journal::compact(uint64_t coveredSegment) {
+    SnapshotView checkpoint;
+    string error;
+    if (!checkpoint.open(checkpointPath(coveredSegment), error)) {
+        cerr << "Keeping the journal behind checkpoint " << coveredSegment << ": " << error << endl;
+        return;
+    }
+    checkpoint.close();
+
+    for (const JournalFile& file : listJournalFiles(directory)) {
+        if (file.number < verifiedCheckpoint) {
+            remove((directory + "/" + file.name).c_str());
+        }
+    }
+    verifiedCheckpoint = coveredSegment;
+}
+
+void Journal::close() {
+    if (!isOpen()) {
+        return;
+    }
+
+    finishCheckpoint(true);
+
+    // Commands of a transaction that never committed are not kept
+    rollbackTransaction();
+
+    if (segment != nullptr) {
+        fclose(segment);
+        segment = nullptr;
+    }
+
+    directory.clear();
+}
@@ -0,0 +1,108 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+/**
+ * @file journal.h
+ * @brief Declares the command journal with periodic checkpoints and compaction.
+ *
+ * Every state-changing command line is appended to the current journal segment.
+ * Every few thousand commands a checkpoint of the whole Geralt state is written by a
+ * forked child process, which gets a copy-on-write image of the state for free, so
+ * the main loop never pauses while the snapshot is serialized. While the trace writer or
+ * the change feed dispatcher runs, the checkpoint is written in place instead, since a
+ * forked child would hold none of their threads. Once a checkpoint has been read back and
+ * validated, everything below the previous checkpoint is deleted: one older checkpoint
+ * and the segments after it stay as a fallback.
+ *
+ * Directory layout:
+ * @code
+ * checkpoint-00000007.snap   state after every segment numbered below 7
+ * journal-00000007.log       commands applied after that checkpoint
+ * journal-00000008.log       ...
+ * @endcode
+ *
+ * Recovery loads the newest valid checkpoint and replays only the segments after it,
+ * so it costs the size of the state plus a bounded tail of commands. It fails when one
+ * of those segments is missing, rather than recover a state with commands left out.
+ * Only lines that end with a newline are replayed: a torn last line is cut off the
+ * segment with a warning.
+ *
+ * The commands of a transaction are held back until it commits, then written between
+ * "Begin" and "Commit" lines with a single write. A block cut short by a crash is rolled
+ * back when its segment has been replayed, so a transaction is recovered whole or not at all.
+ */
+
+#include <string>
+#include <cstdint>
+#include <cstdio>
+
+#include <sys/types.h>
+
+/**
+ * @class Journal
+ * @brief Static journal of state-changing commands, used like the static Geralt state.
+ */
+class Journal {
+private:
+    static std::string directory;       ///< Journal directory; empty when journaling is off
+    static FILE* segment;               ///< Segment that receives new commands
+    static uint64_t segmentNumber;      ///< Number of the open segment
+    static uint64_t checkpointInterval; ///< Commands between two checkpoints
+    static uint64_t commandsSinceCheckpoint;
+    static pid_t checkpointPid;         ///< Child writing a checkpoint, or 0 when none is running
+    static uint64_t pendingCheckpoint;  ///< Segment number the running checkpoint covers up to
+    static uint64_t verifiedCheckpoint; ///< Newest checkpoint known to be valid, or 0 when none is
+    static bool holding;                ///< A transaction is open, so appended commands wait for its commit
+    static std::string heldLines;       ///< Escaped commands of the open transaction
+    static uint64_t heldCommands;
+
+    static std::string segmentPath(uint64_t number);
+    static std::string checkpointPath(uint64_t number);
+    static bool openSegment(uint64_t number);
+    static void startCheckpoint();
+    static void finishCheckpoint(bool wait);
+    static void compact(uint64_t coveredSegment);
+
+public:
+    /// Default number of journaled commands between two checkpoints.
+    static constexpr uint64_t DEFAULT_CHECKPOINT_INTERVAL = 10000;
+
+    /**
+     * @brief Recovers the state stored in a journal directory and starts journaling into it.
+     *
+     * The newest valid checkpoint is restored and the segments after it are replayed
+     * with their output discarded. The directory is created when it does not exist.
+     *
+     * @param path Journal directory.
+     * @param interval Number of journaled commands between two checkpoints.
+     * @param error Receives a human readable reason on failure.
+     * @return true If the journal has been recovered and is ready for new commands.
+     */
+    static bool open(const std::string& path, uint64_t interval, std::string& error);
+
+    /// Returns true when journaling has been enabled with open().
+    static bool isOpen();
+
+    /**
+     * @brief Appends an executed, state-changing command line to the journal.
+     *
+     * May start a background checkpoint when the checkpoint interval is reached.
+     *
+     * @param line The command line exactly as it was executed.
+     */
+    static void append(const std::string& line);
+
+    /// Holds the commands appended from now on back, until commitTransaction() or rollbackTransaction().
+    static void beginTransaction();
+
+    /// Writes the held commands as one "Begin" ... "Commit" block.
+    static void commitTransaction();
+
+    /// Drops the held commands.
+    static void rollbackTransaction();
+
+    /// Waits for a running checkpoint, compacts, and closes the open segment.
+    static void close();
+};
+
+#endif
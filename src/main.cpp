@@ -1,22 +1,310 @@
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+#include "journal.h"
+#include "compiler.h"
+#include "parsecache.h"
+#include "stats.h"
+#include "trace.h"
+#include "allocations.h"
+#include "memreport.h"
+#include "output.h"
+#include "geralt.h"
+#include "changefeed.h"
 
 bool execute_line(const std::string&);
 void replaceEscapeSequences(std::string&);
 
-int main() {
+/// Path given with --snapshot-out; empty when no snapshot should be written at exit.
+static std::string snapshotOutPath;
+
+/// Set by --cache-stats to print the parse cache counters at exit.
+static bool printCacheStats = false;
+
+/// Set by --stats to print the latency histograms at exit.
+static bool printLatencyStats = false;
+
+/// Set by --alloc-budget to check the per-command allocation budgets at exit.
+static bool checkAllocationBudgets = false;
+
+/// Set by --mem-report to print the memory breakdown of the collections at exit.
+static bool printMemoryReport = false;
+
+/**
+ * @brief Closes the journal and writes the requested snapshot when the program terminates.
+ *
+ * Registered with atexit so it also runs when the parser terminates the program
+ * through the exit command.
+ */
+static void shutdownAtExit() {
+    // A transaction still open at exit is abandoned, so the snapshot holds committed state only
+    Geralt::rollbackTransaction();
+
+    Output::flush();
+    Journal::close();
+    Trace::close();
+    ChangeFeed::close();
+
+    if (printCacheStats) {
+        const ParseCache::Statistics& stats = ParseCache::statistics();
+        std::cerr << "parse cache: " << stats.lookups << " lookups, " << stats.hits << " hits ("
+                  << stats.hitRate() * 100.0 << "%), " << stats.insertions << " insertions, "
+                  << stats.evictions << " evictions" << std::endl;
+    }
+
+    if (printLatencyStats) {
+        Stats::report(std::cerr);
+    }
+
+    if (printMemoryReport) {
+        MemoryReport::report(std::cerr);
+    }
+
+    // Last, since a violated budget ends the process with a failure status
+    if (checkAllocationBudgets && !Allocations::checkBudgets()) {
+        std::_Exit(1);
+    }
+
+    if (!snapshotOutPath.empty() && !writeSnapshot(snapshotOutPath)) {
+        std::cerr << "Could not write snapshot " << snapshotOutPath << std::endl;
+    }
+}
+
+/**
+ * @brief Returns true when the next input line can be read without waiting.
+ *
+ * The driver only flushes the answers before it would block on input, so a piped or
+ * redirected command stream is answered in large writes while an interactive user
+ * still sees every answer before typing the next command.
+ */
+static bool inputPending() {
+    if (std::cin.rdbuf()->in_avail() > 0) {
+        return true;
+    }
+
+    pollfd input = {STDIN_FILENO, POLLIN, 0};
+    return poll(&input, 1, 0) > 0;
+}
+
+/**
+ * @brief Compiles a text command log into the binary command format.
+ *
+ * @param inputPath Text log with one command per line.
+ * @param outputPath Destination of the compiled records.
+ * @return int Process exit status.
+ */
+static int compileLog(const char* inputPath, const char* outputPath) {
+    std::ifstream input(inputPath);
+    std::ofstream output(outputPath, std::ios::binary);
+
+    if (!input || !output) {
+        std::cerr << "Could not open " << (!input ? inputPath : outputPath) << std::endl;
+        return 1;
+    }
+
+    CommandCompiler compiler(output);
+    std::string line;
+
+    while (std::getline(input, line)) {
+        // The interactive loop stops at "Exit" without parsing it, so the compiled log ends there too
+        if (line == "Exit") {
+            compiler.compileLine(line);
+            break;
+        }
+
+        replaceEscapeSequences(line);
+        compiler.compileLine(line);
+    }
+
+    return output ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
     std::string line;
     size_t index = 0;
 
+    // Subcommands:
+    //   compile <in.txt> <out.bin>  translate a text command log into binary records
+    //   replay <file.bin> [--history-every <n>]
+    //                               execute a compiled log, printing only the answers
+    if (argc == 4 && std::strcmp(argv[1], "compile") == 0) {
+        return compileLog(argv[2], argv[3]);
+    }
+
+    if ((argc == 3 || argc == 5) && std::strcmp(argv[1], "replay") == 0) {
+        uint64_t replayHistoryInterval = Geralt::DEFAULT_HISTORY_INTERVAL;
+        if (argc == 5) {
+            if (std::strcmp(argv[3], "--history-every") != 0) {
+                std::cerr << "Could not replay: unknown option " << argv[3] << std::endl;
+                return 1;
+            }
+            replayHistoryInterval = std::strtoull(argv[4], nullptr, 10);
+        }
+
+        std::string error;
+        bool replayed = replayCompiledLog(argv[2], replayHistoryInterval, error);
+        Output::flush();
+        if (!replayed) {
+            std::cerr << "Could not replay: " << error << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    std::string journalPath;
+    uint64_t checkpointInterval = Journal::DEFAULT_CHECKPOINT_INTERVAL;
+    uint64_t historyInterval = Geralt::DEFAULT_HISTORY_INTERVAL;
+    std::string changeFeedPath;
+
+    // Command-line options:
+    //   --snapshot-in <file>       restore the state from a snapshot before reading commands
+    //   --snapshot-out <file>      write the final state to a snapshot when the program exits
+    //   --journal <dir>            recover from and journal every state-changing command into a directory
+    //   --checkpoint-every <n>     journaled commands between two background checkpoints
+    //   --history-every <n>        lines between two checkpoints of the "at <line>" history (0 turns it off)
+    //   --change-feed <socket>     publish every quantity change to the clients of a Unix domain socket
+    //   --parse-cache <n>          number of parsed lines to cache (0 disables the cache)
+    //   --cache-stats              print the parse cache hit rate at exit
+    //   --stats                    record per-stage latency histograms and print them at exit
+    //   --trace <file>             write one Chrome trace-event span per command and stage
+    //   --alloc-budget <file>      fail at exit if a command kind made more allocations than its budget
+    //   --mem-report               print the memory breakdown of the collections at exit
+    for (int arg = 1; arg < argc; arg++) {
+        if (std::strcmp(argv[arg], "--snapshot-in") == 0 && arg + 1 < argc) {
+            std::string error;
+            if (!loadSnapshot(argv[++arg], error)) {
+                std::cerr << "Could not load snapshot: " << error << std::endl;
+                return 1;
+            }
+        } else if (std::strcmp(argv[arg], "--snapshot-out") == 0 && arg + 1 < argc) {
+            snapshotOutPath = argv[++arg];
+        } else if (std::strcmp(argv[arg], "--journal") == 0 && arg + 1 < argc) {
+            journalPath = argv[++arg];
+        } else if (std::strcmp(argv[arg], "--checkpoint-every") == 0 && arg + 1 < argc) {
+            checkpointInterval = std::strtoull(argv[++arg], nullptr, 10);
+        } else if (std::strcmp(argv[arg], "--history-every") == 0 && arg + 1 < argc) {
+            historyInterval = std::strtoull(argv[++arg], nullptr, 10);
+        } else if (std::strcmp(argv[arg], "--change-feed") == 0 && arg + 1 < argc) {
+            changeFeedPath = argv[++arg];
+        } else if (std::strcmp(argv[arg], "--parse-cache") == 0 && arg + 1 < argc) {
+            ParseCache::setCapacity(std::strtoull(argv[++arg], nullptr, 10));
+        } else if (std::strcmp(argv[arg], "--cache-stats") == 0) {
+            printCacheStats = true;
+        } else if (std::strcmp(argv[arg], "--stats") == 0) {
+            if (!STATS_COMPILED) {
+                std::cerr << "Stats were compiled out (WITCHERTRACKER_STATS=0)" << std::endl;
+                return 1;
+            }
+            Stats::enable();
+            Allocations::enable();
+            printLatencyStats = true;
+        } else if (std::strcmp(argv[arg], "--trace") == 0 && arg + 1 < argc) {
+            std::string error;
+            if (!STATS_COMPILED) {
+                std::cerr << "Tracing was compiled out (WITCHERTRACKER_STATS=0)" << std::endl;
+                return 1;
+            }
+            if (!Trace::open(argv[++arg], error)) {
+                std::cerr << "Could not open trace: " << error << std::endl;
+                return 1;
+            }
+            Stats::enableSpans();
+        } else if (std::strcmp(argv[arg], "--alloc-budget") == 0 && arg + 1 < argc) {
+            std::string error;
+            if (!STATS_COMPILED) {
+                std::cerr << "Allocation tracking was compiled out (WITCHERTRACKER_STATS=0)" << std::endl;
+                return 1;
+            } else if (!ALLOC_HOOK_COMPILED) {
+                std::cerr << "Allocation tracking was compiled out (WITCHERTRACKER_ALLOC_HOOK=0)" << std::endl;
+                return 1;
+            }
+            if (!Allocations::loadBudgets(argv[++arg], error)) {
+                std::cerr << "Could not load allocation budgets: " << error << std::endl;
+                return 1;
+            }
+            Allocations::enable();
+            Stats::enableSpans();
+            checkAllocationBudgets = true;
+        } else if (std::strcmp(argv[arg], "--mem-report") == 0) {
+            printMemoryReport = true;
+        } else {
+            std::cerr << "Unknown option: " << argv[arg] << std::endl;
+            return 1;
+        }
+    }
+
+    // Answers to a client connected through a socket must not raise SIGPIPE when it goes away
+    struct stat outputStatus;
+    if (fstat(STDOUT_FILENO, &outputStatus) == 0 && S_ISSOCK(outputStatus.st_mode)) {
+        Output::redirect(new SocketSink(STDOUT_FILENO));
+    }
+
+    // The journal is opened after a snapshot is restored, so it replays on top of the snapshot state
+    if (!journalPath.empty()) {
+        std::string error;
+        if (!Journal::open(journalPath, checkpointInterval, error)) {
+            std::cerr << "Could not open journal: " << error << std::endl;
+            return 1;
+        }
+    }
+
+    // Line numbers of the history count from the state after recovery
+    if (historyInterval != 0) {
+        Geralt::enableHistory(historyInterval);
+    }
+
+    // Recovered commands were published before, by the run that journaled them
+    if (!changeFeedPath.empty()) {
+        std::string error;
+        if (!ChangeFeed::listen(changeFeedPath, error)) {
+            std::cerr << "Could not open change feed: " << error << std::endl;
+            return 1;
+        }
+        ChangeFeed::open();
+    }
+
+    std::atexit(shutdownAtExit);
+
+    // Nothing else reads standard input through stdio, so std::cin may buffer on its own
+    std::ios::sync_with_stdio(false);
+
+    uint64_t lineNumber = 0;
+
     while (true) {
-        std::cout << ">> ";
+        // The prompt and the wait for input belong to no command
+        if (Trace::isOpen()) {
+            Trace::setLine(0);
+        }
+
+        Output::sink().write(">> ");
+        if (!inputPending()) {
+            Output::flush();
+        }
         std::getline(std::cin, line);
+        lineNumber++;
+        Geralt::beginVersion();
 
         if (std::cin.eof() || line == "Exit")
             break;
+
+        if (Trace::isOpen()) {
+            Trace::setLine(lineNumber);
+        }
+        Stats::Span commandSpan(Stats::STAGE_COMMAND);
         
-        replaceEscapeSequences(line);
+        {
+            Stats::Span span(Stats::STAGE_ESCAPES);
+            replaceEscapeSequences(line);
+        }
         
         // std::cerr << "Received: " << line << std::endl;
 
@@ -27,7 +315,8 @@ int main() {
         
         bool result = execute_line(line);
         if (result == false) {
-            std::cout << "INVALID\n";
+            Output::sink().write("INVALID");
+            Output::sink().endAnswer();
         }
     }
     return 0;
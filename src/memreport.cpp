@@ -0,0 +1,112 @@
+/**
+ * @file memreport.cpp
+ * @brief Implementation of the memory breakdown of Geralt's collections.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include "memreport.h"
+#include "geralt.h"
+#include "output.h"
+
+using namespace std;
+
+namespace {
+
+/// Color, parent, left and right of a red-black tree node, as laid out by the standard library.
+constexpr uint64_t TREE_LINK_BYTES = 4 * sizeof(void*);
+
+/// Virtual table pointer, the two reference counts and the allocator of an allocate_shared block.
+constexpr uint64_t CONTROL_BLOCK_BYTES = 2 * sizeof(void*) + 2 * sizeof(int);
+
+uint64_t vectorBytes(const Ingredient&) {
+    return 0;
+}
+
+uint64_t vectorBytes(Potion& potion) {
+    return potion.getFormula().capacity() * sizeof(pair<Name, int>);
+}
+
+uint64_t vectorBytes(Monster& monster) {
+    return (monster.getEffectiveSigns().capacity() + monster.getEffectivePotions().capacity()) * sizeof(Name);
+}
+
+uint64_t vectorBytes(const Trophy&) {
+    return 0;
+}
+
+template <typename Entity>
+MemoryReport::CollectionUsage measureCollection(const char* label, EntityMap<Entity>& collection) {
+    MemoryReport::CollectionUsage usage;
+    usage.label = label;
+    usage.entries = collection.size();
+    usage.nodes = usage.entries * (TREE_LINK_BYTES + sizeof(shared_ptr<Entity>));
+    usage.keys = usage.entries * sizeof(Name);
+    usage.controlBlocks = usage.entries * CONTROL_BLOCK_BYTES;
+    usage.entities = usage.entries * (sizeof(Entity) - sizeof(Name));
+    usage.names = usage.entries * sizeof(Name);
+
+    for (auto& entityPair : collection) {
+        usage.vectors += vectorBytes(*entityPair.second);
+    }
+
+    return usage;
+}
+
+} // namespace
+
+uint64_t MemoryReport::Usage::total() const {
+    uint64_t bytes = pool.reserved + pool.indexBytes;
+    for (const CollectionUsage& collection : collections) {
+        bytes += collection.total();
+    }
+    return bytes;
+}
+
+MemoryReport::Usage MemoryReport::measure() {
+    Usage usage;
+    usage.collections[0] = measureCollection("ingredients", Geralt::getIngredients());
+    usage.collections[1] = measureCollection("potions", Geralt::getPotions());
+    usage.collections[2] = measureCollection("monsters", Geralt::getMonsters());
+    usage.collections[3] = measureCollection("trophies", Geralt::getTrophies());
+    usage.pool = NamePool::usage();
+    return usage;
+}
+
+void MemoryReport::report(ostream& out) {
+    Usage usage = measure();
+
+    out << left << setw(14) << "memory (bytes)" << right << setw(12) << "entries" << setw(12) << "nodes"
+        << setw(12) << "keys" << setw(12) << "control" << setw(12) << "entities" << setw(12) << "names"
+        << setw(12) << "vectors" << setw(14) << "total" << "\n";
+
+    for (const CollectionUsage& collection : usage.collections) {
+        out << left << setw(14) << collection.label << right << setw(12) << collection.entries
+            << setw(12) << collection.nodes << setw(12) << collection.keys << setw(12) << collection.controlBlocks
+            << setw(12) << collection.entities << setw(12) << collection.names << setw(12) << collection.vectors
+            << setw(14) << collection.total() << "\n";
+    }
+
+    out << "name pool: " << usage.pool.names << " names longer than " << Name::INLINE_CAPACITY << " characters, "
+        << usage.pool.bytes << " bytes used of " << usage.pool.reserved << " in " << usage.pool.chunks
+        << " chunks, index " << usage.pool.indexBytes << " bytes\n";
+    out << "total: " << usage.total() << " bytes\n";
+}
+
+void MemoryReport::query(const TokenList&) {
+    Usage usage = measure();
+
+    // One line, like every other answer: "<collection> <entries> entries <bytes> bytes" per collection
+    ostringstream line;
+    for (const CollectionUsage& collection : usage.collections) {
+        line << collection.label << " " << collection.entries << " entries " << collection.total() << " bytes, ";
+    }
+    line << "name pool " << usage.pool.names << " names " << usage.pool.reserved + usage.pool.indexBytes
+         << " bytes, total " << usage.total() << " bytes";
+
+    Output::sink().write(line.str());
+    Output::sink().endAnswer();
+}
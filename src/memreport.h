@@ -0,0 +1,78 @@
+#ifndef MEMREPORT_H
+#define MEMREPORT_H
+
+/**
+ * @file memreport.h
+ * @brief Declares the breakdown of the memory held by Geralt's collections.
+ *
+ * The figures are computed from the sizes of the objects involved, not read from the
+ * allocator: what a node, a control block, an entity and its vectors occupy, plus the
+ * footprint of the name pool. Slack inside allocator chunks is not included, so the
+ * total is a lower bound of the resident size of the catalog. Measuring walks every
+ * entity, which is cheap next to anything that would touch that many entities anyway.
+ */
+
+#include <cstdint>
+#include <ostream>
+
+#include "name.h"
+#include "token.h"
+
+/**
+ * @class MemoryReport
+ * @brief Static access to the memory breakdown, as a query answer and as a report.
+ */
+class MemoryReport {
+public:
+    /**
+     * @struct CollectionUsage
+     * @brief Bytes held by one of Geralt's maps, by what they are used for.
+     */
+    struct CollectionUsage {
+        const char* label = "";
+        uint64_t entries = 0;
+        uint64_t nodes = 0;         ///< Tree links and the shared_ptr of every map node
+        uint64_t keys = 0;          ///< Name keys stored in the nodes
+        uint64_t controlBlocks = 0; ///< shared_ptr control blocks, without the entity they hold
+        uint64_t entities = 0;      ///< Entity objects, without their name
+        uint64_t names = 0;         ///< The copy of the key that every entity keeps
+        uint64_t vectors = 0;       ///< Formulas of potions, effective signs and potions of monsters
+
+        uint64_t total() const {
+            return nodes + keys + controlBlocks + entities + names + vectors;
+        }
+    };
+
+    /// Number of collections in a Usage: ingredients, potions, monsters and trophies.
+    static constexpr int COLLECTION_COUNT = 4;
+
+    /**
+     * @struct Usage
+     * @brief Breakdown of all collections and of the name pool they share.
+     */
+    struct Usage {
+        CollectionUsage collections[COLLECTION_COUNT];
+        NamePool::Usage pool;
+
+        uint64_t total() const;
+    };
+
+    /// Measures the current state.
+    static Usage measure();
+
+    /**
+     * @brief Prints the breakdown as a table, one row per collection.
+     *
+     * @param out Stream to print to.
+     */
+    static void report(std::ostream& out);
+
+    /**
+     * @brief Answers the "Memory?" query with the totals of every collection on one line.
+     *
+     * @param tokenList Tokenized input line.
+     */
+    static void query(const TokenList& tokenList);
+};
+
+#endif
@@ -1,21 +1,34 @@
 #include "monster.h"
 #include <string>
 
-Monster::Monster(const string& name) 
-    : name(name), effectiveSigns(), effectivePotions() {}
+Monster::Monster(const Name& name) 
+    : name(name), effectiveSigns(), effectivePotions(), id(0), generation(0) {}
 
-const vector<string>& Monster::getEffectiveSigns() {
+const vector<Name>& Monster::getEffectiveSigns() {
     return this->effectiveSigns;
 }
 
-const vector<string>& Monster::getEffectivePotions() {
+const vector<Name>& Monster::getEffectivePotions() {
     return this->effectivePotions;
 }
 
-void Monster::addEffectiveSign(const string& name) {
-    this->effectiveSigns.push_back(name);
+void Monster::addEffectiveSign(string_view name) {
+    this->effectiveSigns.emplace_back(name);
+    this->generation++;
 }
 
-void Monster::addEffectivePotion(const string& name) {
-    this->effectivePotions.push_back(name);
-}
\ No newline at end of file
+void Monster::addEffectivePotion(string_view name) {
+    this->effectivePotions.emplace_back(name);
+    this->generation++;
+}
+
+const uint64_t& Monster::getGeneration() const {
+    return this->generation;
+}
+uint32_t Monster::getId() const {
+    return this->id;
+}
+
+void Monster::setId(uint32_t id) {
+    this->id = id;
+}
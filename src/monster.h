@@ -7,7 +7,11 @@
  */
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstdint>
+
+#include "name.h"
 
 using namespace std;
 
@@ -19,37 +23,50 @@ using namespace std;
 class Monster {
 private:
     /// Data fields are declared private in order to encapsulate the data.
-    string name;
-    vector<string> effectiveSigns;
-    vector<string> effectivePotions;
+    Name name;
+    vector<Name> effectiveSigns;
+    vector<Name> effectivePotions;
+    uint32_t id;            ///< Dense index of the entity in its collection, in the order of addition
+    uint64_t generation;
 public:
     /**
      * @brief Construct a new Monster.
      * @param name Monster's name.
      */
-    Monster(const string& name);
+    Monster(const Name& name);
 
     /**
      * @brief Getter function for the vector that stores effective signs against the monster
     */
-    const vector<string>& getEffectiveSigns();
+    const vector<Name>& getEffectiveSigns();
 
     /**
      * @brief Getter function for the vector that stores effective potinos against the monster
     */  
-    const vector<string>& getEffectivePotions();
+    const vector<Name>& getEffectivePotions();
 
     /**
      * @brief Adds a sign name to the effective signs list
      * @param name Name of the effective sign
     */
-    void addEffectiveSign(const string& name);
+    void addEffectiveSign(string_view name);
 
     /**
      * @brief Adds a potion name to the effective potions list
      * @param name Name of the effective potion
     */ 
-    void addEffectivePotion(const string& name);
+    void addEffectivePotion(string_view name);
+
+    /**
+     * @brief Version counter bumped on every change, used to validate cached query answers.
+     */
+    const uint64_t& getGeneration() const;
+
+    /**
+     * @brief ID of the entity in its collection, used by the undo log; set by Geralt.
+     */
+    uint32_t getId() const;
+    void setId(uint32_t id);
 };
 
 #endif
\ No newline at end of file
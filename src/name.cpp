@@ -0,0 +1,100 @@
+/**
+ * @file name.cpp
+ * @brief Implementation of the name handle and the name pool.
+ */
+
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "name.h"
+
+using namespace std;
+
+namespace {
+
+/**
+ * @struct PoolState
+ * @brief Chunks of the name pool and the index of the names stored in them.
+ */
+struct PoolState {
+    vector<unique_ptr<char[]>> chunks;
+    size_t reserved = 0;
+    size_t bytes = 0;
+    char* cursor = nullptr;   ///< Next free byte of the last chunk
+    size_t remaining = 0;     ///< Free bytes after the cursor
+    unordered_set<string_view> index;
+};
+
+PoolState& poolState() {
+    // Never destroyed, since names can be read by other static destructors
+    static PoolState* state = new PoolState();
+    return *state;
+}
+
+} // namespace
+
+Name::Name(string_view text) {
+    if (text.size() <= INLINE_CAPACITY) {
+        memcpy(storage, text.data(), text.size());
+        storage[TAG] = static_cast<char>(text.size());
+        return;
+    }
+
+    const char* data = NamePool::intern(text);
+    uint32_t size = static_cast<uint32_t>(text.size());
+    memcpy(storage, &data, sizeof(data));
+    memcpy(storage + sizeof(data), &size, sizeof(size));
+    storage[TAG] = static_cast<char>(POOLED);
+}
+
+const char* NamePool::intern(string_view text) {
+    PoolState& state = poolState();
+
+    auto it = state.index.find(text);
+    if (it != state.index.end()) {
+        return it->data();
+    }
+
+    char* copy;
+    if (text.size() > CHUNK_SIZE / 4) {
+        // A name this long would waste most of a shared chunk; it gets one of its own
+        state.chunks.emplace_back(new char[text.size()]);
+        state.reserved += text.size();
+        copy = state.chunks.back().get();
+    } else {
+        if (text.size() > state.remaining) {
+            state.chunks.emplace_back(new char[CHUNK_SIZE]);
+            state.reserved += CHUNK_SIZE;
+            state.cursor = state.chunks.back().get();
+            state.remaining = CHUNK_SIZE;
+        }
+        copy = state.cursor;
+        state.cursor += text.size();
+        state.remaining -= text.size();
+    }
+
+    memcpy(copy, text.data(), text.size());
+    state.bytes += text.size();
+    state.index.insert(string_view(copy, text.size()));
+    return copy;
+}
+
+NamePool::Usage NamePool::usage() {
+    const PoolState& state = poolState();
+
+    Usage usage;
+    usage.names = state.index.size();
+    usage.bytes = state.bytes;
+    usage.reserved = state.reserved;
+    usage.chunks = state.chunks.size();
+    // One node per name (next pointer, the view and the cached hash) plus the bucket array,
+    // which is only allocated once the first name is inserted
+    usage.indexBytes = state.index.size() * (2 * sizeof(void*) + sizeof(string_view));
+    if (!state.index.empty()) {
+        usage.indexBytes += state.index.bucket_count() * sizeof(void*);
+    }
+    return usage;
+}
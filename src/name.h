@@ -0,0 +1,143 @@
+#ifndef NAME_H
+#define NAME_H
+
+/**
+ * @file name.h
+ * @brief Declares the compact name handle used by Geralt's collections and the pool behind it.
+ *
+ * A name appears in many places: as the key of its map, inside its entity, in every
+ * formula that uses it and in every bestiary entry that mentions it. As std::string
+ * each of those is a 32 byte object, plus a separate heap copy once the name is longer
+ * than the library's small-string buffer. A Name is 16 bytes. Up to INLINE_CAPACITY
+ * characters are stored in the handle itself; longer names are copied once into the
+ * contiguous chunks of the NamePool, and every handle with that text points to the
+ * same bytes.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/**
+ * @class Name
+ * @brief Immutable 16 byte name, either inline or a reference into the NamePool.
+ */
+class Name {
+public:
+    /// Longest name that is stored inside the handle.
+    static constexpr size_t INLINE_CAPACITY = 15;
+
+    /**
+     * @brief Creates a name, interning it in the NamePool if it does not fit inline.
+     *
+     * The constructors are explicit so that comparing a Name with a string never
+     * interns the string just to compare it.
+     */
+    explicit Name(std::string_view text);
+    explicit Name(const std::string& text) : Name(std::string_view(text)) {}
+    explicit Name(const char* text) : Name(std::string_view(text)) {}
+
+    /// Returns the characters of the name.
+    std::string_view view() const {
+        if (isInline()) {
+            return std::string_view(storage, static_cast<unsigned char>(storage[TAG]));
+        }
+
+        const char* data;
+        uint32_t size;
+        std::memcpy(&data, storage, sizeof(data));
+        std::memcpy(&size, storage + sizeof(data), sizeof(size));
+        return std::string_view(data, size);
+    }
+
+    operator std::string_view() const {
+        return view();
+    }
+
+    /// Tells whether the characters live inside the handle rather than in the pool.
+    bool isInline() const {
+        return static_cast<unsigned char>(storage[TAG]) != POOLED;
+    }
+
+    size_t size() const {
+        return view().size();
+    }
+
+    std::string str() const {
+        return std::string(view());
+    }
+
+    friend bool operator==(const Name& a, const Name& b) { return a.view() == b.view(); }
+    friend bool operator==(const Name& a, std::string_view b) { return a.view() == b; }
+    friend bool operator==(std::string_view a, const Name& b) { return a == b.view(); }
+    friend bool operator!=(const Name& a, const Name& b) { return a.view() != b.view(); }
+    friend bool operator!=(const Name& a, std::string_view b) { return a.view() != b; }
+    friend bool operator!=(std::string_view a, const Name& b) { return a != b.view(); }
+    friend bool operator<(const Name& a, const Name& b) { return a.view() < b.view(); }
+
+private:
+    /// Last byte of the storage: the inline length, or POOLED.
+    static constexpr size_t TAG = INLINE_CAPACITY;
+    static constexpr unsigned char POOLED = 0xFF;
+
+    /// Inline: the characters, then the length in the tag byte.
+    /// Pooled: the pointer, then the 32-bit length; the tag byte is POOLED.
+    alignas(const char*) char storage[INLINE_CAPACITY + 1];
+};
+
+static_assert(sizeof(Name) == 16, "Name must stay two words wide");
+
+/**
+ * @struct NameLess
+ * @brief Transparent ordering of names, so maps keyed by Name can be searched with any string.
+ *
+ * The order is that of std::string, so listings keep their alphabetical order.
+ */
+struct NameLess {
+    using is_transparent = void;
+
+    bool operator()(std::string_view a, std::string_view b) const {
+        return a < b;
+    }
+};
+
+/**
+ * @class NamePool
+ * @brief Append-only storage that holds one copy of every name too long to be inlined.
+ *
+ * Names are never removed: a name that was seen once is likely to be seen again, and
+ * handles to it can live on in formulas and bestiary entries after its entity is gone.
+ * Like the entity pool, it is only used by the command thread and needs no locking.
+ */
+class NamePool {
+public:
+    /// Size of one chunk; longer names get a chunk of their own.
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    /**
+     * @struct Usage
+     * @brief Footprint of the pool, for the memory report.
+     */
+    struct Usage {
+        uint64_t names = 0;      ///< Distinct pooled names
+        uint64_t bytes = 0;      ///< Characters stored
+        uint64_t reserved = 0;   ///< Bytes of all chunks
+        uint64_t indexBytes = 0; ///< Estimated size of the lookup table
+        uint64_t chunks = 0;
+    };
+
+    /**
+     * @brief Returns the pooled copy of @p text, adding it if it is new.
+     *
+     * @param text Name to intern.
+     * @return const char* Stable pointer to text.size() characters.
+     */
+    static const char* intern(std::string_view text);
+
+    /// Returns the current footprint of the pool.
+    static Usage usage();
+};
+
+#endif
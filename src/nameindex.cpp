@@ -0,0 +1,205 @@
+/**
+ * @file nameindex.cpp
+ * @brief Implementation of the radix trie over the names of a collection.
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include "nameindex.h"
+
+using namespace std;
+
+NameIndex::NameIndex(pmr::memory_resource* resource) : nodes(resource) {}
+
+uint32_t NameIndex::addNode(string_view label, string_view name) {
+    Node node;
+    node.label = label;
+    node.name = name;
+    nodes.push_back(node);
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void NameIndex::insert(string_view name) {
+    if (nodes.empty()) {
+        addNode(string_view(), string_view());
+    }
+
+    uint32_t current = 0;
+    size_t matched = 0;
+
+    while (true) {
+        if (matched == name.size()) {
+            nodes[current].name = name;
+            return;
+        }
+
+        // The child whose label starts with the next character, and the sibling before the place it goes
+        uint32_t previous = NO_NODE;
+        uint32_t child = nodes[current].firstChild;
+        while (child != NO_NODE && nodes[child].label[0] < name[matched]) {
+            previous = child;
+            child = nodes[child].nextSibling;
+        }
+
+        if (child == NO_NODE || nodes[child].label[0] != name[matched]) {
+            uint32_t leaf = addNode(name.substr(matched), name);
+            nodes[leaf].nextSibling = child;
+            if (previous == NO_NODE) {
+                nodes[current].firstChild = leaf;
+            } else {
+                nodes[previous].nextSibling = leaf;
+            }
+            return;
+        }
+
+        string_view label = nodes[child].label;
+        size_t common = 1;
+        while (common < label.size() && matched + common < name.size() && label[common] == name[matched + common]) {
+            common++;
+        }
+
+        // The name leaves the label part way: the rest of the label moves to a new node below
+        if (common < label.size()) {
+            uint32_t rest = addNode(label.substr(common), nodes[child].name);
+            nodes[rest].firstChild = nodes[child].firstChild;
+            nodes[child].label = label.substr(0, common);
+            nodes[child].name = string_view();
+            nodes[child].firstChild = rest;
+        }
+
+        current = child;
+        matched += common;
+    }
+}
+
+void NameIndex::invalidate() {
+    nodes.clear();
+    built = false;
+}
+
+void NameIndex::withPrefix(string_view prefix, pmr::vector<string_view>& names) const {
+    names.clear();
+    if (nodes.empty()) {
+        return;
+    }
+
+    // The node below which every name starts with the prefix
+    uint32_t current = 0;
+    size_t matched = 0;
+    while (matched < prefix.size()) {
+        uint32_t child = nodes[current].firstChild;
+        while (child != NO_NODE && nodes[child].label[0] != prefix[matched]) {
+            child = nodes[child].nextSibling;
+        }
+        if (child == NO_NODE) {
+            return;
+        }
+
+        string_view label = nodes[child].label;
+        size_t common = min(label.size(), prefix.size() - matched);
+        if (label.compare(0, common, prefix, matched, common) != 0) {
+            return;
+        }
+
+        current = child;
+        matched += common;
+    }
+
+    // Depth first, a name before the longer ones that extend it and children in order
+    pmr::vector<uint32_t> stack(names.get_allocator().resource());
+    stack.push_back(current);
+    while (!stack.empty()) {
+        uint32_t node = stack.back();
+        stack.pop_back();
+
+        if (!nodes[node].name.empty()) {
+            names.push_back(nodes[node].name);
+        }
+
+        // The first child is visited first, so the next sibling of each node is stacked below it
+        if (node != current && nodes[node].nextSibling != NO_NODE) {
+            stack.push_back(nodes[node].nextSibling);
+        }
+        if (nodes[node].firstChild != NO_NODE) {
+            stack.push_back(nodes[node].firstChild);
+        }
+    }
+}
+
+void NameIndex::similar(string_view name, pmr::vector<string_view>& names) const {
+    names.clear();
+    if (nodes.empty()) {
+        return;
+    }
+
+    pmr::memory_resource* scratch = names.get_allocator().resource();
+    size_t width = name.size() + 1;
+
+    // rows[d * width ..] is the row of the edit distance table after d characters of the trie;
+    // depth first order overwrites a row only once the subtrees that read it are done
+    pmr::vector<int> rows(width, 0, scratch);
+    for (size_t j = 0; j < width; j++) {
+        rows[j] = static_cast<int>(j);
+    }
+
+    struct Frame {
+        uint32_t node;
+        size_t depth;   ///< Characters of the trie above the label of the node
+    };
+    pmr::vector<Frame> stack(scratch);
+    pmr::vector<pair<int, string_view>> found(scratch);
+
+    if (nodes[0].firstChild != NO_NODE) {
+        stack.push_back(Frame{nodes[0].firstChild, 0});
+    }
+
+    while (!stack.empty()) {
+        Frame frame = stack.back();
+        stack.pop_back();
+
+        const Node& node = nodes[frame.node];
+        if (node.nextSibling != NO_NODE) {
+            stack.push_back(Frame{node.nextSibling, frame.depth});
+        }
+
+        size_t depth = frame.depth;
+        bool reachable = true;
+        for (size_t k = 0; k < node.label.size() && reachable; k++) {
+            if (rows.size() < (depth + 2) * width) {
+                rows.resize((depth + 2) * width);
+            }
+            const int* above = &rows[depth * width];
+            int* row = &rows[(depth + 1) * width];
+
+            row[0] = above[0] + 1;
+            int best = row[0];
+            for (size_t j = 1; j < width; j++) {
+                int substitution = above[j - 1] + (name[j - 1] == node.label[k] ? 0 : 1);
+                row[j] = min({above[j] + 1, row[j - 1] + 1, substitution});
+                best = min(best, row[j]);
+            }
+
+            depth++;
+            reachable = best <= MAX_EDITS;
+        }
+
+        if (!reachable) {
+            continue;
+        }
+
+        if (!node.name.empty() && rows[depth * width + width - 1] <= MAX_EDITS) {
+            found.emplace_back(rows[depth * width + width - 1], node.name);
+        }
+        if (node.firstChild != NO_NODE) {
+            stack.push_back(Frame{node.firstChild, depth});
+        }
+    }
+
+    sort(found.begin(), found.end());
+
+    names.reserve(found.size());
+    for (const auto& match : found) {
+        names.push_back(match.second);
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+/**
+ * @file nameindex.h
+ * @brief Declares the radix trie that finds the names of a collection by prefix or by similarity.
+ *
+ * Geralt's maps are ordered by name, but a map cannot list the names under a prefix
+ * that ends inside a word without a range scan, nor find the names close to a misspelled
+ * one. A NameIndex holds every name of a collection in a compressed trie: each edge is
+ * labelled with a run of characters, so a chain of single children becomes one node and
+ * the trie has fewer nodes than names. Labels point into the names themselves, which
+ * stay in place until the next reset, so the trie copies no characters.
+ *
+ * Like a StockRanking, an index is built from its map on first use, follows every new
+ * name from then on, and is dropped by Geralt::reset().
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class NameIndex
+ * @brief Every name of a collection in a radix trie whose children are kept in alphabetical order.
+ */
+class NameIndex {
+public:
+    /// Largest edit distance searched by similar().
+    static constexpr int MAX_EDITS = 2;
+
+    explicit NameIndex(std::pmr::memory_resource* resource);
+
+    /// true once the index holds the names of its collection and follows new ones.
+    bool isBuilt() const { return built; }
+    void markBuilt() { built = true; }
+
+    /// Adds a name; @p name must stay valid until invalidate(). Adding a name twice is harmless.
+    void insert(std::string_view name);
+
+    /// Adds a name added to the collection; ignored until the index is built.
+    void update(std::string_view name) {
+        if (built) {
+            insert(name);
+        }
+    }
+
+    /// Drops every node; the index is built again on next use.
+    void invalidate();
+
+    /**
+     * @brief Lists the names that start with a prefix, in alphabetical order.
+     *
+     * Costs O(|prefix|) to find the subtree and O(1) per node of the subtree, which has
+     * fewer nodes than twice the number of names listed.
+     *
+     * @param prefix Prefix of the names, case sensitive.
+     * @param names Receives the names.
+     */
+    void withPrefix(std::string_view prefix, std::pmr::vector<std::string_view>& names) const;
+
+    /**
+     * @brief Lists the names at most MAX_EDITS insertions, deletions or substitutions away from a name.
+     *
+     * One row of the edit distance table is computed per character of the trie, so names
+     * that share a prefix share its rows, and a subtree is skipped as soon as every entry
+     * of the row exceeds MAX_EDITS.
+     *
+     * @param name Name to match, usually misspelled.
+     * @param names Receives the names by increasing distance, ties in alphabetical order.
+     */
+    void similar(std::string_view name, std::pmr::vector<std::string_view>& names) const;
+
+private:
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+    /**
+     * @struct Node
+     * @brief An edge of the trie and the node it leads to.
+     *
+     * The children of a node form a list ordered by the first character of their labels,
+     * which are all different.
+     */
+    struct Node {
+        std::string_view label;             ///< Characters on the edge from the parent
+        std::string_view name;              ///< The name that ends here; empty if none does
+        uint32_t firstChild = NO_NODE;
+        uint32_t nextSibling = NO_NODE;
+    };
+
+    /// nodes[0] is the root, with an empty label.
+    std::pmr::vector<Node> nodes;
+    bool built = false;
+
+    uint32_t addNode(std::string_view label, std::string_view name);
+};
+
+#endif
@@ -0,0 +1,395 @@
+/**
+ * @file optimizer.cpp
+ * @brief Implementation of the max-yield brew optimizer.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+#include "optimizer.h"
+#include "arena.h"
+#include "formulamatrix.h"
+
+using namespace std;
+
+namespace {
+
+/// Slack for comparing floating point bounds with integer values.
+constexpr double EPSILON = 1e-6;
+
+/// Subgradient steps of one solve at most; warm-started solves usually stop much earlier.
+constexpr int MAX_PRICE_STEPS = 200;
+
+/**
+ * @struct Model
+ * @brief State that is carried from one solve to the next, per row and column of the formula matrix.
+ */
+struct Model {
+    uint64_t matrixVersion = UINT64_MAX;        ///< Version of the formula matrix the state below is numbered by
+
+    vector<long long> values;                   ///< Objective of the last solve, per row
+    bool weighted = true;                       ///< false while values counts every potion once
+    vector<double> prices;                      ///< Lagrange multipliers of the last solve, per column
+    vector<long long> incumbent;                ///< Mix of the last solve, per row
+
+    uint64_t solvedStock = UINT64_MAX;          ///< Ingredient generation of the memoized result
+    BrewMix result;
+};
+
+Model model;
+
+/**
+ * @class Solver
+ * @brief One solve over the current stock; scratch data lives in the command arena.
+ */
+class Solver {
+private:
+    typedef pmr::vector<long long> Counts;
+
+    const FormulaMatrix& matrix;
+    size_t rows;
+    Counts stock;       ///< Current stock of every column
+    Counts residual;    ///< Stock left by the mix being built
+    Counts upper;       ///< Most of each potion the full stock allows
+    Counts mix;         ///< Mix being built
+    Counts best;        ///< Best mix found
+    long long bestValue = 0;
+    pmr::vector<double> reducedValue;   ///< Value minus the priced ingredients, per row
+
+    // Branch-and-bound state
+    pmr::vector<uint32_t> order;
+    pmr::vector<double> suffixBound;
+    uint64_t nodes = 0;
+    bool exhausted = false;
+
+    /// Number of potions of row @p p that fit into the residual stock.
+    long long fit(size_t p) const {
+        long long count = LLONG_MAX;
+        for (uint32_t k = matrix.rowStart[p]; k < matrix.rowStart[p + 1]; k++) {
+            count = min(count, residual[matrix.column[k]] / matrix.amount[k]);
+        }
+        return count;
+    }
+
+    /// Adds @p count potions of row @p p to the mix, or removes them for a negative count.
+    void brew(size_t p, long long count) {
+        for (uint32_t k = matrix.rowStart[p]; k < matrix.rowStart[p + 1]; k++) {
+            residual[matrix.column[k]] -= matrix.amount[k] * count;
+        }
+        mix[p] += count;
+    }
+
+    /// Prices of the ingredients of row @p p.
+    double priceOf(size_t p) const {
+        double price = 0.0;
+        for (uint32_t k = matrix.rowStart[p]; k < matrix.rowStart[p + 1]; k++) {
+            price += model.prices[matrix.column[k]] * static_cast<double>(matrix.amount[k]);
+        }
+        return price;
+    }
+
+    /**
+     * @brief Builds the incumbent: the previous mix as far as it still fits, extended greedily.
+     */
+    void greedy() {
+        residual = stock;
+        fill(mix.begin(), mix.end(), 0);
+
+        for (size_t p = 0; p < rows; p++) {
+            long long keep = min(model.incumbent[p], fit(p));
+            if (keep > 0) {
+                brew(p, keep);
+            }
+        }
+
+        // Cheapest potions first: ingredients cost their price plus a share of how scarce they are
+        pmr::vector<pair<double, uint32_t>> byCost(CommandArena::resource());
+        for (size_t p = 0; p < rows; p++) {
+            if (model.values[p] <= 0 || upper[p] == 0) {
+                continue;
+            }
+            double cost = 0.0;
+            for (uint32_t k = matrix.rowStart[p]; k < matrix.rowStart[p + 1]; k++) {
+                uint32_t c = matrix.column[k];
+                cost += static_cast<double>(matrix.amount[k]) * (model.prices[c] + 1.0 / static_cast<double>(stock[c] + 1));
+            }
+            byCost.emplace_back(cost / static_cast<double>(model.values[p]), static_cast<uint32_t>(p));
+        }
+        sort(byCost.begin(), byCost.end());
+
+        for (const auto& entry : byCost) {
+            long long more = fit(entry.second);
+            if (more > 0) {
+                brew(entry.second, more);
+            }
+        }
+
+        best = mix;
+        bestValue = 0;
+        for (size_t p = 0; p < rows; p++) {
+            bestValue += model.values[p] * mix[p];
+        }
+    }
+
+    /**
+     * @brief Lagrangian bound of the prices: priced stock plus the potions that are worth more than their price.
+     */
+    double lagrangianBound() {
+        double bound = 0.0;
+        for (size_t c = 0; c < stock.size(); c++) {
+            bound += model.prices[c] * static_cast<double>(stock[c]);
+        }
+        for (size_t p = 0; p < rows; p++) {
+            reducedValue[p] = static_cast<double>(model.values[p]) - priceOf(p);
+            if (reducedValue[p] > 0) {
+                bound += reducedValue[p] * static_cast<double>(upper[p]);
+            }
+        }
+        return bound;
+    }
+
+    /**
+     * @brief Improves the ingredient prices with subgradient steps and returns the best bound found.
+     *
+     * Stops as soon as the bound proves the incumbent optimal.
+     */
+    double improvePrices() {
+        pmr::vector<double> bestPrices(model.prices.begin(), model.prices.end(), CommandArena::resource());
+        Counts slack(stock.size(), 0, CommandArena::resource());
+        double bestBound = lagrangianBound();
+        double step = 2.0;
+        int stalled = 0;
+
+        for (int iteration = 0; iteration < MAX_PRICE_STEPS; iteration++) {
+            if (floor(bestBound + EPSILON) <= static_cast<double>(bestValue)) {
+                break;
+            }
+
+            // Subgradient: stock minus what the potions with a positive reduced value would use
+            slack = stock;
+            for (size_t p = 0; p < rows; p++) {
+                if (reducedValue[p] > 0) {
+                    for (uint32_t k = matrix.rowStart[p]; k < matrix.rowStart[p + 1]; k++) {
+                        slack[matrix.column[k]] -= matrix.amount[k] * upper[p];
+                    }
+                }
+            }
+
+            double norm = 0.0;
+            for (size_t c = 0; c < slack.size(); c++) {
+                // A zero price with spare stock cannot go lower, so that component does not move
+                if (model.prices[c] > 0 || slack[c] < 0) {
+                    norm += static_cast<double>(slack[c]) * static_cast<double>(slack[c]);
+                }
+            }
+            if (norm == 0.0) {
+                break;
+            }
+
+            double length = step * (lagrangianBound() - static_cast<double>(bestValue)) / norm;
+            for (size_t c = 0; c < slack.size(); c++) {
+                model.prices[c] = max(0.0, model.prices[c] - length * static_cast<double>(slack[c]));
+            }
+
+            double bound = lagrangianBound();
+            if (bound < bestBound - EPSILON) {
+                bestBound = bound;
+                bestPrices.assign(model.prices.begin(), model.prices.end());
+                stalled = 0;
+            } else if (++stalled >= 5) {
+                step /= 2.0;
+                stalled = 0;
+                if (step < 1e-4) {
+                    break;
+                }
+            }
+        }
+
+        copy(bestPrices.begin(), bestPrices.end(), model.prices.begin());
+        lagrangianBound();
+        return bestBound;
+    }
+
+    /**
+     * @brief Depth-first search over the potions in @p order, from the mix with nothing brewed.
+     *
+     * One frame per potion is kept on an explicit stack, since there can be thousands of them.
+     *
+     * @param pricedStock Priced stock, the first part of the bound.
+     */
+    void search(double pricedStock) {
+        struct Frame {
+            long long count;        ///< Count of the potion being tried
+            long long most;         ///< Most of the potion that fits
+            long long step;         ///< -1 to try the counts from the most down, 1 from zero up
+            long long value;        ///< Value of the potions fixed above this frame
+            double pricedStock;     ///< Priced residual stock left by them
+        };
+
+        pmr::vector<Frame> frames(order.size() + 1, Frame{}, CommandArena::resource());
+        frames[0].pricedStock = pricedStock;
+        size_t depth = 0;
+        bool entering = true;
+
+        while (true) {
+            Frame& frame = frames[depth];
+
+            if (entering) {
+                if (++nodes > BrewOptimizer::MAX_NODES) {
+                    exhausted = true;
+                    return;
+                }
+
+                if (depth < order.size()) {
+                    uint32_t p = order[depth];
+                    frame.most = fit(p);
+                    frame.step = reducedValue[p] >= 0 ? -1 : 1;
+                    frame.count = frame.step < 0 ? frame.most : 0;
+                } else if (frame.value > bestValue) {
+                    bestValue = frame.value;
+                    best = mix;
+                }
+            }
+
+            // The bound of a child is linear in its count, so the counts are tried from the best bound on until one cannot win
+            if (depth < order.size() && frame.count >= 0 && frame.count <= frame.most) {
+                uint32_t p = order[depth];
+                long long value = frame.value + model.values[p] * frame.count;
+                double priced = frame.pricedStock - priceOf(p) * static_cast<double>(frame.count);
+
+                if (floor(static_cast<double>(value) + priced + suffixBound[depth + 1] + EPSILON) > static_cast<double>(bestValue)) {
+                    brew(p, frame.count);
+                    frames[depth + 1].value = value;
+                    frames[depth + 1].pricedStock = priced;
+                    depth++;
+                    entering = true;
+                    continue;
+                }
+            }
+
+            if (depth == 0) {
+                return;
+            }
+
+            depth--;
+            brew(order[depth], -frames[depth].count);
+            frames[depth].count += frames[depth].step;
+            entering = false;
+        }
+    }
+
+public:
+    explicit Solver(const FormulaMatrix& matrix)
+        : matrix(matrix),
+          rows(matrix.rows()),
+          stock(matrix.columns(), 0, CommandArena::resource()),
+          residual(CommandArena::resource()),
+          upper(rows, 0, CommandArena::resource()),
+          mix(rows, 0, CommandArena::resource()),
+          best(CommandArena::resource()),
+          reducedValue(rows, 0.0, CommandArena::resource()),
+          order(CommandArena::resource()),
+          suffixBound(CommandArena::resource()) {}
+
+    void solve(BrewMix& result) {
+        for (size_t c = 0; c < stock.size(); c++) {
+            stock[c] = matrix.stock(static_cast<uint32_t>(c));
+        }
+
+        residual = stock;
+        for (size_t p = 0; p < rows; p++) {
+            upper[p] = model.values[p] > 0 ? fit(p) : 0;
+        }
+
+        greedy();
+        double rootBound = improvePrices();
+
+        if (floor(rootBound + EPSILON) > static_cast<double>(bestValue)) {
+            // Potions worth the most above their price first, so that the first dives find good mixes
+            for (size_t p = 0; p < rows; p++) {
+                if (upper[p] > 0) {
+                    order.push_back(static_cast<uint32_t>(p));
+                }
+            }
+            stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+                return reducedValue[a] > reducedValue[b];
+            });
+
+            suffixBound.assign(order.size() + 1, 0.0);
+            for (size_t depth = order.size(); depth-- > 0;) {
+                uint32_t p = order[depth];
+                suffixBound[depth] = suffixBound[depth + 1] + max(0.0, reducedValue[p]) * static_cast<double>(upper[p]);
+            }
+
+            double pricedStock = 0.0;
+            for (size_t c = 0; c < stock.size(); c++) {
+                pricedStock += model.prices[c] * static_cast<double>(stock[c]);
+            }
+
+            residual = stock;
+            fill(mix.begin(), mix.end(), 0);
+            search(pricedStock);
+        }
+
+        result.value = bestValue;
+        result.bound = exhausted ? max(bestValue, static_cast<long long>(floor(rootBound + EPSILON))) : bestValue;
+        result.potions.clear();
+        for (size_t p = 0; p < rows; p++) {
+            model.incumbent[p] = best[p];
+            if (best[p] > 0) {
+                result.potions.push_back(ItemCount{matrix.potions[p], static_cast<int>(best[p])});
+            }
+        }
+    }
+};
+
+} // namespace
+
+const BrewMix& BrewOptimizer::maximize() {
+    return maximize(Span<ItemCount>());
+}
+
+const BrewMix& BrewOptimizer::maximize(Span<ItemCount> values) {
+    const FormulaMatrix& matrix = FormulaMatrix::current();
+
+    // Rows and columns were numbered again, so the state kept for them no longer applies
+    if (model.matrixVersion != matrix.getVersion()) {
+        model = Model();
+        model.prices.assign(matrix.columns(), 0.0);
+        model.incumbent.assign(matrix.rows(), 0);
+        model.matrixVersion = matrix.getVersion();
+    }
+
+    uint64_t stock = Geralt::getIngredientGenerations().contents;
+    if (values.empty() && !model.weighted && model.solvedStock == stock) {
+        return model.result;
+    }
+
+    // Every potion counts once, unless values are given
+    pmr::vector<long long> objective(matrix.rows(), values.empty() ? 1 : 0, CommandArena::resource());
+    for (const ItemCount& item : values) {
+        uint32_t row = matrix.row(item.name);
+        if (row != FormulaMatrix::NO_ROW) {
+            objective[row] = max(0, item.quantity);
+        }
+    }
+
+    bool sameObjective = equal(objective.begin(), objective.end(), model.values.begin(), model.values.end());
+    if (sameObjective && model.solvedStock == stock) {
+        return model.result;
+    }
+
+    model.values.assign(objective.begin(), objective.end());
+    model.weighted = !values.empty();
+    Solver(matrix).solve(model.result);
+    model.solvedStock = stock;
+    return model.result;
+}
+
+void BrewOptimizer::clear() {
+    model = Model();
+}
@@ -0,0 +1,72 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+/**
+ * @file optimizer.h
+ * @brief Declares the optimizer that finds the brew mix yielding the most potions.
+ *
+ * Formulas compete for the same ingredients, so brewing the most potions is an integer
+ * packing problem: maximize the sum of value * count over the potions, while the
+ * ingredients used by all formulas together stay within Geralt's stock.
+ *
+ * The solver works on the shared FormulaMatrix, with one row per formula. Potions that
+ * need an ingredient Geralt never had cannot be brewed and stay out of the mix. A solve
+ * consists of three steps:
+ * - A greedy mix, started from the previous solution, gives the incumbent. After a
+ *   loot the stock has only grown, so the previous mix still fits and is only extended.
+ * - The LP relaxation bounds the optimum from above. It is solved in its Lagrangian
+ *   dual form, with one price per ingredient improved by subgradient steps, because a
+ *   simplex tableau of thousands of formulas would not fit in memory. The prices are
+ *   kept for the next solve, which usually needs only a few steps.
+ * - A depth-first branch-and-bound over the potions, ordered by their reduced value
+ *   under these prices, closes the gap. Its bounds are updated incrementally per node.
+ *   The search stops after MAX_NODES nodes; the mix is then reported with the
+ *   bound it is known to be within.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include "geralt.h"
+
+/**
+ * @struct BrewMix
+ * @brief Potions to brew together, and how good the mix is known to be.
+ */
+struct BrewMix {
+    long long value = 0;            ///< Number of potions, or total value, of the mix
+    long long bound = 0;            ///< Proven upper bound of the optimum; equal to value when the mix is optimal
+    std::vector<ItemCount> potions; ///< Potions to brew with their counts, in alphabetical order
+};
+
+/**
+ * @class BrewOptimizer
+ * @brief Static optimizer over Geralt's formulas and ingredient stock.
+ */
+class BrewOptimizer {
+public:
+    /// Branch-and-bound nodes visited by one solve before it settles for the best mix found.
+    static constexpr uint64_t MAX_NODES = 200000;
+
+    /**
+     * @brief Finds the mix that yields the most potions.
+     *
+     * The answer is memoized until the ingredient stock or the formulas change.
+     *
+     * @return const BrewMix& The mix; valid until the next call.
+     */
+    static const BrewMix& maximize();
+
+    /**
+     * @brief Finds the mix of the highest total value.
+     *
+     * @param values Value of one potion of each listed name; potions that are not listed are worth nothing.
+     * @return const BrewMix& The mix; valid until the next call.
+     */
+    static const BrewMix& maximize(Span<ItemCount> values);
+
+    /// Forgets the memoized mix and the warm-start state.
+    static void clear();
+};
+
+#endif
@@ -0,0 +1,119 @@
+/**
+ * @file output.cpp
+ * @brief Implementation of the answer sinks.
+ */
+
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "output.h"
+#include "stats.h"
+
+using namespace std;
+
+OutputSink* Output::current = nullptr;
+
+void OutputSink::write(long long value) {
+    char digits[24];
+    to_chars_result result = to_chars(digits, digits + sizeof(digits), value);
+    write(string_view(digits, static_cast<size_t>(result.ptr - digits)));
+}
+
+BufferSink::BufferSink(int fd, size_t capacity) : fd(fd) {
+    buffer.reserve(capacity);
+}
+
+bool BufferSink::drain(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void BufferSink::write(string_view text) {
+    if (buffer.size() + text.size() > buffer.capacity()) {
+        flush();
+
+        // An answer larger than the whole buffer goes out directly
+        if (text.size() > buffer.capacity()) {
+            Stats::Span span(Stats::STAGE_OUTPUT);
+            drain(text.data(), text.size());
+            return;
+        }
+    }
+    buffer.append(text);
+}
+
+void BufferSink::endAnswer() {
+    write(string_view("\n", 1));
+}
+
+void BufferSink::flush() {
+    if (buffer.empty()) {
+        return;
+    }
+
+    Stats::Span span(Stats::STAGE_OUTPUT);
+    drain(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+bool SocketSink::drain(const char* data, size_t size) {
+    while (connected && size > 0) {
+        ssize_t sent = ::send(descriptor(), data, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            connected = false;
+            break;
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return connected;
+}
+
+void VectorSink::write(string_view text) {
+    current.append(text);
+}
+
+void VectorSink::endAnswer() {
+    answers.push_back(move(current));
+    current.clear();
+}
+
+void VectorSink::clear() {
+    answers.clear();
+    current.clear();
+}
+
+OutputSink& Output::sink() {
+    if (current == nullptr) {
+        redirect(nullptr);
+    }
+    return *current;
+}
+
+OutputSink* Output::redirect(OutputSink* sink) {
+    // Never destroyed, so answers still buffered when exit handlers run can be flushed
+    static BufferSink* standardOutput = new BufferSink(STDOUT_FILENO);
+
+    OutputSink* previous = current != nullptr ? current : standardOutput;
+    current = sink != nullptr ? sink : standardOutput;
+    return previous;
+}
+
+void Output::flush() {
+    sink().flush();
+}
@@ -0,0 +1,157 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+/**
+ * @file output.h
+ * @brief Declares the sinks that receive the answers of the commands.
+ *
+ * Commands never talk to std::cout. They append their answer to the current sink and
+ * end it with endAnswer(); what happens to the bytes is up to the sink. Writing never
+ * flushes: the driver loop decides when buffered answers are handed to the operating
+ * system, typically only when it is about to wait for more input.
+ */
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Appends the decimal representation of @p value to @p text without a temporary string.
+ */
+inline void appendInteger(std::string& text, long long value) {
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr);
+}
+
+/**
+ * @class OutputSink
+ * @brief Destination of the answers; an answer is any number of writes followed by endAnswer().
+ */
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+
+    /// Appends text to the current answer.
+    virtual void write(std::string_view text) = 0;
+
+    /// Appends a decimal integer to the current answer.
+    virtual void write(long long value);
+
+    /// Ends the current answer.
+    virtual void endAnswer() = 0;
+
+    /// Hands everything written so far to its destination. Only the driver calls this.
+    virtual void flush() {}
+};
+
+/**
+ * @class BufferSink
+ * @brief Collects answers, one per line, in a reusable buffer and writes it to a file descriptor on flush.
+ *
+ * The buffer is allocated once. When an answer does not fit into what is left of it,
+ * the buffer is flushed early so that it never grows.
+ */
+class BufferSink : public OutputSink {
+private:
+    std::string buffer;
+    int fd;
+
+protected:
+    /// Writes out @p size bytes; returns false when the destination is gone.
+    virtual bool drain(const char* data, size_t size);
+
+    int descriptor() const { return fd; }
+
+public:
+    /// Default size of the buffer.
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    explicit BufferSink(int fd, size_t capacity = DEFAULT_CAPACITY);
+
+    using OutputSink::write;
+    void write(std::string_view text) override;
+    void endAnswer() override;
+    void flush() override;
+};
+
+/**
+ * @class SocketSink
+ * @brief Buffer sink for a connected stream socket.
+ *
+ * Sends with MSG_NOSIGNAL, so a client that disconnects does not kill the process
+ * with SIGPIPE; answers written after that are dropped.
+ */
+class SocketSink : public BufferSink {
+private:
+    bool connected = true;
+
+protected:
+    bool drain(const char* data, size_t size) override;
+
+public:
+    explicit SocketSink(int fd, size_t capacity = DEFAULT_CAPACITY) : BufferSink(fd, capacity) {}
+
+    /// Returns false once the peer has closed the connection.
+    bool isConnected() const { return connected; }
+};
+
+/**
+ * @class NullSink
+ * @brief Discards every answer; used by benchmarks and when the journal replays commands.
+ */
+class NullSink : public OutputSink {
+public:
+    void write(std::string_view) override {}
+    void write(long long) override {}
+    void endAnswer() override {}
+};
+
+/**
+ * @class VectorSink
+ * @brief Keeps every answer as a separate string, for programs that run commands in process.
+ */
+class VectorSink : public OutputSink {
+private:
+    std::vector<std::string> answers;
+    std::string current;
+
+public:
+    using OutputSink::write;
+    void write(std::string_view text) override;
+    void endAnswer() override;
+
+    /// Answers ended so far, oldest first.
+    const std::vector<std::string>& results() const { return answers; }
+
+    /// Forgets the collected answers.
+    void clear();
+};
+
+/**
+ * @class Output
+ * @brief Static access to the sink that answers currently go to.
+ */
+class Output {
+private:
+    static OutputSink* current;
+
+public:
+    /// Returns the current sink; by default a BufferSink on standard output.
+    static OutputSink& sink();
+
+    /**
+     * @brief Sends the following answers to @p sink.
+     *
+     * @param sink New sink, or nullptr for the default one. It must outlive its use.
+     * @return OutputSink* The previous sink, so that it can be restored.
+     */
+    static OutputSink* redirect(OutputSink* sink);
+
+    /// Flushes the current sink.
+    static void flush();
+};
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ * @file parsecache.cpp
+ * @brief Implementation of the line-level parse cache.
+ */
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+
+#include "parsecache.h"
+
+using namespace std;
+
+vector<ParseCache::Entry> ParseCache::entries(ParseCache::DEFAULT_CAPACITY);
+vector<uint8_t> ParseCache::recent(ParseCache::DEFAULT_CAPACITY / 2);
+size_t ParseCache::setMask = ParseCache::DEFAULT_CAPACITY / 2 - 1;
+ParseCache::Statistics ParseCache::stats;
+
+uint64_t ParseCache::hashLine(const string& line) {
+    return hash<string_view>()(string_view(line));
+}
+
+void ParseCache::setCapacity(size_t capacity) {
+    size_t sets = 1;
+    while (sets * 2 < capacity) {
+        sets *= 2;
+    }
+
+    if (capacity == 0) {
+        entries.clear();
+        recent.clear();
+        setMask = 0;
+        return;
+    }
+
+    entries.assign(sets * 2, Entry());
+    recent.assign(sets, 0);
+    setMask = sets - 1;
+}
+
+const ParseCache::Entry* ParseCache::lookup(const string& line) {
+    if (entries.empty() || line.size() > MAX_LINE_LENGTH) {
+        return nullptr;
+    }
+
+    stats.lookups++;
+
+    uint64_t lineHash = hashLine(line);
+    size_t set = lineHash & setMask;
+
+    for (size_t way = 0; way < 2; way++) {
+        const Entry& entry = entries[set * 2 + way];
+        if (entry.used && entry.hash == lineHash && entry.line == line) {
+            recent[set] = static_cast<uint8_t>(way);
+            stats.hits++;
+            return &entry;
+        }
+    }
+
+    return nullptr;
+}
+
+void ParseCache::insert(const string& line, optional<ParserActionType> action, const TokenList& tokens) {
+    if (entries.empty() || line.size() > MAX_LINE_LENGTH) {
+        return;
+    }
+
+    uint64_t lineHash = hashLine(line);
+    size_t set = lineHash & setMask;
+
+    // Fill an empty way first, otherwise replace the one that was not used most recently
+    size_t way = !entries[set * 2].used ? 0 : !entries[set * 2 + 1].used ? 1 : 1 - recent[set];
+    Entry& entry = entries[set * 2 + way];
+
+    if (entry.used) {
+        stats.evictions++;
+    }
+
+    entry.line = line;
+    entry.hash = lineHash;
+    entry.used = true;
+    entry.action = action;
+    if (action) {
+        entry.tokens = tokens;
+    } else {
+        entry.tokens.clear();
+    }
+
+    recent[set] = static_cast<uint8_t>(way);
+    stats.insertions++;
+}
+
+const ParseCache::Statistics& ParseCache::statistics() {
+    return stats;
+}
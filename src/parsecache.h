@@ -0,0 +1,101 @@
+#ifndef PARSECACHE_H
+#define PARSECACHE_H
+
+/**
+ * @file parsecache.h
+ * @brief Declares the bounded cache from raw command lines to their parse results.
+ *
+ * Monitoring traffic repeats the same handful of lines ("Total ingredient?",
+ * "Geralt brews Swallow", ...) over and over. The cache remembers, for each recently
+ * seen line, either the matched action with its refined tokens or the fact that the
+ * line is INVALID, so a repeated line skips the tokenizer and the grammar matcher.
+ */
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <optional>
+
+#include "parser.h"
+#include "token.h"
+
+/**
+ * @class ParseCache
+ * @brief Two-way set-associative cache keyed by a hash of the raw line.
+ *
+ * Each set holds two entries; a miss replaces the entry of the set that was used
+ * least recently. The full line is kept in the entry and compared on lookup, so a
+ * hash collision can never return the parse result of another line.
+ */
+class ParseCache {
+public:
+    /**
+     * @struct Entry
+     * @brief A cached parse result.
+     */
+    struct Entry {
+        std::string line;                       ///< Raw line this entry was parsed from
+        uint64_t hash = 0;                      ///< Hash of @c line
+        bool used = false;                      ///< False for an empty slot
+        std::optional<ParserActionType> action; ///< Matched action, or nullopt for INVALID
+        TokenList tokens;                       ///< Refined tokens (empty for INVALID)
+    };
+
+    /**
+     * @struct Statistics
+     * @brief Counters describing how well the cache works on the current traffic.
+     */
+    struct Statistics {
+        uint64_t lookups = 0;
+        uint64_t hits = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+
+        /// Fraction of lookups that were hits, between 0 and 1.
+        double hitRate() const { return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups; }
+    };
+
+    /// Default number of cached lines.
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+    /// Lines longer than this are never cached; they are practically never repeated.
+    static constexpr size_t MAX_LINE_LENGTH = 256;
+
+    /**
+     * @brief Resizes the cache and drops every entry. A capacity of 0 disables caching.
+     *
+     * @param capacity Number of lines to keep, rounded up to a power of two.
+     */
+    static void setCapacity(size_t capacity);
+
+    /**
+     * @brief Looks up the parse result of a line.
+     *
+     * @param line Raw command line.
+     * @return const Entry* The cached result, or nullptr on a miss.
+     */
+    static const Entry* lookup(const std::string& line);
+
+    /**
+     * @brief Remembers the parse result of a line after a miss.
+     *
+     * @param line Raw command line.
+     * @param action Matched action, or nullopt when the line is INVALID.
+     * @param tokens Refined tokens of the line; ignored for INVALID lines.
+     */
+    static void insert(const std::string& line, std::optional<ParserActionType> action, const TokenList& tokens);
+
+    /// Returns the hit/miss counters collected so far.
+    static const Statistics& statistics();
+
+private:
+    static std::vector<Entry> entries;  ///< Sets are pairs of consecutive entries
+    static std::vector<uint8_t> recent; ///< Index (0 or 1) of the most recently used entry of each set
+    static size_t setMask;
+    static Statistics stats;
+
+    static uint64_t hashLine(const std::string& line);
+};
+
+#endif
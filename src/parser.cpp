@@ -9,23 +9,26 @@
 #include <unordered_map>
 #include <iostream>
 #include <cstdlib>
+#include <optional>
 
 #include "token.h"
 #include "parser.h"
-#include "geralt.h"
+#include "commands.h"
+#include "stats.h"
+#include "memreport.h"
 
 
 using namespace std;
 
 /// Function pointer type for inventory actions taking a vector of tokens.
-typedef void (*InventoryFunc)(const vector<Token>&);
+typedef void (*InventoryFunc)(const TokenList&);
 
 /**
  * @brief Terminates the program.
  * 
  * @param tokens Vector of tokens passed to this function (unused), just for compatibility with inventory functions in terms of signature.
  */
-void exitProgram(const vector<Token>&);
+void exitProgram(const TokenList&);
 
 
 /**
@@ -49,7 +52,31 @@ unordered_map<ParserActionType, vector<TokenType>> actionToSyntaxMap = {
     {TOTAL_SPECIFIC_TROPHY_QUERY, totalSpecTrophyQueryVec},
     {BESTIARY_QUERY, bestiaryQueryVec},
     {ALCHEMY_QUERY, alchQueryVec},
-    {EXIT_COMMAND, exitComVec}
+    {EXIT_COMMAND, exitComVec},
+    {STATS_QUERY, statsQueryVec},
+    {MEMORY_QUERY, memoryQueryVec},
+    {PLAN_QUERY, planQueryVec},
+    {BREW_MIX_QUERY, brewMixQueryVec},
+    {SHOPPING_LIST_QUERY, shoppingListQueryVec},
+    {RANKED_INGREDIENT_QUERY, rankedIngredQueryVec},
+    {RANKED_POTION_QUERY, rankedPotQueryVec},
+    {RANKED_TROPHY_QUERY, rankedTrophyQueryVec},
+    {TOTAL_MULTI_INGREDIENT_QUERY, totalMultiIngredQueryVec},
+    {TOTAL_MULTI_POTION_QUERY, totalMultiPotQueryVec},
+    {TOTAL_MULTI_TROPHY_QUERY, totalMultiTrophyQueryVec},
+    {NAME_SEARCH_INGREDIENT_QUERY, nameSearchIngredQueryVec},
+    {NAME_SEARCH_POTION_QUERY, nameSearchPotQueryVec},
+    {NAME_SEARCH_TROPHY_QUERY, nameSearchTrophyQueryVec},
+    {TOTAL_ALL_INGREDIENT_AT_QUERY, totalAllIngredAtQueryVec},
+    {TOTAL_ALL_POTION_AT_QUERY, totalAllPotAtQueryVec},
+    {TOTAL_ALL_TROPHY_AT_QUERY, totalAllTrophyAtQueryVec},
+    {TOTAL_SPECIFIC_INGREDIENT_AT_QUERY, totalSpecificIngredAtQueryVec},
+    {TOTAL_SPECIFIC_POTION_AT_QUERY, totalSpecificPotAtQueryVec},
+    {TOTAL_SPECIFIC_TROPHY_AT_QUERY, totalSpecificTrophyAtQueryVec},
+    {WHAT_IF_QUERY, whatIfQueryVec},
+    {BEGIN_COMMAND, beginComVec},
+    {COMMIT_COMMAND, commitComVec},
+    {ROLLBACK_COMMAND, rollbackComVec}
 };
 
 
@@ -59,42 +86,93 @@ unordered_map<ParserActionType, vector<TokenType>> actionToSyntaxMap = {
  * Once a sentence matches a syntax pattern, the corresponding function is called via this map.
  */
 unordered_map<ParserActionType, InventoryFunc> actionToFuncMap = {
-    {LOOT_ACTION, Geralt::loot},
-    {TRADE_ACTION, Geralt::trade},
-    {BREW_ACTION, Geralt::brew},
-    {KNOWLEDGE_EFFECTIVENESS_SIGN, Geralt::learnSign},
-    {KNOWLEDGE_EFFECTIVENESS_POTION, Geralt::learnPotion},
-    {KNOWLEDGE_POTION_FORMULA, Geralt::learnFormula},
-    {ENCOUNTER, Geralt::encounter},
-    {TOTAL_ALL_INGREDIENT_QUERY, Geralt::queryAllIngredients},
-    {TOTAL_ALL_POTION_QUERY, Geralt::queryAllPotions},
-    {TOTAL_ALL_TROPHY_QUERY, Geralt::queryAllTrophies},
-    {TOTAL_SPECIFIC_INGREDIENT_QUERY, Geralt::querySpecificIngredient},
-    {TOTAL_SPECIFIC_POTION_QUERY, Geralt::querySpecificPotion},
-    {TOTAL_SPECIFIC_TROPHY_QUERY, Geralt::querySpecificTrophy},
-    {BESTIARY_QUERY, Geralt::queryEffectiveness},
-    {ALCHEMY_QUERY, Geralt::queryFormula},
-    {EXIT_COMMAND, exitProgram} // ADD EXIT COMMAND HERE
+    {LOOT_ACTION, Commands::loot},
+    {TRADE_ACTION, Commands::trade},
+    {BREW_ACTION, Commands::brew},
+    {KNOWLEDGE_EFFECTIVENESS_SIGN, Commands::learnSign},
+    {KNOWLEDGE_EFFECTIVENESS_POTION, Commands::learnPotion},
+    {KNOWLEDGE_POTION_FORMULA, Commands::learnFormula},
+    {ENCOUNTER, Commands::encounter},
+    {TOTAL_ALL_INGREDIENT_QUERY, Commands::queryAllIngredients},
+    {TOTAL_ALL_POTION_QUERY, Commands::queryAllPotions},
+    {TOTAL_ALL_TROPHY_QUERY, Commands::queryAllTrophies},
+    {TOTAL_SPECIFIC_INGREDIENT_QUERY, Commands::querySpecificIngredient},
+    {TOTAL_SPECIFIC_POTION_QUERY, Commands::querySpecificPotion},
+    {TOTAL_SPECIFIC_TROPHY_QUERY, Commands::querySpecificTrophy},
+    {BESTIARY_QUERY, Commands::queryEffectiveness},
+    {ALCHEMY_QUERY, Commands::queryFormula},
+    {EXIT_COMMAND, exitProgram}, // ADD EXIT COMMAND HERE
+    {STATS_QUERY, Stats::query},
+    {MEMORY_QUERY, MemoryReport::query},
+    {PLAN_QUERY, Commands::queryPlan},
+    {BREW_MIX_QUERY, Commands::queryBrewMix},
+    {SHOPPING_LIST_QUERY, Commands::queryShoppingList},
+    {RANKED_INGREDIENT_QUERY, Commands::queryRankedIngredients},
+    {RANKED_POTION_QUERY, Commands::queryRankedPotions},
+    {RANKED_TROPHY_QUERY, Commands::queryRankedTrophies},
+    {TOTAL_MULTI_INGREDIENT_QUERY, Commands::queryMultipleIngredients},
+    {TOTAL_MULTI_POTION_QUERY, Commands::queryMultiplePotions},
+    {TOTAL_MULTI_TROPHY_QUERY, Commands::queryMultipleTrophies},
+    {NAME_SEARCH_INGREDIENT_QUERY, Commands::searchIngredientNames},
+    {NAME_SEARCH_POTION_QUERY, Commands::searchPotionNames},
+    {NAME_SEARCH_TROPHY_QUERY, Commands::searchTrophyNames},
+    {TOTAL_ALL_INGREDIENT_AT_QUERY, Commands::queryAllIngredientsAt},
+    {TOTAL_ALL_POTION_AT_QUERY, Commands::queryAllPotionsAt},
+    {TOTAL_ALL_TROPHY_AT_QUERY, Commands::queryAllTrophiesAt},
+    {TOTAL_SPECIFIC_INGREDIENT_AT_QUERY, Commands::querySpecificIngredientAt},
+    {TOTAL_SPECIFIC_POTION_AT_QUERY, Commands::querySpecificPotionAt},
+    {TOTAL_SPECIFIC_TROPHY_AT_QUERY, Commands::querySpecificTrophyAt},
+    {WHAT_IF_QUERY, Commands::queryWhatIf},
+    {BEGIN_COMMAND, Commands::beginTransaction},
+    {COMMIT_COMMAND, Commands::commitTransaction},
+    {ROLLBACK_COMMAND, Commands::rollbackTransaction}
 };
 
 
 /**
- * @brief Parses the input tokens and matches them against known syntax patterns.
+ * @brief Returns the word that a parser-only keyword stands for.
+ *
+ * These keywords are scanned as ordinary words, so that they stay valid names in
+ * every other sentence; they are only keywords where a syntax vector asks for them.
+ *
+ * @param type Token type of a syntax vector entry.
+ * @return const char* The word, or nullptr if @p type is not such a keyword.
+ */
+static const char* wordKeyword(TokenType type) {
+    switch (type) {
+        case TOKEN_A: return "a";
+        case TOKEN_STATS: return "Stats";
+        case TOKEN_MEMORY: return "Memory";
+        case TOKEN_HOW: return "How";
+        case TOKEN_DOES: return "does";
+        case TOKEN_PREPARE: return "prepare";
+        case TOKEN_BREWABLE: return "brewable";
+        case TOKEN_NEED: return "need";
+        case TOKEN_AT: return "at";
+        case TOKEN_IF: return "if";
+        case TOKEN_BEGIN: return "Begin";
+        case TOKEN_COMMIT: return "Commit";
+        case TOKEN_ROLLBACK: return "Rollback";
+        default: return nullptr;
+    }
+}
+
+/**
+ * @brief Matches the input tokens against known syntax patterns.
  * 
- * This function checks each possible grammar rule (from `actionToSyntaxMap`) against the input tokens.
- * If a match is found, the associated function (from `actionToFuncMap`) is called.
+ * This function checks each possible grammar rule (from `actionToSyntaxMap`) against the input tokens
+ * and reports which one matched, without executing it.
  * 
  * Special handling is included for recursive ingredient and trophy lists and context-sensitive keywords.
  * 
  * @param tokens Vector of tokens representing the user command.
- * @return true If a matching grammar rule is found and function is successfully invoked.
- * @return false If no valid syntax pattern matches the tokens.
+ * @return optional<ParserActionType> The matching grammar rule, or nullopt if no valid syntax pattern matches the tokens.
  */
-bool parseCommand(const vector<Token>& tokens) {
+optional<ParserActionType> matchCommand(Span<Token> tokens) {
     // Itereates through all possible sentence types
     for (const auto& pair : actionToSyntaxMap) {
         
-        vector<TokenType> currentSyntaxVector = pair.second;
+        const vector<TokenType>& currentSyntaxVector = pair.second;
         
         
         int i;
@@ -126,10 +204,28 @@ bool parseCommand(const vector<Token>& tokens) {
 
                 break;
             }
+
+            // TOKEN_WORD, either of the two directions of a ranked listing
+            else if (currentSyntaxVector[syntaxIdx] == TOKEN_RANKING) {
+                if (tokens[i].getType() == TOKEN_WORD && (tokens[i].getContent() == "Top" || tokens[i].getContent() == "Bottom")) {
+                    continue;
+                }
+
+                break;
+            }
+
+            // TOKEN_WORD, either of the two kinds of name search
+            else if (currentSyntaxVector[syntaxIdx] == TOKEN_NAME_SEARCH) {
+                if (tokens[i].getType() == TOKEN_WORD && (tokens[i].getContent() == "Complete" || tokens[i].getContent() == "Suggest")) {
+                    continue;
+                }
+
+                break;
+            }
             
-            // Checking a as a token, foregoing if continues
-            else if (currentSyntaxVector[syntaxIdx] == TOKEN_A) {
-                if (tokens[i].getType() == TOKEN_WORD && tokens[i].getContent() == "a") {
+            // Keywords that are scanned as words: "a", "Stats", "Memory", ...
+            else if (const char* keyword = wordKeyword(currentSyntaxVector[syntaxIdx])) {
+                if (tokens[i].getType() == TOKEN_WORD && tokens[i].getContent() == keyword) {
                     continue;
                 }
 
@@ -145,11 +241,12 @@ bool parseCommand(const vector<Token>& tokens) {
                 break;
             }
 
-            // RECURSIVE LISTS, they both are functionally equivalent since monster and ingredient are both TOKEN_WORD
+            // RECURSIVE LISTS, they are all functionally equivalent since monster, ingredient and potion are all TOKEN_WORD
             else if (currentSyntaxVector[syntaxIdx] == TOKEN_RECURSIVE_INGRED_LIST || 
-                        currentSyntaxVector[syntaxIdx] == TOKEN_RECURSIVE_TROPHY_LIST) {
+                        currentSyntaxVector[syntaxIdx] == TOKEN_RECURSIVE_TROPHY_LIST ||
+                        currentSyntaxVector[syntaxIdx] == TOKEN_RECURSIVE_POTION_LIST) {
 
-                vector<TokenType> ingredListSyntax = {TOKEN_QUANTITY, TOKEN_WORD};
+                static const TokenType ingredListSyntax[] = {TOKEN_QUANTITY, TOKEN_WORD};
                 
                 bool isCorrect = true;
 
@@ -178,6 +275,48 @@ bool parseCommand(const vector<Token>& tokens) {
 
             } 
 
+            // NAME LISTS, at least two names so that a single name stays the specific quantity query
+            else if (currentSyntaxVector[syntaxIdx] == TOKEN_RECURSIVE_NAME_LIST ||
+                        currentSyntaxVector[syntaxIdx] == TOKEN_RECURSIVE_POTION_NAME_LIST) {
+
+                bool multiWordNames = currentSyntaxVector[syntaxIdx] == TOKEN_RECURSIVE_POTION_NAME_LIST;
+                int names = 0;
+
+                i--;
+
+                do {
+                    i++; // If a comma appears, this increments the index to reach the next name
+                    if (i < tokens.size() && (tokens[i].getType() == TOKEN_WORD ||
+                                              (multiWordNames && tokens[i].getType() == TOKEN_MULTI_WORD))) {
+                        i++;
+                        names++;
+                    } else {
+                        names = 0;
+                        break;
+                    }
+                } while (i < tokens.size() && tokens[i].getType() == TOKEN_COMMA);
+
+                if (names >= 2) {
+                    i--;
+                    continue;
+                }
+
+                break;
+            }
+
+            // NESTED ACTION, every token up to the final question mark must form a state-changing sentence
+            else if (currentSyntaxVector[syntaxIdx] == TOKEN_NESTED_ACTION) {
+                if (i + 1 < tokens.size() && tokens[tokens.size() - 1].getType() == TOKEN_QMARK) {
+                    optional<ParserActionType> nested = matchCommand(Span<Token>(&tokens[i], tokens.size() - 1 - i));
+                    if (nested && isStateChangingAction(*nested)) {
+                        i = tokens.size() - 2;
+                        continue;
+                    }
+                }
+
+                break;
+            }
+
             // REGULAR ELEMENT COMPARISON after handling exceptional cases
             else if (currentSyntaxVector[syntaxIdx] == tokens[i].getType()) {
                 continue;
@@ -190,15 +329,8 @@ bool parseCommand(const vector<Token>& tokens) {
         // Occurs when both end simultaneously, which although they are not numerically have equal length, they are semantically at equal length. Hence,
         // the syntaxes match. Call the relevant function and return true.
         if (i == tokens.size() && syntaxIdx == currentSyntaxVector.size()) {
-            ParserActionType whichActionType = pair.first;
-
-            InventoryFunc inventoryFuncPtrToCall = actionToFuncMap.at(whichActionType);
-
-            // Call to the related inventory function is done at this line
-            inventoryFuncPtrToCall(tokens);
-            
-            // Syntax is matched and related inventory functin has been called. Now indicate that the operation is succesful.
-            return true;
+            // Syntax is matched. Report which sentence type it is so that the caller can dispatch it.
+            return pair.first;
 
         } else {
 
@@ -217,8 +349,71 @@ bool parseCommand(const vector<Token>& tokens) {
     }
 
     // There is no syntax match, invalid grammar. INVALID case
-    return false;
+    return nullopt;
+
+}
+
+
+/**
+ * @brief Calls the inventory function associated with a matched action.
+ * 
+ * @param action Action type returned by matchCommand.
+ * @param tokens Vector of tokens representing the user command.
+ */
+void dispatchCommand(ParserActionType action, const TokenList& tokens) {
+    InventoryFunc inventoryFuncPtrToCall = actionToFuncMap.at(action);
+
+    Stats::Span span(Stats::STAGE_EXECUTE, action);
+
+    // Call to the related inventory function is done at this line
+    inventoryFuncPtrToCall(tokens);
+}
+
+
+/**
+ * @brief Parses the input tokens and executes the matching command.
+ * 
+ * If a match is found by matchCommand, the associated function (from `actionToFuncMap`) is called.
+ * 
+ * @param tokens Vector of tokens representing the user command.
+ * @return true If a matching grammar rule is found and function is successfully invoked.
+ * @return false If no valid syntax pattern matches the tokens.
+ */
+bool parseCommand(const TokenList& tokens) {
+    optional<ParserActionType> action = matchCommand(tokens);
 
+    if (!action) {
+        return false;
+    }
+
+    dispatchCommand(*action, tokens);
+
+    // Syntax is matched and related inventory functin has been called. Now indicate that the operation is succesful.
+    return true;
+}
+
+
+/**
+ * @brief Tells whether executing an action can modify the inventory or the bestiary.
+ * 
+ * Queries and the exit command only read the state, so they never have to be journaled or replayed.
+ * 
+ * @param action The action type to classify.
+ * @return true If the action is a loot, trade, brew, learn or encounter action.
+ */
+bool isStateChangingAction(ParserActionType action) {
+    switch (action) {
+        case LOOT_ACTION:
+        case TRADE_ACTION:
+        case BREW_ACTION:
+        case KNOWLEDGE_EFFECTIVENESS_SIGN:
+        case KNOWLEDGE_EFFECTIVENESS_POTION:
+        case KNOWLEDGE_POTION_FORMULA:
+        case ENCOUNTER:
+            return true;
+        default:
+            return false;
+    }
 }
 
 
@@ -229,6 +424,60 @@ bool parseCommand(const vector<Token>& tokens) {
  * 
  * @param tokens Vector of tokens passed (unused in this function).
  */
-void exitProgram(const vector<Token>& tokens) {
+void exitProgram(const TokenList& tokens) {
     exit(0);
-}
\ No newline at end of file
+}
+
+
+/**
+ * @brief Returns the enumerator name of an action for statistics and benchmark reports.
+ * 
+ * @param action The action type.
+ * @return const char* Name of the enumerator, or "UNKNOWN_ACTION".
+ */
+const char* actionTypeName(ParserActionType action) {
+    switch (action) {
+        case LOOT_ACTION: return "LOOT_ACTION";
+        case TRADE_ACTION: return "TRADE_ACTION";
+        case BREW_ACTION: return "BREW_ACTION";
+        case KNOWLEDGE_EFFECTIVENESS_SIGN: return "KNOWLEDGE_EFFECTIVENESS_SIGN";
+        case KNOWLEDGE_EFFECTIVENESS_POTION: return "KNOWLEDGE_EFFECTIVENESS_POTION";
+        case KNOWLEDGE_POTION_FORMULA: return "KNOWLEDGE_POTION_FORMULA";
+        case ENCOUNTER: return "ENCOUNTER";
+        case TOTAL_ALL_INGREDIENT_QUERY: return "TOTAL_ALL_INGREDIENT_QUERY";
+        case TOTAL_ALL_POTION_QUERY: return "TOTAL_ALL_POTION_QUERY";
+        case TOTAL_ALL_TROPHY_QUERY: return "TOTAL_ALL_TROPHY_QUERY";
+        case TOTAL_SPECIFIC_INGREDIENT_QUERY: return "TOTAL_SPECIFIC_INGREDIENT_QUERY";
+        case TOTAL_SPECIFIC_POTION_QUERY: return "TOTAL_SPECIFIC_POTION_QUERY";
+        case TOTAL_SPECIFIC_TROPHY_QUERY: return "TOTAL_SPECIFIC_TROPHY_QUERY";
+        case BESTIARY_QUERY: return "BESTIARY_QUERY";
+        case ALCHEMY_QUERY: return "ALCHEMY_QUERY";
+        case EXIT_COMMAND: return "EXIT_COMMAND";
+        case STATS_QUERY: return "STATS_QUERY";
+        case MEMORY_QUERY: return "MEMORY_QUERY";
+        case PLAN_QUERY: return "PLAN_QUERY";
+        case BREW_MIX_QUERY: return "BREW_MIX_QUERY";
+        case SHOPPING_LIST_QUERY: return "SHOPPING_LIST_QUERY";
+        case RANKED_INGREDIENT_QUERY: return "RANKED_INGREDIENT_QUERY";
+        case RANKED_POTION_QUERY: return "RANKED_POTION_QUERY";
+        case RANKED_TROPHY_QUERY: return "RANKED_TROPHY_QUERY";
+        case TOTAL_MULTI_INGREDIENT_QUERY: return "TOTAL_MULTI_INGREDIENT_QUERY";
+        case TOTAL_MULTI_POTION_QUERY: return "TOTAL_MULTI_POTION_QUERY";
+        case TOTAL_MULTI_TROPHY_QUERY: return "TOTAL_MULTI_TROPHY_QUERY";
+        case NAME_SEARCH_INGREDIENT_QUERY: return "NAME_SEARCH_INGREDIENT_QUERY";
+        case NAME_SEARCH_POTION_QUERY: return "NAME_SEARCH_POTION_QUERY";
+        case NAME_SEARCH_TROPHY_QUERY: return "NAME_SEARCH_TROPHY_QUERY";
+        case TOTAL_ALL_INGREDIENT_AT_QUERY: return "TOTAL_ALL_INGREDIENT_AT_QUERY";
+        case TOTAL_ALL_POTION_AT_QUERY: return "TOTAL_ALL_POTION_AT_QUERY";
+        case TOTAL_ALL_TROPHY_AT_QUERY: return "TOTAL_ALL_TROPHY_AT_QUERY";
+        case TOTAL_SPECIFIC_INGREDIENT_AT_QUERY: return "TOTAL_SPECIFIC_INGREDIENT_AT_QUERY";
+        case TOTAL_SPECIFIC_POTION_AT_QUERY: return "TOTAL_SPECIFIC_POTION_AT_QUERY";
+        case TOTAL_SPECIFIC_TROPHY_AT_QUERY: return "TOTAL_SPECIFIC_TROPHY_AT_QUERY";
+        case WHAT_IF_QUERY: return "WHAT_IF_QUERY";
+        case BEGIN_COMMAND: return "BEGIN_COMMAND";
+        case COMMIT_COMMAND: return "COMMIT_COMMAND";
+        case ROLLBACK_COMMAND: return "ROLLBACK_COMMAND";
+    }
+
+    return "UNKNOWN_ACTION";
+}
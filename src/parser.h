@@ -7,7 +7,10 @@
 #define PARSER_H
 
 #include <vector>
+#include <optional>
 #include "tokenizer.h"  ///< Required for TokenType definitions
+#include "token.h"      ///< Required for TokenList
+#include "span.h"       ///< Required for the token views matched by matchCommand
 
 
 
@@ -35,9 +38,68 @@ typedef enum {
     TOTAL_SPECIFIC_TROPHY_QUERY,                    // "Total trophy <trophy_name>?"
     BESTIARY_QUERY = 13,                            // "What is effective against <monster>?"
     ALCHEMY_QUERY,                                  // "What is in <potion_name> potion?"  
-    EXIT_COMMAND = 15                               // "Exit"
+    EXIT_COMMAND = 15,                              // "Exit"
+    STATS_QUERY = 16,                               // "Stats?"
+    MEMORY_QUERY = 17,                              // "Memory?"
+    PLAN_QUERY = 18,                                // "How does Geralt prepare for <monster>?"
+    BREW_MIX_QUERY = 19,                            // "Total brewable potion?"
+    SHOPPING_LIST_QUERY = 20,                       // "What does Geralt need for <quantity> <potion_name> ...?"
+    RANKED_INGREDIENT_QUERY,                        // "Top <count> ingredient?" or "Bottom <count> ingredient?"
+    RANKED_POTION_QUERY,                            // "Top <count> potion?" or "Bottom <count> potion?"
+    RANKED_TROPHY_QUERY = 23,                       // "Top <count> trophy?" or "Bottom <count> trophy?"
+    TOTAL_MULTI_INGREDIENT_QUERY,                   // "Total ingredient <ingredient_name>, <ingredient_name> ...?"
+    TOTAL_MULTI_POTION_QUERY,                       // "Total potion <potion_name>, <potion_name> ...?"
+    TOTAL_MULTI_TROPHY_QUERY = 26,                  // "Total trophy <trophy_name>, <trophy_name> ...?"
+    NAME_SEARCH_INGREDIENT_QUERY,                   // "Complete ingredient <prefix>?" or "Suggest ingredient <name>?"
+    NAME_SEARCH_POTION_QUERY,                       // "Complete potion <prefix>?" or "Suggest potion <name>?"
+    NAME_SEARCH_TROPHY_QUERY = 29,                  // "Complete trophy <prefix>?" or "Suggest trophy <name>?"
+    TOTAL_ALL_INGREDIENT_AT_QUERY,                  // "Total ingredient? at <line>"
+    TOTAL_ALL_POTION_AT_QUERY,                      // "Total potion? at <line>"
+    TOTAL_ALL_TROPHY_AT_QUERY,                      // "Total trophy? at <line>"
+    TOTAL_SPECIFIC_INGREDIENT_AT_QUERY,             // "Total ingredient <ingredient_name>? at <line>"
+    TOTAL_SPECIFIC_POTION_AT_QUERY,                 // "Total potion <potion_name>? at <line>"
+    TOTAL_SPECIFIC_TROPHY_AT_QUERY,                 // "Total trophy <trophy_name>? at <line>"
+    WHAT_IF_QUERY,                                  // "What if <action>?"
+    BEGIN_COMMAND,                                  // "Begin"
+    COMMIT_COMMAND,                                 // "Commit"
+    ROLLBACK_COMMAND                                // "Rollback"
 } ParserActionType;
 
+/// Number of ParserActionType values; update it together with the enumeration.
+constexpr int PARSER_ACTION_COUNT = ROLLBACK_COMMAND + 1;
+
+/**
+ * @brief Finds the grammar rule that a refined token sequence matches.
+ *
+ * @param tokens Refined tokens of one input line.
+ * @return std::optional<ParserActionType> The matched action, or nullopt for invalid grammar.
+ */
+std::optional<ParserActionType> matchCommand(Span<Token> tokens);
+
+/**
+ * @brief Calls the inventory function that implements an already matched action.
+ *
+ * @param action Action returned by matchCommand for these tokens.
+ * @param tokens Refined tokens of the input line.
+ */
+void dispatchCommand(ParserActionType action, const TokenList& tokens);
+
+/**
+ * @brief Returns the enumerator name of an action, e.g. "LOOT_ACTION", for reports.
+ *
+ * @param action The action type.
+ * @return const char* Static name string.
+ */
+const char* actionTypeName(ParserActionType action);
+
+/**
+ * @brief Tells whether an action can change Geralt's state, as opposed to only reading it.
+ *
+ * @param action The action to classify.
+ * @return true For loot, trade, brew, learn and encounter actions.
+ */
+bool isStateChangingAction(ParserActionType action);
+
 
 // ------------------------------------------------------------------------------------------------
 // Syntax Vectors
@@ -46,85 +108,197 @@ typedef enum {
 /**
  * @brief Syntax pattern for "Geralt loots" followed by ingredient list.
  */
-std::vector<TokenType> lootActionVec = {TOKEN_GERALT, TOKEN_LOOTS, TOKEN_RECURSIVE_INGRED_LIST};
+inline std::vector<TokenType> lootActionVec = {TOKEN_GERALT, TOKEN_LOOTS, TOKEN_RECURSIVE_INGRED_LIST};
 
 /**
  * @brief Syntax pattern for "Geralt trades [trophies] for [ingredients]".
  */
-std::vector<TokenType> tradeActionVec = {TOKEN_GERALT, TOKEN_TRADES, TOKEN_RECURSIVE_TROPHY_LIST, TOKEN_TROPHY, TOKEN_FOR, TOKEN_RECURSIVE_INGRED_LIST};
+inline std::vector<TokenType> tradeActionVec = {TOKEN_GERALT, TOKEN_TRADES, TOKEN_RECURSIVE_TROPHY_LIST, TOKEN_TROPHY, TOKEN_FOR, TOKEN_RECURSIVE_INGRED_LIST};
 
 /**
  * @brief Syntax pattern for "Geralt brews [potion]".
  */
-std::vector<TokenType> brewActionVec = {TOKEN_GERALT, TOKEN_BREWS, TOKEN_POTION_NAME};
+inline std::vector<TokenType> brewActionVec = {TOKEN_GERALT, TOKEN_BREWS, TOKEN_POTION_NAME};
 
 /**
  * @brief Syntax for learning effectiveness of a sign.
  */
-std::vector<TokenType> knowEffecSignVec = {TOKEN_GERALT, TOKEN_LEARNS, TOKEN_WORD, TOKEN_SIGN_KEYWORD,
+inline std::vector<TokenType> knowEffecSignVec = {TOKEN_GERALT, TOKEN_LEARNS, TOKEN_WORD, TOKEN_SIGN_KEYWORD,
                                                     TOKEN_IS, TOKEN_EFFECTIVE, TOKEN_AGAINST, TOKEN_WORD};
 
 
 /**
  * @brief Syntax for learning effectiveness of a potion.
  */                                                    
-std::vector<TokenType> knowEffecPotVec = {TOKEN_GERALT, TOKEN_LEARNS, TOKEN_POTION_NAME, TOKEN_POTION_KEYWORD, TOKEN_IS,
+inline std::vector<TokenType> knowEffecPotVec = {TOKEN_GERALT, TOKEN_LEARNS, TOKEN_POTION_NAME, TOKEN_POTION_KEYWORD, TOKEN_IS,
                                                     TOKEN_EFFECTIVE, TOKEN_AGAINST, TOKEN_WORD};
                                                     
 /**
  * @brief Syntax for learning formula of a potion.
  */                                                    
-std::vector<TokenType> knowPotFormulaVec = {TOKEN_GERALT, TOKEN_LEARNS, TOKEN_POTION_NAME, TOKEN_POTION_KEYWORD,
+inline std::vector<TokenType> knowPotFormulaVec = {TOKEN_GERALT, TOKEN_LEARNS, TOKEN_POTION_NAME, TOKEN_POTION_KEYWORD,
                                                     TOKEN_CONSISTS, TOKEN_OF, TOKEN_RECURSIVE_INGRED_LIST};
 
 /**
  * @brief Syntax for "Geralt encounters a [monster]".
  */
-std::vector<TokenType> encounterVec = {TOKEN_GERALT, TOKEN_ENCOUNTERS, TOKEN_A, TOKEN_WORD};
+inline std::vector<TokenType> encounterVec = {TOKEN_GERALT, TOKEN_ENCOUNTERS, TOKEN_A, TOKEN_WORD};
 
 /**
  * @brief Syntax for querying total number of all ingredients.
  */
-std::vector<TokenType> totalAllIngredQueryVec = {TOKEN_TOTAL, TOKEN_INGREDIENT, TOKEN_QMARK};
+inline std::vector<TokenType> totalAllIngredQueryVec = {TOKEN_TOTAL, TOKEN_INGREDIENT, TOKEN_QMARK};
 
 /**
  * @brief Syntax for querying total number of all potions.
  */
-std::vector<TokenType> totalAllPotQueryVec = {TOKEN_TOTAL, TOKEN_POTION_KEYWORD, TOKEN_QMARK};
+inline std::vector<TokenType> totalAllPotQueryVec = {TOKEN_TOTAL, TOKEN_POTION_KEYWORD, TOKEN_QMARK};
 
 /**
  * @brief Syntax for querying total number of all trophies.
  */
-std::vector<TokenType> totalAllTrophyQueryVec = {TOKEN_TOTAL, TOKEN_TROPHY, TOKEN_QMARK};
+inline std::vector<TokenType> totalAllTrophyQueryVec = {TOKEN_TOTAL, TOKEN_TROPHY, TOKEN_QMARK};
 
 /**
  * @brief Syntax for querying total of a specific ingredient.
  */
-std::vector<TokenType> totalSpecIngredQueryVec = {TOKEN_TOTAL, TOKEN_INGREDIENT, TOKEN_WORD, TOKEN_QMARK};
+inline std::vector<TokenType> totalSpecIngredQueryVec = {TOKEN_TOTAL, TOKEN_INGREDIENT, TOKEN_WORD, TOKEN_QMARK};
 
 /**
  * @brief Syntax for querying total of a specific potion.
  */
-std::vector<TokenType> totalSpecPotQueryVec = {TOKEN_TOTAL, TOKEN_POTION_KEYWORD, TOKEN_POTION_NAME, TOKEN_QMARK};
+inline std::vector<TokenType> totalSpecPotQueryVec = {TOKEN_TOTAL, TOKEN_POTION_KEYWORD, TOKEN_POTION_NAME, TOKEN_QMARK};
 
 /**
  * @brief Syntax for querying total of a specific trophy.
  */
-std::vector<TokenType> totalSpecTrophyQueryVec = {TOKEN_TOTAL, TOKEN_TROPHY, TOKEN_WORD, TOKEN_QMARK};
+inline std::vector<TokenType> totalSpecTrophyQueryVec = {TOKEN_TOTAL, TOKEN_TROPHY, TOKEN_WORD, TOKEN_QMARK};
 
 /**
  * @brief Syntax for bestiary query like "What is effective against [monster]?"
  */
-std::vector<TokenType> bestiaryQueryVec = {TOKEN_WHAT, TOKEN_IS, TOKEN_EFFECTIVE, TOKEN_AGAINST, TOKEN_WORD, TOKEN_QMARK};
+inline std::vector<TokenType> bestiaryQueryVec = {TOKEN_WHAT, TOKEN_IS, TOKEN_EFFECTIVE, TOKEN_AGAINST, TOKEN_WORD, TOKEN_QMARK};
 
 /**
  * @brief Syntax for alchemy query like "What is in [potion]?"
  */
-std::vector<TokenType> alchQueryVec = {TOKEN_WHAT, TOKEN_IS, TOKEN_IN, TOKEN_POTION_NAME, TOKEN_QMARK};
+inline std::vector<TokenType> alchQueryVec = {TOKEN_WHAT, TOKEN_IS, TOKEN_IN, TOKEN_POTION_NAME, TOKEN_QMARK};
 
 /**
  * @brief Syntax for exit command.
  */
-std::vector<TokenType> exitComVec = {TOKEN_EXIT};
+inline std::vector<TokenType> exitComVec = {TOKEN_EXIT};
+
+/**
+ * @brief Syntax for the latency statistics query "Stats?".
+ */
+inline std::vector<TokenType> statsQueryVec = {TOKEN_STATS, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the memory footprint query "Memory?".
+ */
+inline std::vector<TokenType> memoryQueryVec = {TOKEN_MEMORY, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the planner query "How does Geralt prepare for [monster]?".
+ */
+inline std::vector<TokenType> planQueryVec = {TOKEN_HOW, TOKEN_DOES, TOKEN_GERALT, TOKEN_PREPARE, TOKEN_FOR, TOKEN_WORD, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the brew optimizer query "Total brewable potion?".
+ */
+inline std::vector<TokenType> brewMixQueryVec = {TOKEN_TOTAL, TOKEN_BREWABLE, TOKEN_POTION_KEYWORD, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the shopping list query "What does Geralt need for [potion_list]?".
+ */
+inline std::vector<TokenType> shoppingListQueryVec = {TOKEN_WHAT, TOKEN_DOES, TOKEN_GERALT, TOKEN_NEED, TOKEN_FOR, TOKEN_RECURSIVE_POTION_LIST, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the ranked listing queries "Top [count] ingredient?" and "Bottom [count] ingredient?".
+ */
+inline std::vector<TokenType> rankedIngredQueryVec = {TOKEN_RANKING, TOKEN_QUANTITY, TOKEN_INGREDIENT, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the ranked listing queries "Top [count] potion?" and "Bottom [count] potion?".
+ */
+inline std::vector<TokenType> rankedPotQueryVec = {TOKEN_RANKING, TOKEN_QUANTITY, TOKEN_POTION_KEYWORD, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the ranked listing queries "Top [count] trophy?" and "Bottom [count] trophy?".
+ */
+inline std::vector<TokenType> rankedTrophyQueryVec = {TOKEN_RANKING, TOKEN_QUANTITY, TOKEN_TROPHY, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the multi-get query "Total ingredient [ingredient_name], [ingredient_name] ...?".
+ */
+inline std::vector<TokenType> totalMultiIngredQueryVec = {TOKEN_TOTAL, TOKEN_INGREDIENT, TOKEN_RECURSIVE_NAME_LIST, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the multi-get query "Total potion [potion_name], [potion_name] ...?".
+ */
+inline std::vector<TokenType> totalMultiPotQueryVec = {TOKEN_TOTAL, TOKEN_POTION_KEYWORD, TOKEN_RECURSIVE_POTION_NAME_LIST, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the multi-get query "Total trophy [trophy_name], [trophy_name] ...?".
+ */
+inline std::vector<TokenType> totalMultiTrophyQueryVec = {TOKEN_TOTAL, TOKEN_TROPHY, TOKEN_RECURSIVE_NAME_LIST, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the name searches "Complete ingredient [prefix]?" and "Suggest ingredient [ingredient_name]?".
+ */
+inline std::vector<TokenType> nameSearchIngredQueryVec = {TOKEN_NAME_SEARCH, TOKEN_INGREDIENT, TOKEN_WORD, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the name searches "Complete potion [prefix]?" and "Suggest potion [potion_name]?".
+ */
+inline std::vector<TokenType> nameSearchPotQueryVec = {TOKEN_NAME_SEARCH, TOKEN_POTION_KEYWORD, TOKEN_POTION_NAME, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the name searches "Complete trophy [prefix]?" and "Suggest trophy [trophy_name]?".
+ */
+inline std::vector<TokenType> nameSearchTrophyQueryVec = {TOKEN_NAME_SEARCH, TOKEN_TROPHY, TOKEN_WORD, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the time-travel query "Total ingredient? at [line]".
+ */
+inline std::vector<TokenType> totalAllIngredAtQueryVec = {TOKEN_TOTAL, TOKEN_INGREDIENT, TOKEN_QMARK, TOKEN_AT, TOKEN_QUANTITY};
+
+/**
+ * @brief Syntax for the time-travel query "Total potion? at [line]".
+ */
+inline std::vector<TokenType> totalAllPotAtQueryVec = {TOKEN_TOTAL, TOKEN_POTION_KEYWORD, TOKEN_QMARK, TOKEN_AT, TOKEN_QUANTITY};
+
+/**
+ * @brief Syntax for the time-travel query "Total trophy? at [line]".
+ */
+inline std::vector<TokenType> totalAllTrophyAtQueryVec = {TOKEN_TOTAL, TOKEN_TROPHY, TOKEN_QMARK, TOKEN_AT, TOKEN_QUANTITY};
+
+/**
+ * @brief Syntax for the time-travel query "Total ingredient [ingredient_name]? at [line]".
+ */
+inline std::vector<TokenType> totalSpecificIngredAtQueryVec = {TOKEN_TOTAL, TOKEN_INGREDIENT, TOKEN_WORD, TOKEN_QMARK, TOKEN_AT, TOKEN_QUANTITY};
+
+/**
+ * @brief Syntax for the time-travel query "Total potion [potion_name]? at [line]".
+ */
+inline std::vector<TokenType> totalSpecificPotAtQueryVec = {TOKEN_TOTAL, TOKEN_POTION_KEYWORD, TOKEN_POTION_NAME, TOKEN_QMARK, TOKEN_AT, TOKEN_QUANTITY};
+
+/**
+ * @brief Syntax for the time-travel query "Total trophy [trophy_name]? at [line]".
+ */
+inline std::vector<TokenType> totalSpecificTrophyAtQueryVec = {TOKEN_TOTAL, TOKEN_TROPHY, TOKEN_WORD, TOKEN_QMARK, TOKEN_AT, TOKEN_QUANTITY};
+
+/**
+ * @brief Syntax for the dry run "What if [action]?", where the action is any state-changing sentence.
+ */
+inline std::vector<TokenType> whatIfQueryVec = {TOKEN_WHAT, TOKEN_IF, TOKEN_NESTED_ACTION, TOKEN_QMARK};
+
+/**
+ * @brief Syntax for the transaction commands "Begin", "Commit" and "Rollback".
+ */
+inline std::vector<TokenType> beginComVec = {TOKEN_BEGIN};
+inline std::vector<TokenType> commitComVec = {TOKEN_COMMIT};
+inline std::vector<TokenType> rollbackComVec = {TOKEN_ROLLBACK};
 
 #endif
\ No newline at end of file
@@ -0,0 +1,208 @@
+/**
+ * @file planner.cpp
+ * @brief Implementation of the encounter preparation planner.
+ */
+
+#include <algorithm>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "planner.h"
+#include "formulamatrix.h"
+#include "arena.h"
+
+using namespace std;
+
+map<string, Planner::Entry, less<>> Planner::plans;
+
+namespace {
+
+/**
+ * @struct Candidate
+ * @brief An effective potion whose formula is checked one ingredient at a time.
+ */
+struct Candidate {
+    long long shortfall;    ///< Missing ingredient units among the checked ones
+    uint32_t next;          ///< Next entry of the formula row to check
+    uint32_t end;           ///< End of the formula row
+    string_view name;       ///< Potion name, from the key of the potions map
+};
+
+/// Heap order that puts the lowest shortfall, then the alphabetically first potion, on top.
+bool worseCandidate(const Candidate& a, const Candidate& b) {
+    if (a.shortfall != b.shortfall) {
+        return a.shortfall > b.shortfall;
+    }
+    return a.name > b.name;
+}
+
+bool byName(const ItemCount& a, const ItemCount& b) {
+    return a.name < b.name;
+}
+
+} // namespace
+
+Planner::Stamp Planner::currentStamp() {
+    return Stamp{Geralt::getIngredientGenerations().contents, Geralt::getPotionGenerations().contents,
+                 Geralt::getMonsterGenerations().contents, Geralt::getTrophyGenerations().contents};
+}
+
+const Plan& Planner::prepare(string_view monsterName) {
+    Stamp stamp = currentStamp();
+
+    auto memo = plans.find(monsterName);
+    if (memo != plans.end() && memo->second.stamp == stamp) {
+        return memo->second.plan;
+    }
+
+    if (memo == plans.end()) {
+        if (plans.size() >= MAX_PLANS) {
+            plans.clear();
+        }
+        memo = plans.emplace(string(monsterName), Entry()).first;
+    }
+
+    memo->second.stamp = stamp;
+    search(monsterName, memo->second);
+    return memo->second.plan;
+}
+
+void Planner::clear() {
+    plans.clear();
+}
+
+void Planner::search(string_view monsterName, Entry& entry) {
+    Plan& plan = entry.plan;
+    plan = Plan();
+
+    auto& monsters = Geralt::getMonsters();
+    auto monster = monsters.find(monsterName);
+    if (monster == monsters.end()) {
+        return;
+    }
+
+    // A known sign always works, so nothing has to be prepared
+    const vector<Name>& signs = monster->second->getEffectiveSigns();
+    if (!signs.empty()) {
+        plan.status = PLAN_READY;
+        plan.means = *min_element(signs.begin(), signs.end());
+        plan.isSign = true;
+        return;
+    }
+
+    // Entities and their names stay in place until a potion is added or removed, or the state is reset
+    uint64_t monsterGeneration = Geralt::getMonsterGenerations().contents;
+    uint64_t potionMembership = Geralt::getPotionGenerations().membership;
+    if (entry.potionsMonsters != monsterGeneration || entry.potionsMembership != potionMembership) {
+        auto& potions = Geralt::getPotions();
+        entry.potions.clear();
+
+        for (const Name& potionName : monster->second->getEffectivePotions()) {
+            auto potion = potions.find(potionName);
+            if (potion != potions.end()) {
+                entry.potions.emplace_back(potion->first.view(), potion->second.get());
+            }
+        }
+        entry.potionsMonsters = monsterGeneration;
+        entry.potionsMembership = potionMembership;
+    }
+
+    // Formulas are read as rows of ingredient columns, so checking an entry loads the stock
+    // through the column's Ingredient instead of looking the ingredient up by name
+    const FormulaMatrix& matrix = FormulaMatrix::current();
+    pmr::vector<Candidate> candidates(CommandArena::resource());
+    candidates.reserve(entry.potions.size());
+
+    for (const auto& [potionName, potion] : entry.potions) {
+        // An effective potion in stock is ready as it is; the alphabetically first one is named
+        if (potion->getQuantity() > 0) {
+            if (plan.status != PLAN_READY || potionName < plan.means) {
+                plan.status = PLAN_READY;
+                plan.means = potionName;
+            }
+            continue;
+        }
+
+        uint32_t row = matrix.row(potionName);
+        if (row != FormulaMatrix::NO_ROW) {
+            candidates.push_back(Candidate{0, matrix.rowStart[row], matrix.rowStart[row + 1], potionName});
+        }
+    }
+
+    if (plan.status == PLAN_READY) {
+        return;
+    }
+
+    // Best-first search: the shortfall of a partly checked formula is a lower bound of its cost
+    make_heap(candidates.begin(), candidates.end(), worseCandidate);
+    const Candidate* best = nullptr;
+
+    while (!candidates.empty()) {
+        pop_heap(candidates.begin(), candidates.end(), worseCandidate);
+        Candidate& candidate = candidates.back();
+
+        if (candidate.next == candidate.end) {
+            best = &candidate;
+            break;
+        }
+
+        uint32_t k = candidate.next++;
+        candidate.shortfall += max(0LL, matrix.amount[k] - matrix.stock(matrix.column[k]));
+        push_heap(candidates.begin(), candidates.end(), worseCandidate);
+    }
+
+    if (best == nullptr) {
+        plan.status = PLAN_IMPOSSIBLE;
+        return;
+    }
+
+    if (best->shortfall == 0) {
+        plan.status = PLAN_BREW;
+        plan.means = best->name;
+        return;
+    }
+
+    // Every trophy pays for one missing ingredient; if the cheapest potion is out of reach, all of them are
+    pmr::vector<ItemCount> trophyStock(CommandArena::resource());
+    Geralt::trophyStock(trophyStock);
+
+    long long budget = 0;
+    for (const ItemCount& trophy : trophyStock) {
+        budget += trophy.quantity;
+    }
+
+    if (best->shortfall > budget) {
+        plan.status = PLAN_IMPOSSIBLE;
+        return;
+    }
+
+    plan.status = PLAN_TRADE_AND_BREW;
+    plan.means = best->name;
+
+    uint32_t row = matrix.row(best->name);
+    for (uint32_t k = matrix.rowStart[row]; k < matrix.rowStart[row + 1]; k++) {
+        long long missing = matrix.amount[k] - matrix.stock(matrix.column[k]);
+        if (missing > 0) {
+            plan.ingredients.push_back(ItemCount{matrix.ingredientNames[matrix.column[k]], static_cast<int>(missing)});
+        }
+    }
+    sort(plan.ingredients.begin(), plan.ingredients.end(), byName);
+
+    // Spend the largest trophy stocks first so that the trade names few of them
+    stable_sort(trophyStock.begin(), trophyStock.end(), [](const ItemCount& a, const ItemCount& b) {
+        return a.quantity > b.quantity;
+    });
+
+    long long remaining = best->shortfall;
+    for (const ItemCount& trophy : trophyStock) {
+        if (remaining == 0) {
+            break;
+        }
+        int spent = static_cast<int>(min<long long>(remaining, trophy.quantity));
+        plan.trophies.push_back(ItemCount{trophy.name, spent});
+        remaining -= spent;
+    }
+    sort(plan.trophies.begin(), plan.trophies.end(), byName);
+}
@@ -0,0 +1,115 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+/**
+ * @file planner.h
+ * @brief Declares the planner that finds the cheapest way to get ready for a monster.
+ *
+ * Geralt is ready for a monster when he knows a sign that is effective against it or
+ * carries one of its effective potions. Otherwise an effective potion has to be brewed,
+ * and the ingredients its formula still lacks have to be bought with trophies first.
+ * The specification does not fix an exchange rate, so the planner assumes that a trade
+ * gives one ingredient for every trophy; the cost of a plan is the number of trophies
+ * it spends.
+ *
+ * Candidates are rows of the FormulaMatrix, whose ingredient columns point at their
+ * Ingredient, so the search reads the stock by column ID and never looks an ingredient
+ * up by name. They are explored best first: each one is ordered by the shortfall of the
+ * formula ingredients checked so far, which never exceeds its final cost. The first
+ * candidate whose formula has been checked completely is therefore the cheapest one,
+ * usually after looking at only a part of the other formulas, and the trophies only
+ * have to be counted when that cheapest plan needs a trade.
+ *
+ * Plans are memoized per monster until one of the collections they were computed from
+ * changes. The effective potions of a monster are resolved to their entities once and
+ * kept until the bestiary or the set of known potions changes, so planning again after
+ * a loot, a trade or a brew does not look every potion up by name.
+ */
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "geralt.h"
+
+/**
+ * @brief Kind of plan found for a monster.
+ */
+typedef enum {
+    PLAN_READY = 0,         // An effective sign is known or an effective potion is in stock
+    PLAN_BREW,              // Brewing an effective potion is enough
+    PLAN_TRADE_AND_BREW,    // Missing ingredients have to be bought with trophies before brewing
+    PLAN_IMPOSSIBLE,        // No effective potion can be brewed, even by trading every trophy
+    PLAN_UNKNOWN_MONSTER    // The monster is not in the bestiary
+} PlanStatus;
+
+/**
+ * @struct Plan
+ * @brief Steps that get Geralt ready for a monster.
+ *
+ * Names point into Geralt's state, like the results of the typed queries.
+ */
+struct Plan {
+    PlanStatus status = PLAN_UNKNOWN_MONSTER;
+    std::string_view means;             ///< Sign or potion that defeats the monster; empty without a plan
+    bool isSign = false;                ///< true if the monster is defeated with the sign in means
+    std::vector<ItemCount> trophies;    ///< Trophies to trade away, in alphabetical order
+    std::vector<ItemCount> ingredients; ///< Ingredients to ask for in return, in alphabetical order
+};
+
+/**
+ * @class Planner
+ * @brief Static planner over Geralt's current state.
+ */
+class Planner {
+public:
+    /// Maximum number of memoized plans; the memo is dropped when it would grow beyond this.
+    static constexpr size_t MAX_PLANS = 4096;
+
+    /**
+     * @brief Finds the cheapest plan that gets Geralt ready for a monster.
+     *
+     * Ties between potions of the same cost are broken alphabetically. Trophies are
+     * taken from the largest stocks first, so that a trade names as few of them as possible.
+     *
+     * @param monsterName Monster to prepare for.
+     * @return const Plan& The plan; valid until the next call to prepare().
+     */
+    static const Plan& prepare(std::string_view monsterName);
+
+    /// Forgets every memoized plan.
+    static void clear();
+
+private:
+    /// Generations of the collections a plan was computed from.
+    struct Stamp {
+        uint64_t ingredients;
+        uint64_t potions;
+        uint64_t monsters;
+        uint64_t trophies;
+
+        bool operator==(const Stamp& other) const {
+            return ingredients == other.ingredients && potions == other.potions &&
+                   monsters == other.monsters && trophies == other.trophies;
+        }
+    };
+
+    struct Entry {
+        Stamp stamp;
+        Plan plan;
+
+        /// Effective potions of the monster that exist, valid for the two generations below.
+        std::vector<std::pair<std::string_view, Potion*>> potions;
+        uint64_t potionsMonsters = UINT64_MAX;
+        uint64_t potionsMembership = UINT64_MAX;
+    };
+
+    static std::map<std::string, Entry, std::less<>> plans;
+
+    static Stamp currentStamp();
+    static void search(std::string_view monsterName, Entry& entry);
+};
+
+#endif
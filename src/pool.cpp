@@ -0,0 +1,16 @@
+/**
+ * @file pool.cpp
+ * @brief Implementation of the entity pool.
+ */
+
+#include <memory_resource>
+
+#include "pool.h"
+
+using namespace std;
+
+pmr::memory_resource* EntityPool::resource() {
+    // Geralt's state is only touched by the command thread, so the pool needs no locking
+    static pmr::unsynchronized_pool_resource* pool = new pmr::unsynchronized_pool_resource();
+    return pool;
+}
@@ -0,0 +1,50 @@
+#ifndef POOL_H
+#define POOL_H
+
+/**
+ * @file pool.h
+ * @brief Declares the pool that holds Geralt's long-lived entities and map nodes.
+ *
+ * With make_shared and the default map allocator, every new name costs two heap blocks
+ * (the entity with its control block, and the tree node), scattered over the heap
+ * between whatever else was allocated at that moment. A catalog of a million names
+ * then spreads across far more pages than it fills. Entities and map nodes are drawn
+ * from a std::pmr::unsynchronized_pool_resource instead: blocks of one size are carved
+ * out of large chunks that grow geometrically, so neighbouring names share pages and
+ * a freed block is reused by the next entity of the same size.
+ */
+
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+/**
+ * @class EntityPool
+ * @brief Static access to the pool resource shared by all of Geralt's collections.
+ */
+class EntityPool {
+public:
+    /**
+     * @brief Returns the pool resource.
+     *
+     * The resource is never destroyed: entities can outlive the maps through the
+     * shared pointers held by the query cache, and static destructors run in no
+     * particular order across translation units.
+     */
+    static std::pmr::memory_resource* resource();
+
+    /**
+     * @brief Creates an entity in the pool, with its control block in the same block.
+     *
+     * @tparam Entity Ingredient, Potion, Monster or Trophy.
+     * @param arguments Constructor arguments of the entity.
+     * @return std::shared_ptr<Entity> Owning pointer to the new entity.
+     */
+    template <typename Entity, typename... Arguments>
+    static std::shared_ptr<Entity> make(Arguments&&... arguments) {
+        return std::allocate_shared<Entity>(std::pmr::polymorphic_allocator<Entity>(resource()),
+                                            std::forward<Arguments>(arguments)...);
+    }
+};
+
+#endif
@@ -2,8 +2,8 @@
 #include <string>
 #include <algorithm>
 
-Potion::Potion(const string& name) 
-    : name(name), quantity(0), formulaDefined(false) {}
+Potion::Potion(const Name& name) 
+    : name(name), quantity(0), id(0), formulaDefined(false), generation(0) {}
 
 void Potion::sortFormula() {
     sort(formula.begin(), formula.end(), Comparator());
@@ -15,10 +15,12 @@ int Potion::getQuantity() {
 
 void Potion::increaseQuantity(int amount) {
     this->quantity += amount;
+    this->generation++;
 }
 
 void Potion::decreaseQuantity(int amount) {
     this->quantity -= amount;
+    this->generation++;
 }
 
 bool Potion::isFormulaDefined() {
@@ -27,17 +29,35 @@ bool Potion::isFormulaDefined() {
 
 void Potion::defineFormula() {
     this->formulaDefined = true;
+    this->generation++;
 }
 
-void Potion::addToFormula(int quantity, const string& ingredientName) {
-    this->formula.push_back(make_pair(ingredientName, quantity));
+void Potion::addToFormula(int quantity, string_view ingredientName) {
+    this->formula.push_back(make_pair(Name(ingredientName), quantity));
+    this->generation++;
 }
 
-const vector<pair<string,int>>& Potion::getFormula() {
+const vector<pair<Name, int>>& Potion::getFormula() {
     return this->formula;
 }
 
-const vector<pair<string, int>>& Potion::getSortedFormula() {
+const vector<pair<Name, int>>& Potion::getSortedFormula() {
     sortFormula();
     return this->formula;
-}
\ No newline at end of file
+}
+
+const Name& Potion::getName() const {
+    return this->name;
+}
+
+const uint64_t& Potion::getGeneration() const {
+    return this->generation;
+}
+
+uint32_t Potion::getId() const {
+    return this->id;
+}
+
+void Potion::setId(uint32_t id) {
+    this->id = id;
+}
@@ -8,7 +8,11 @@
  */
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstdint>
+
+#include "name.h"
 
 using namespace std;
 
@@ -21,7 +25,7 @@ using namespace std;
  *   2. For equal quantities, lower (alphabetical) @c ingredient name comes first.
  */
 struct Comparator {
-    bool operator()(const pair<string, int>& a, const pair<string, int>& b) const {
+    bool operator()(const pair<Name, int>& a, const pair<Name, int>& b) const {
         // If their quantities are different, they are sorted by their quantities
         if (a.second != b.second) {
             return a.second > b.second;
@@ -41,10 +45,12 @@ struct Comparator {
 class Potion {
 private:
     /// Data fields are declared private in order to encapsulate the data.
-    string name;
+    Name name;
     int quantity;
-    vector<pair<string, int>> formula;
+    uint32_t id;            ///< Dense index of the entity in its collection, in the order of addition
+    vector<pair<Name, int>> formula;
     bool formulaDefined;
+    uint64_t generation;
 
     /// This private method sorts the formula before printing.
     void sortFormula();
@@ -54,7 +60,7 @@ public:
      * @brief Construct a Potion.
      * @param name Potion name.
      */
-    Potion(const string& name);
+    Potion(const Name& name);
 
     /**
      * @brief Get current quantity.
@@ -88,17 +94,33 @@ public:
      * @param quantity Amount required.
      * @param ingredientName Ingredient name.
      */
-    void addToFormula(int quantity, const string& ingredientName);
+    void addToFormula(int quantity, string_view ingredientName);
 
     /**
      * @brief Get formula.
      */
-    const vector<pair<string, int>>& getFormula();
+    const vector<pair<Name, int>>& getFormula();
 
     /**
      * @brief Get sorted formula.
      */
-    const vector<pair<string, int>>&  getSortedFormula();
+    const vector<pair<Name, int>>&  getSortedFormula();
+
+    /**
+     * @brief Get the name, stored in the potion itself.
+     */
+    const Name& getName() const;
+
+    /**
+     * @brief Version counter bumped on every change, used to validate cached query answers.
+     */
+    const uint64_t& getGeneration() const;
+
+    /**
+     * @brief ID of the entity in its collection, used by the history, the change feed and the undo log; set by Geralt.
+     */
+    uint32_t getId() const;
+    void setId(uint32_t id);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+/**
+ * @file querycache.cpp
+ * @brief Implementation of the generation-validated query answer cache.
+ */
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+#include "querycache.h"
+
+using namespace std;
+
+unordered_map<string, QueryCache::Entry> QueryCache::entries;
+
+/// The action type is stored in the first byte, so names never collide across query kinds.
+string QueryCache::key(ParserActionType action, const string& name) {
+    string result(1, static_cast<char>(action));
+    result.append(name);
+    return result;
+}
+
+const string* QueryCache::find(ParserActionType action, const string& name) {
+    auto it = entries.find(key(action, name));
+
+    if (it == entries.end()) {
+        return nullptr;
+    }
+
+    const Dependency& dependency = it->second.dependency;
+    if (*dependency.generation != dependency.expected) {
+        return nullptr;
+    }
+
+    return &it->second.output;
+}
+
+const string& QueryCache::store(ParserActionType action, const string& name, string output, Dependency dependency) {
+    if (entries.size() >= MAX_ENTRIES) {
+        entries.clear();
+    }
+
+    Entry& entry = entries[key(action, name)];
+    entry.output = move(output);
+    entry.dependency = move(dependency);
+    return entry.output;
+}
+
+void QueryCache::clear() {
+    entries.clear();
+}
+
+QueryCache::Dependency QueryCache::on(const uint64_t& counter) {
+    // Aliasing constructor with an empty owner: a non-owning pointer to a static counter
+    return Dependency{shared_ptr<const uint64_t>(shared_ptr<const uint64_t>(), &counter), counter};
+}
@@ -0,0 +1,94 @@
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+/**
+ * @file querycache.h
+ * @brief Declares the cache of rendered query answers validated by generation counters.
+ *
+ * Polling clients ask the same few queries thousands of times between two mutations.
+ * Every answer is rendered once into a byte string and stored together with the
+ * generation counter it depends on: the generation of the queried entity, or of the
+ * whole collection for listings and for names that do not exist yet. As long as that
+ * counter has not moved, a repeated query is answered by writing the stored bytes.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "parser.h"
+
+/**
+ * @class QueryCache
+ * @brief Static memo table from (query action, name) to its last rendered answer.
+ */
+class QueryCache {
+public:
+    /**
+     * @struct Dependency
+     * @brief The generation counter an answer depends on and its value at render time.
+     *
+     * The pointer shares ownership of the entity that holds the counter, so the counter
+     * stays readable even after the entity has been removed from Geralt's maps.
+     */
+    struct Dependency {
+        std::shared_ptr<const uint64_t> generation;
+        uint64_t expected;
+    };
+
+    /// Maximum number of cached answers; the cache is dropped when it would grow beyond this.
+    static constexpr size_t MAX_ENTRIES = 65536;
+
+    /**
+     * @brief Returns the cached answer of a query if it is still up to date.
+     *
+     * @param action Query action type.
+     * @param name Queried name; empty for listing queries.
+     * @return const std::string* The rendered answer, or nullptr if it must be recomputed.
+     */
+    static const std::string* find(ParserActionType action, const std::string& name);
+
+    /**
+     * @brief Stores a freshly rendered answer.
+     *
+     * @param action Query action type.
+     * @param name Queried name; empty for listing queries.
+     * @param output Rendered answer without a line terminator.
+     * @param dependency Counter that invalidates the answer when it changes.
+     * @return const std::string& The stored answer.
+     */
+    static const std::string& store(ParserActionType action, const std::string& name, std::string output, Dependency dependency);
+
+    /// Drops every cached answer, e.g. when the whole state is replaced.
+    static void clear();
+
+    /**
+     * @brief Builds a dependency on a counter that lives for the whole program.
+     *
+     * @param counter Static generation counter.
+     */
+    static Dependency on(const uint64_t& counter);
+
+    /**
+     * @brief Builds a dependency on the generation of an entity.
+     *
+     * @param entity Entity whose generation the answer depends on.
+     */
+    template <typename Entity>
+    static Dependency on(const std::shared_ptr<Entity>& entity) {
+        return Dependency{std::shared_ptr<const uint64_t>(entity, &entity->getGeneration()), entity->getGeneration()};
+    }
+
+private:
+    struct Entry {
+        std::string output;
+        Dependency dependency;
+    };
+
+    static std::unordered_map<std::string, Entry> entries;
+
+    static std::string key(ParserActionType action, const std::string& name);
+};
+
+#endif
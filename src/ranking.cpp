@@ -0,0 +1,66 @@
+/**
+ * @file ranking.cpp
+ * @brief Implementation of the stock ranking.
+ */
+
+#include "ranking.h"
+#include "geralt.h"
+
+using namespace std;
+
+StockRanking::StockRanking(pmr::memory_resource* resource) : entries(resource) {}
+
+void StockRanking::insert(string_view name, int quantity) {
+    if (quantity > 0) {
+        entries.emplace(quantity, name);
+    }
+}
+
+void StockRanking::update(string_view name, int before, int after) {
+    if (!built || before == after) {
+        return;
+    }
+
+    // Reuse the tree node when the entity stays in stock
+    if (before > 0) {
+        auto node = entries.extract(Entry(before, name));
+        if (after > 0 && !node.empty()) {
+            node.value().first = after;
+            entries.insert(move(node));
+            return;
+        }
+    }
+
+    if (after > 0) {
+        entries.emplace(after, name);
+    }
+}
+
+void StockRanking::invalidate() {
+    entries.clear();
+    built = false;
+}
+
+void StockRanking::largest(size_t count, pmr::vector<ItemCount>& ranked) const {
+    ranked.clear();
+    for (auto it = entries.begin(); it != entries.end() && ranked.size() < count; ++it) {
+        ranked.push_back(ItemCount{it->second, it->first});
+    }
+}
+
+void StockRanking::smallest(size_t count, pmr::vector<ItemCount>& ranked) const {
+    ranked.clear();
+
+    // The tree ends with the smallest quantity, but names run backwards there, so each
+    // group of equal quantities is found by its first name and read forwards
+    auto groupEnd = entries.end();
+    while (groupEnd != entries.begin() && ranked.size() < count) {
+        int quantity = prev(groupEnd)->first;
+        auto groupBegin = entries.lower_bound(Entry(quantity, string_view()));
+
+        for (auto it = groupBegin; it != groupEnd && ranked.size() < count; ++it) {
+            ranked.push_back(ItemCount{it->second, it->first});
+        }
+        groupEnd = groupBegin;
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef RANKING_H
+#define RANKING_H
+
+/**
+ * @file ranking.h
+ * @brief Declares the index that keeps the stock of a collection ordered by quantity.
+ *
+ * The listings of Geralt's maps are alphabetical, so the largest or smallest stocks
+ * could only be found by sorting a whole collection. A StockRanking holds every entity
+ * with a positive quantity in a balanced tree ordered by (quantity, name), and Geralt
+ * moves an entity within it on every quantity change. The K largest stocks are then
+ * the first K entries of the tree, and the K smallest are found from its end.
+ *
+ * A ranking is built from its map on first use and dropped by Geralt::reset(), so
+ * loading a snapshot, which fills the maps directly, does not have to maintain it.
+ */
+
+#include <cstddef>
+#include <memory_resource>
+#include <set>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct ItemCount;
+
+/**
+ * @class StockRanking
+ * @brief Entities with a positive quantity, by descending quantity and then by name.
+ *
+ * Names point into the entities, which stay in place until the next reset.
+ */
+class StockRanking {
+public:
+    explicit StockRanking(std::pmr::memory_resource* resource);
+
+    /// true once the ranking holds the stock of its collection and follows its changes.
+    bool isBuilt() const { return built; }
+
+    /// Adds an entity while the ranking is being built; call markBuilt() after the last one.
+    void insert(std::string_view name, int quantity);
+    void markBuilt() { built = true; }
+
+    /// Moves an entity whose quantity changed from @p before to @p after; ignored until the ranking is built.
+    void update(std::string_view name, int before, int after);
+
+    /// Drops every entry; the ranking is built again on next use.
+    void invalidate();
+
+    /**
+     * @brief Lists the entities with the largest quantities, ties in alphabetical order.
+     *
+     * @param count Number of entities to list at most.
+     * @param ranked Receives the entities by descending quantity.
+     */
+    void largest(size_t count, std::pmr::vector<ItemCount>& ranked) const;
+
+    /**
+     * @brief Lists the entities with the smallest positive quantities, ties in alphabetical order.
+     *
+     * @param count Number of entities to list at most.
+     * @param ranked Receives the entities by ascending quantity.
+     */
+    void smallest(size_t count, std::pmr::vector<ItemCount>& ranked) const;
+
+private:
+    typedef std::pair<int, std::string_view> Entry;
+
+    /// Larger quantities first, then names in alphabetical order.
+    struct MoreFirst {
+        bool operator()(const Entry& a, const Entry& b) const {
+            if (a.first != b.first) {
+                return a.first > b.first;
+            }
+            return a.second < b.second;
+        }
+    };
+
+    std::pmr::set<Entry, MoreFirst> entries;
+    bool built = false;
+};
+
+#endif
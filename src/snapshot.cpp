@@ -0,0 +1,365 @@
+/**
+ * @file snapshot.cpp
+ * @brief Writing, mapping and restoring binary snapshots of Geralt's state.
+ */
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+#include "geralt.h"
+#include "pool.h"
+
+using namespace std;
+
+uint64_t snapshotChecksum(const void* data, size_t length) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+namespace {
+
+/**
+ * @brief Collects the tables of a snapshot before they are laid out in a single buffer.
+ *
+ * Every distinct name is stored once in the string pool, so an ingredient that appears
+ * in the inventory and in ten formulas costs a single copy of its name.
+ */
+class SnapshotBuilder {
+private:
+    unordered_map<string, StringRef> interned;
+
+public:
+    vector<QuantityRecord> ingredients;
+    vector<PotionRecord> potions;
+    vector<MonsterRecord> monsters;
+    vector<QuantityRecord> trophies;
+    vector<FormulaRecord> formulas;
+    vector<StringRef> nameRefs;
+    string strings;
+
+    StringRef intern(string_view view) {
+        string name(view);
+        auto it = interned.find(name);
+        if (it != interned.end()) {
+            return it->second;
+        }
+
+        StringRef ref{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(name.size())};
+        strings.append(name);
+        interned.emplace(name, ref);
+        return ref;
+    }
+};
+
+/// Appends the raw bytes of a record table to the output buffer and returns its file offset.
+template <typename Record>
+uint64_t appendTable(string& buffer, const vector<Record>& table) {
+    uint64_t offset = buffer.size();
+    buffer.append(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(Record));
+    return offset;
+}
+
+/// Checks that a table of @p count records at @p offset lies completely inside the file.
+bool tableFits(uint64_t offset, uint64_t count, size_t recordSize, size_t fileSize) {
+    return offset <= fileSize && count <= (fileSize - offset) / recordSize && offset % alignof(uint32_t) == 0;
+}
+
+/**
+ * @brief Checks that a name table is strictly sorted, so it holds no duplicate either.
+ *
+ * The loader inserts every record at end() of its map, which is only correct when each
+ * name sorts after the previous one.
+ */
+template <typename Record>
+bool namesSorted(const SnapshotView& view, const Record* table, uint32_t count) {
+    for (uint32_t i = 1; i < count; i++) {
+        if (!(view.name(table[i - 1].name) < view.name(table[i].name))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool writeSnapshot(const string& path) {
+    SnapshotBuilder builder;
+
+    // std::map iterates in key order, so every table comes out sorted by name
+    for (auto& ingredientPair : Geralt::getIngredients()) {
+        builder.ingredients.push_back({builder.intern(ingredientPair.first), ingredientPair.second->getQuantity(), 0});
+    }
+
+    for (auto& potionPair : Geralt::getPotions()) {
+        Potion& potion = *potionPair.second;
+        PotionRecord record{builder.intern(potionPair.first), potion.getQuantity(), potion.isFormulaDefined() ? 1u : 0u,
+                            static_cast<uint32_t>(builder.formulas.size()), 0};
+
+        for (const pair<Name, int>& formulaIngredient : potion.getFormula()) {
+            builder.formulas.push_back({builder.intern(formulaIngredient.first), formulaIngredient.second, 0});
+        }
+
+        record.formulaCount = static_cast<uint32_t>(builder.formulas.size()) - record.formulaBegin;
+        builder.potions.push_back(record);
+    }
+
+    for (auto& monsterPair : Geralt::getMonsters()) {
+        Monster& monster = *monsterPair.second;
+        MonsterRecord record{builder.intern(monsterPair.first), 0, 0, 0, 0};
+
+        record.signBegin = static_cast<uint32_t>(builder.nameRefs.size());
+        for (const Name& signName : monster.getEffectiveSigns()) {
+            builder.nameRefs.push_back(builder.intern(signName));
+        }
+        record.signCount = static_cast<uint32_t>(builder.nameRefs.size()) - record.signBegin;
+
+        record.potionBegin = static_cast<uint32_t>(builder.nameRefs.size());
+        for (const Name& potionName : monster.getEffectivePotions()) {
+            builder.nameRefs.push_back(builder.intern(potionName));
+        }
+        record.potionCount = static_cast<uint32_t>(builder.nameRefs.size()) - record.potionBegin;
+
+        builder.monsters.push_back(record);
+    }
+
+    for (auto& trophyPair : Geralt::getTrophies()) {
+        builder.trophies.push_back({builder.intern(trophyPair.first), trophyPair.second->getQuantity(), 0});
+    }
+
+    SnapshotHeader header{};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.ingredientCount = static_cast<uint32_t>(builder.ingredients.size());
+    header.potionCount = static_cast<uint32_t>(builder.potions.size());
+    header.monsterCount = static_cast<uint32_t>(builder.monsters.size());
+    header.trophyCount = static_cast<uint32_t>(builder.trophies.size());
+    header.formulaCount = static_cast<uint32_t>(builder.formulas.size());
+    header.nameRefCount = static_cast<uint32_t>(builder.nameRefs.size());
+    header.stringBytes = builder.strings.size();
+
+    // The header is patched in once every offset is known
+    string buffer(sizeof(SnapshotHeader), '\0');
+    header.ingredientsOffset = appendTable(buffer, builder.ingredients);
+    header.potionsOffset = appendTable(buffer, builder.potions);
+    header.monstersOffset = appendTable(buffer, builder.monsters);
+    header.trophiesOffset = appendTable(buffer, builder.trophies);
+    header.formulasOffset = appendTable(buffer, builder.formulas);
+    header.nameRefsOffset = appendTable(buffer, builder.nameRefs);
+    header.stringsOffset = buffer.size();
+    buffer.append(builder.strings);
+
+    header.fileSize = buffer.size();
+    header.checksum = snapshotChecksum(buffer.data() + sizeof(SnapshotHeader), buffer.size() - sizeof(SnapshotHeader));
+    memcpy(&buffer[0], &header, sizeof(SnapshotHeader));
+
+    string temporaryPath = path + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    written = (fflush(file) == 0) && written;
+    written = (fsync(fileno(file)) == 0) && written;
+    written = (fclose(file) == 0) && written;
+
+    if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+SnapshotView::SnapshotView() : base_(nullptr), size_(0), header_(nullptr) {}
+
+SnapshotView::~SnapshotView() {
+    close();
+}
+
+void SnapshotView::close() {
+    if (base_ != nullptr) {
+        munmap(const_cast<char*>(base_), size_);
+    }
+
+    base_ = nullptr;
+    size_ = 0;
+    header_ = nullptr;
+}
+
+bool SnapshotView::open(const string& path, string& error) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        error = "truncated snapshot";
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED) {
+        error = "cannot map " + path;
+        return false;
+    }
+
+    base_ = static_cast<const char*>(mapping);
+    size_ = fileStat.st_size;
+    header_ = reinterpret_cast<const SnapshotHeader*>(base_);
+
+    const SnapshotHeader& h = *header_;
+
+    if (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0) {
+        error = "not a snapshot file";
+    } else if (h.version != SNAPSHOT_VERSION || h.headerSize != sizeof(SnapshotHeader)) {
+        error = "unsupported snapshot version " + to_string(h.version);
+    } else if (h.fileSize != size_) {
+        error = "truncated snapshot";
+    } else if (!tableFits(h.ingredientsOffset, h.ingredientCount, sizeof(QuantityRecord), size_) ||
+               !tableFits(h.potionsOffset, h.potionCount, sizeof(PotionRecord), size_) ||
+               !tableFits(h.monstersOffset, h.monsterCount, sizeof(MonsterRecord), size_) ||
+               !tableFits(h.trophiesOffset, h.trophyCount, sizeof(QuantityRecord), size_) ||
+               !tableFits(h.formulasOffset, h.formulaCount, sizeof(FormulaRecord), size_) ||
+               !tableFits(h.nameRefsOffset, h.nameRefCount, sizeof(StringRef), size_) ||
+               !tableFits(h.stringsOffset, h.stringBytes, 1, size_)) {
+        error = "corrupt snapshot tables";
+    } else if (snapshotChecksum(base_ + sizeof(SnapshotHeader), size_ - sizeof(SnapshotHeader)) != h.checksum) {
+        error = "snapshot checksum mismatch";
+    } else {
+        return true;
+    }
+
+    close();
+    return false;
+}
+
+string_view SnapshotView::name(const StringRef& ref) const {
+    if (static_cast<uint64_t>(ref.offset) + ref.length > header_->stringBytes) {
+        return string_view();
+    }
+
+    return string_view(base_ + header_->stringsOffset + ref.offset, ref.length);
+}
+
+bool loadSnapshot(const string& path, string& error) {
+    SnapshotView view;
+
+    if (!view.open(path, error)) {
+        return false;
+    }
+
+    const SnapshotHeader& header = view.header();
+
+    // Checked before the state is reset, so a rejected file leaves it untouched
+    if (!namesSorted(view, view.ingredients(), header.ingredientCount) ||
+        !namesSorted(view, view.potions(), header.potionCount) ||
+        !namesSorted(view, view.monsters(), header.monsterCount) ||
+        !namesSorted(view, view.trophies(), header.trophyCount)) {
+        error = "snapshot names are not sorted or not unique";
+        return false;
+    }
+
+    Geralt::reset();
+    auto& ingredients = Geralt::getIngredients();
+    auto& potions = Geralt::getPotions();
+    auto& monsters = Geralt::getMonsters();
+    auto& trophies = Geralt::getTrophies();
+
+    // Tables are sorted, so inserting at end() keeps every emplace amortized constant time;
+    // entities get their IDs in table order
+    for (uint32_t i = 0; i < header.ingredientCount; i++) {
+        const QuantityRecord& record = view.ingredients()[i];
+        Name ingredientName(view.name(record.name));
+        shared_ptr<Ingredient> newIngredient = EntityPool::make<Ingredient>(ingredientName, record.quantity);
+        newIngredient->setId(i);
+        ingredients.emplace_hint(ingredients.end(), ingredientName, newIngredient);
+    }
+
+    for (uint32_t i = 0; i < header.potionCount; i++) {
+        const PotionRecord& record = view.potions()[i];
+
+        if (static_cast<uint64_t>(record.formulaBegin) + record.formulaCount > header.formulaCount) {
+            Geralt::reset();
+            error = "corrupt potion record";
+            return false;
+        }
+
+        Name potionName(view.name(record.name));
+        shared_ptr<Potion> newPotion = EntityPool::make<Potion>(potionName);
+        newPotion->increaseQuantity(record.quantity);
+
+        for (uint32_t f = 0; f < record.formulaCount; f++) {
+            const FormulaRecord& formulaRecord = view.formulas()[record.formulaBegin + f];
+            newPotion->addToFormula(formulaRecord.quantity, view.name(formulaRecord.ingredient));
+        }
+
+        if (record.formulaDefined) {
+            newPotion->defineFormula();
+        }
+
+        newPotion->setId(i);
+        potions.emplace_hint(potions.end(), potionName, newPotion);
+    }
+
+    for (uint32_t i = 0; i < header.monsterCount; i++) {
+        const MonsterRecord& record = view.monsters()[i];
+
+        if (static_cast<uint64_t>(record.signBegin) + record.signCount > header.nameRefCount ||
+            static_cast<uint64_t>(record.potionBegin) + record.potionCount > header.nameRefCount) {
+            Geralt::reset();
+            error = "corrupt monster record";
+            return false;
+        }
+
+        Name monsterName(view.name(record.name));
+        shared_ptr<Monster> newMonster = EntityPool::make<Monster>(monsterName);
+
+        for (uint32_t s = 0; s < record.signCount; s++) {
+            newMonster->addEffectiveSign(view.name(view.nameRefs()[record.signBegin + s]));
+        }
+
+        for (uint32_t p = 0; p < record.potionCount; p++) {
+            newMonster->addEffectivePotion(view.name(view.nameRefs()[record.potionBegin + p]));
+        }
+
+        newMonster->setId(i);
+        monsters.emplace_hint(monsters.end(), monsterName, newMonster);
+    }
+
+    for (uint32_t i = 0; i < header.trophyCount; i++) {
+        const QuantityRecord& record = view.trophies()[i];
+        Name trophyName(view.name(record.name));
+        shared_ptr<Trophy> newTrophy = EntityPool::make<Trophy>(trophyName);
+        newTrophy->increaseQuantity(record.quantity);
+        newTrophy->setId(i);
+        trophies.emplace_hint(trophies.end(), trophyName, newTrophy);
+    }
+
+    return true;
+}
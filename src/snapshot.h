@@ -0,0 +1,205 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/**
+ * @file snapshot.h
+ * @brief Declares the versioned binary snapshot format of Geralt's state.
+ *
+ * A snapshot holds the whole symbol table (every ingredient, potion, monster and
+ * trophy name), the quantities, the alchemy formulas and the bestiary in a single
+ * flat file. Every reference inside the file is an offset from the beginning of
+ * the file, so a mapped snapshot can be read in place without any relocation:
+ * only the pages that are actually touched are ever loaded by the kernel.
+ *
+ * File layout:
+ * @code
+ * SnapshotHeader
+ * QuantityRecord[ingredientCount]   (sorted by name)
+ * PotionRecord[potionCount]         (sorted by name)
+ * MonsterRecord[monsterCount]       (sorted by name)
+ * QuantityRecord[trophyCount]       (sorted by name)
+ * FormulaRecord[formulaCount]       (referenced by PotionRecord)
+ * StringRef[nameRefCount]           (referenced by MonsterRecord)
+ * char[stringBytes]                 (string pool, not NUL terminated)
+ * @endcode
+ */
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/// Magic bytes at the start of every snapshot file.
+constexpr char SNAPSHOT_MAGIC[8] = {'W', 'T', 'S', 'N', 'A', 'P', '\0', '\0'};
+
+/// Current on-disk format version. Increment whenever a record layout changes.
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+/**
+ * @struct StringRef
+ * @brief Location of a name inside the string pool of the snapshot.
+ */
+struct StringRef {
+    uint32_t offset;    ///< Byte offset from the start of the string pool
+    uint32_t length;    ///< Length of the name in bytes
+};
+
+/**
+ * @struct QuantityRecord
+ * @brief An ingredient or trophy with its current quantity.
+ */
+struct QuantityRecord {
+    StringRef name;
+    int32_t quantity;
+    uint32_t reserved;  ///< Keeps the record 8-byte aligned
+};
+
+/**
+ * @struct PotionRecord
+ * @brief A potion, its quantity and the slice of the formula table that belongs to it.
+ */
+struct PotionRecord {
+    StringRef name;
+    int32_t quantity;
+    uint32_t formulaDefined;    ///< 1 when the formula is known, 0 otherwise
+    uint32_t formulaBegin;      ///< Index of the first FormulaRecord of this potion
+    uint32_t formulaCount;      ///< Number of FormulaRecords of this potion
+};
+
+/**
+ * @struct FormulaRecord
+ * @brief One `<quantity> <ingredient>` pair of a potion formula.
+ */
+struct FormulaRecord {
+    StringRef ingredient;
+    int32_t quantity;
+    uint32_t reserved;
+};
+
+/**
+ * @struct MonsterRecord
+ * @brief A bestiary entry; signs and potions are slices of the name reference table.
+ */
+struct MonsterRecord {
+    StringRef name;
+    uint32_t signBegin;
+    uint32_t signCount;
+    uint32_t potionBegin;
+    uint32_t potionCount;
+};
+
+/**
+ * @struct SnapshotHeader
+ * @brief Fixed-size header that starts every snapshot file.
+ *
+ * All offsets are measured from the beginning of the file. The checksum is the
+ * 64-bit FNV-1a hash of every byte that follows the header.
+ */
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fileSize;
+    uint64_t checksum;
+
+    uint32_t ingredientCount;
+    uint32_t potionCount;
+    uint32_t monsterCount;
+    uint32_t trophyCount;
+    uint32_t formulaCount;
+    uint32_t nameRefCount;
+    uint64_t stringBytes;
+
+    uint64_t ingredientsOffset;
+    uint64_t potionsOffset;
+    uint64_t monstersOffset;
+    uint64_t trophiesOffset;
+    uint64_t formulasOffset;
+    uint64_t nameRefsOffset;
+    uint64_t stringsOffset;
+};
+
+/**
+ * @brief Computes the 64-bit FNV-1a checksum used by the snapshot format.
+ *
+ * @param data Pointer to the first byte.
+ * @param length Number of bytes to hash.
+ * @return uint64_t The checksum.
+ */
+uint64_t snapshotChecksum(const void* data, size_t length);
+
+/**
+ * @class SnapshotView
+ * @brief Read-only, zero-copy view over a memory-mapped snapshot file.
+ *
+ * Opening the view maps the file and validates the header and checksum. The record
+ * arrays are then accessed in place; names are returned as views into the mapping.
+ */
+class SnapshotView {
+private:
+    const char* base_;              ///< Start of the mapped file (nullptr when closed)
+    size_t size_;                   ///< Size of the mapping in bytes
+    const SnapshotHeader* header_;  ///< Header at the start of the mapping
+
+    template <typename Record>
+    const Record* table(uint64_t offset) const {
+        return reinterpret_cast<const Record*>(base_ + offset);
+    }
+
+public:
+    SnapshotView();
+    ~SnapshotView();
+
+    SnapshotView(const SnapshotView&) = delete;
+    SnapshotView& operator=(const SnapshotView&) = delete;
+
+    /**
+     * @brief Maps and validates a snapshot file.
+     *
+     * @param path Path of the snapshot file.
+     * @param error Receives a human readable reason when opening fails.
+     * @return true If the file is a valid snapshot of a supported version.
+     * @return false If the file cannot be mapped or fails validation.
+     */
+    bool open(const std::string& path, std::string& error);
+
+    /// Unmaps the file. Safe to call on a closed view.
+    void close();
+
+    /// Resolves a string reference to a view into the mapped string pool.
+    std::string_view name(const StringRef& ref) const;
+
+    const SnapshotHeader& header() const { return *header_; }
+
+    const QuantityRecord* ingredients() const { return table<QuantityRecord>(header_->ingredientsOffset); }
+    const PotionRecord* potions() const { return table<PotionRecord>(header_->potionsOffset); }
+    const MonsterRecord* monsters() const { return table<MonsterRecord>(header_->monstersOffset); }
+    const QuantityRecord* trophies() const { return table<QuantityRecord>(header_->trophiesOffset); }
+    const FormulaRecord* formulas() const { return table<FormulaRecord>(header_->formulasOffset); }
+    const StringRef* nameRefs() const { return table<StringRef>(header_->nameRefsOffset); }
+};
+
+/**
+ * @brief Writes the current state of Geralt to a snapshot file.
+ *
+ * The file is written to a temporary path and renamed into place, so a reader never
+ * observes a half-written snapshot.
+ *
+ * @param path Destination path.
+ * @return true If the snapshot has been written completely.
+ */
+bool writeSnapshot(const std::string& path);
+
+/**
+ * @brief Replaces the state of Geralt with the contents of a snapshot file.
+ *
+ * A file whose name tables are not strictly sorted is rejected before the state is
+ * touched, since the tables are inserted at the end of the maps without a lookup.
+ *
+ * @param path Path of the snapshot file.
+ * @param error Receives a human readable reason when loading fails.
+ * @return true If the snapshot was valid and has been restored.
+ */
+bool loadSnapshot(const std::string& path, std::string& error);
+
+#endif
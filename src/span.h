@@ -0,0 +1,56 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+/**
+ * @file span.h
+ * @brief Declares a minimal read-only view of contiguous elements.
+ *
+ * The typed API takes its lists as a Span so that callers can pass an array, a
+ * vector or a braced list without copying it. It stands in for std::span, which
+ * is not available in C++17.
+ */
+
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+/**
+ * @class Span
+ * @brief Pointer and length of elements owned by someone else.
+ *
+ * @tparam T Element type.
+ */
+template <typename T>
+class Span {
+private:
+    const T* elements;
+    size_t count;
+
+public:
+    Span() : elements(nullptr), count(0) {}
+    Span(const T* elements, size_t count) : elements(elements), count(count) {}
+
+    template <size_t N>
+    Span(const T (&array)[N]) : elements(array), count(N) {}
+
+    template <typename Allocator>
+    Span(const std::vector<T, Allocator>& vector) : elements(vector.data()), count(vector.size()) {}
+
+    /// Only valid for the duration of the call it is passed to, like any braced temporary.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winit-list-lifetime"
+#endif
+    Span(std::initializer_list<T> list) : elements(list.begin()), count(list.size()) {}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    const T* begin() const { return elements; }
+    const T* end() const { return elements + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t index) const { return elements[index]; }
+};
+
+#endif
@@ -0,0 +1,235 @@
+/**
+ * @file stats.cpp
+ * @brief Implementation of the latency histograms and their reports.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "stats.h"
+#include "trace.h"
+#include "output.h"
+
+using namespace std;
+
+bool Stats::active = false;
+bool Stats::histograms = false;
+Histogram Stats::stages[Stats::STAGE_COUNT];
+vector<Histogram> Stats::actions;
+Stats::AllocationTotals Stats::stageAllocationTotals[Stats::STAGE_COUNT];
+Stats::AllocationTotals Stats::commandAllocationTotals[PARSER_ACTION_COUNT + 1];
+int Stats::commandAction = -1;
+
+uint64_t Histogram::highestValueOf(int bucket) {
+    if (bucket < LINEAR_BUCKETS) {
+        return static_cast<uint64_t>(bucket);
+    }
+
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t mantissa = static_cast<uint64_t>(bucket % SUB_BUCKETS + SUB_BUCKETS);
+    return ((mantissa + 1) << shift) - 1;
+}
+
+uint64_t Histogram::percentile(double fraction) const {
+    if (total == 0) {
+        return 0;
+    }
+
+    // Rank of the requested measurement, counted from 1
+    uint64_t rank = static_cast<uint64_t>(ceil(fraction * static_cast<double>(total)));
+    rank = rank == 0 ? 1 : rank;
+
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            uint64_t value = highestValueOf(bucket);
+            return value < maximum ? value : maximum;
+        }
+    }
+
+    return maximum;
+}
+
+void Histogram::clear() {
+    *this = Histogram();
+}
+
+void Stats::enable() {
+    histograms = STATS_COMPILED;
+    enableSpans();
+}
+
+void Stats::enableSpans() {
+    if (STATS_COMPILED) {
+        active = true;
+    }
+}
+
+void Stats::finish(Stage stage, int action, chrono::steady_clock::time_point start, chrono::steady_clock::time_point end,
+                   const Allocations::Counters& allocationsAtStart) {
+    uint64_t elapsed = static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+
+    if (histograms) {
+        record(stage, action, elapsed);
+    }
+
+    if (Allocations::isEnabled()) {
+        Allocations::Counters now = Allocations::current();
+        uint64_t allocations = now.allocations - allocationsAtStart.allocations;
+        uint64_t bytes = now.bytes - allocationsAtStart.bytes;
+
+        stageAllocationTotals[stage].record(allocations, bytes);
+        if (stage == STAGE_COMMAND) {
+            commandAllocationTotals[commandAction + 1].record(allocations, bytes);
+        }
+    }
+
+    if (Trace::isOpen()) {
+        Trace::emit(stageName(stage), static_cast<uint64_t>(
+                        chrono::duration_cast<chrono::nanoseconds>(start.time_since_epoch()).count()), elapsed);
+    }
+}
+
+void Stats::noteAction(int action) {
+    commandAction = action;
+
+    if (Trace::isOpen()) {
+        Trace::setAction(action);
+    }
+}
+
+void Stats::record(Stage stage, int action, uint64_t nanoseconds) {
+    stages[stage].record(nanoseconds);
+
+    if (action >= 0) {
+        if (static_cast<size_t>(action) >= actions.size()) {
+            actions.resize(action + 1);
+        }
+        actions[action].record(nanoseconds);
+    }
+}
+
+const Histogram& Stats::stage(Stage stage) {
+    return stages[stage];
+}
+
+const Stats::AllocationTotals& Stats::stageAllocations(Stage stage) {
+    return stageAllocationTotals[stage];
+}
+
+const Stats::AllocationTotals& Stats::commandAllocations(int action) {
+    return commandAllocationTotals[action + 1];
+}
+
+const Histogram& Stats::action(ParserActionType action) {
+    static const Histogram empty;
+    return static_cast<size_t>(action) < actions.size() ? actions[action] : empty;
+}
+
+void Stats::clear() {
+    for (Histogram& histogram : stages) {
+        histogram.clear();
+    }
+    actions.clear();
+
+    for (AllocationTotals& totals : stageAllocationTotals) {
+        totals = AllocationTotals();
+    }
+    for (AllocationTotals& totals : commandAllocationTotals) {
+        totals = AllocationTotals();
+    }
+}
+
+const char* Stats::stageName(Stage stage) {
+    switch (stage) {
+        case STAGE_COMMAND: return "command";
+        case STAGE_ESCAPES: return "escapes";
+        case STAGE_LEX: return "lex";
+        case STAGE_SCAN: return "scan";
+        case STAGE_REFINE: return "refine";
+        case STAGE_PARSE: return "parse";
+        case STAGE_EXECUTE: return "execute";
+        case STAGE_OUTPUT: return "output";
+        default: return "unknown";
+    }
+}
+
+/**
+ * @brief Calls @p visit with the label and histogram of every non-empty stage and action.
+ */
+template <typename Visitor>
+static void forEachHistogram(const Histogram* stages, const vector<Histogram>& actions, Visitor visit) {
+    for (int stage = 0; stage < Stats::STAGE_COUNT; stage++) {
+        if (stages[stage].count() > 0) {
+            visit(Stats::stageName(static_cast<Stats::Stage>(stage)), stages[stage]);
+        }
+    }
+
+    for (size_t action = 0; action < actions.size(); action++) {
+        if (actions[action].count() > 0) {
+            visit(actionTypeName(static_cast<ParserActionType>(action)), actions[action]);
+        }
+    }
+}
+
+void Stats::report(ostream& out) {
+    out << left << setw(34) << "stage / action (ns)" << right << setw(12) << "count" << setw(10) << "mean"
+        << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "p99.9"
+        << setw(12) << "max" << "\n";
+
+    forEachHistogram(stages, actions, [&](const char* label, const Histogram& histogram) {
+        out << left << setw(34) << label << right << setw(12) << histogram.count()
+            << setw(10) << static_cast<uint64_t>(histogram.mean()) << setw(10) << histogram.percentile(0.5)
+            << setw(10) << histogram.percentile(0.9) << setw(10) << histogram.percentile(0.99)
+            << setw(10) << histogram.percentile(0.999) << setw(12) << histogram.max() << "\n";
+    });
+
+    if (!Allocations::isEnabled()) {
+        return;
+    }
+
+    out << "\n" << left << setw(34) << "stage / command (allocations)" << right << setw(12) << "count"
+        << setw(12) << "allocs/op" << setw(12) << "max" << setw(12) << "bytes/op" << "\n";
+
+    auto row = [&](const char* label, const AllocationTotals& totals) {
+        if (totals.operations == 0) {
+            return;
+        }
+        out << left << setw(34) << label << right << setw(12) << totals.operations << fixed << setprecision(2)
+            << setw(12) << static_cast<double>(totals.allocations) / totals.operations << setw(12) << totals.maxAllocations
+            << setw(12) << static_cast<double>(totals.bytes) / totals.operations << defaultfloat << "\n";
+    };
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        row(stageName(static_cast<Stage>(stage)), stageAllocationTotals[stage]);
+    }
+    for (int action = -1; action < PARSER_ACTION_COUNT; action++) {
+        row(action < 0 ? "INVALID" : actionTypeName(static_cast<ParserActionType>(action)), commandAllocations(action));
+    }
+}
+
+void Stats::query(const TokenList&) {
+    if (!isEnabled()) {
+        Output::sink().write("Stats are disabled");
+        Output::sink().endAnswer();
+        return;
+    }
+
+    // One line, like every other answer: "<label> <count> p50 <ns> p99 <ns> max <ns>" per histogram
+    ostringstream line;
+    bool first = true;
+
+    forEachHistogram(stages, actions, [&](const char* label, const Histogram& histogram) {
+        line << (first ? "" : ", ") << label << " " << histogram.count() << " p50 " << histogram.percentile(0.5)
+             << " p99 " << histogram.percentile(0.99) << " max " << histogram.max();
+        first = false;
+    });
+
+    Output::sink().write(first ? "No stats" : line.str());
+    Output::sink().endAnswer();
+}
@@ -0,0 +1,236 @@
+#ifndef STATS_H
+#define STATS_H
+
+/**
+ * @file stats.h
+ * @brief Declares the per-stage latency instrumentation and its histograms.
+ *
+ * Every line goes through the same stages: escape replacement, scanning, refinement,
+ * grammar matching, execution and output. A Span placed around a stage measures it
+ * with steady_clock and records the duration into a log-linear (HDR-style) histogram
+ * of that stage; execution is additionally recorded per ParserActionType. With
+ * --trace the same spans are exported as trace events (see trace.h), and with
+ * allocation tracking on they also count the heap allocations made inside them (see
+ * allocations.h). Recording is switched on at run time with --stats, --trace or
+ * --alloc-budget, and the whole facility is compiled out when the program is built
+ * with -DWITCHERTRACKER_STATS=0.
+ */
+
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "parser.h"
+#include "token.h"
+#include "allocations.h"
+
+#ifndef WITCHERTRACKER_STATS
+#define WITCHERTRACKER_STATS 1
+#endif
+
+/// False when instrumentation is compiled out; every Span then collapses to nothing.
+constexpr bool STATS_COMPILED = WITCHERTRACKER_STATS != 0;
+
+/**
+ * @class Histogram
+ * @brief Latency histogram with a bounded relative error, in nanoseconds.
+ *
+ * Values below 32 get one bucket each. Above that, every power of two is split into
+ * 16 equal buckets, so a bucket is never wider than 1/16 of its values (about 6%)
+ * and the whole 64-bit range fits in a fixed array without any allocation.
+ */
+class Histogram {
+public:
+    static constexpr int LINEAR_BUCKETS = 32;
+    static constexpr int SUB_BUCKETS = 16;
+    static constexpr int BUCKET_COUNT = (64 - 4) * SUB_BUCKETS + LINEAR_BUCKETS;
+
+    /// Adds one measurement.
+    void record(uint64_t value) {
+        buckets[bucketOf(value)]++;
+        total++;
+        sum += value;
+        maximum = value > maximum ? value : maximum;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maximum; }
+    double mean() const { return total == 0 ? 0.0 : static_cast<double>(sum) / total; }
+
+    /**
+     * @brief Returns the value below which the given fraction of measurements lies.
+     *
+     * @param fraction Between 0 and 1, e.g. 0.99 for the 99th percentile.
+     * @return uint64_t Highest value of the bucket holding that measurement, capped at the maximum.
+     */
+    uint64_t percentile(double fraction) const;
+
+    /// Forgets every measurement.
+    void clear();
+
+private:
+    uint64_t buckets[BUCKET_COUNT] = {};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t maximum = 0;
+
+    static int bucketOf(uint64_t value) {
+        if (value < LINEAR_BUCKETS) {
+            return static_cast<int>(value);
+        }
+        int shift = 63 - __builtin_clzll(value) - 4;
+        return (shift + 1) * SUB_BUCKETS + static_cast<int>(value >> shift) - SUB_BUCKETS;
+    }
+
+    static uint64_t highestValueOf(int bucket);
+};
+
+/**
+ * @class Stats
+ * @brief Static collection of the stage and action histograms.
+ */
+class Stats {
+public:
+    /**
+     * @enum Stage
+     * @brief The processing stages of one command line.
+     */
+    enum Stage {
+        STAGE_COMMAND = 0, ///< The whole line, from the end of reading it to its answer
+        STAGE_ESCAPES,     ///< replaceEscapeSequences
+        STAGE_LEX,         ///< tokenizeLine, i.e. scan and refine
+        STAGE_SCAN,        ///< scanLine, the raw lexer
+        STAGE_REFINE,      ///< refineTokens
+        STAGE_PARSE,       ///< matchCommand
+        STAGE_EXECUTE,     ///< dispatchCommand, i.e. the Geralt executor
+        STAGE_OUTPUT,      ///< Flushing buffered answers to their destination, see output.h
+        STAGE_COUNT
+    };
+
+    /**
+     * @struct AllocationTotals
+     * @brief Heap allocations made by the measured operations of one stage or command kind.
+     */
+    struct AllocationTotals {
+        uint64_t operations = 0;
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+        uint64_t maxAllocations = 0; ///< Most allocations made by a single operation
+
+        void record(uint64_t operationAllocations, uint64_t operationBytes) {
+            operations++;
+            allocations += operationAllocations;
+            bytes += operationBytes;
+            maxAllocations = operationAllocations > maxAllocations ? operationAllocations : maxAllocations;
+        }
+    };
+
+    /**
+     * @class Span
+     * @brief Measures the lifetime of a scope and records it into a stage histogram.
+     *
+     * When recording is off the constructor and destructor only test one flag, and
+     * when the facility is compiled out they are empty.
+     */
+    class Span {
+    public:
+        explicit Span(Stage stage, int action = -1) : stage(stage), action(action) {
+            if constexpr (STATS_COMPILED) {
+                if (active) {
+                    if (action >= 0 || stage == STAGE_COMMAND) {
+                        noteAction(action);
+                    }
+                    allocationsAtStart = Allocations::current();
+                    start = std::chrono::steady_clock::now();
+                }
+            }
+        }
+
+        ~Span() {
+            if constexpr (STATS_COMPILED) {
+                if (active) {
+                    finish(stage, action, start, std::chrono::steady_clock::now(), allocationsAtStart);
+                }
+            }
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        Stage stage;
+        int action;
+        std::chrono::steady_clock::time_point start;
+        Allocations::Counters allocationsAtStart;
+    };
+
+    /// Starts recording histograms; does nothing when the facility is compiled out.
+    static void enable();
+
+    /// Starts measuring spans for the trace exporter without recording histograms.
+    static void enableSpans();
+
+    /// Tells whether histograms are currently being recorded.
+    static bool isEnabled() { return STATS_COMPILED && histograms; }
+
+    /**
+     * @brief Records one measurement into the histograms.
+     *
+     * @param stage Stage the measurement belongs to.
+     * @param action ParserActionType of the line for STAGE_EXECUTE, otherwise -1.
+     * @param nanoseconds Duration of the stage.
+     */
+    static void record(Stage stage, int action, uint64_t nanoseconds);
+
+    /// Returns the histogram of a stage.
+    static const Histogram& stage(Stage stage);
+
+    /// Returns the execution histogram of an action type.
+    static const Histogram& action(ParserActionType action);
+
+    /// Returns the allocations made inside the spans of a stage.
+    static const AllocationTotals& stageAllocations(Stage stage);
+
+    /**
+     * @brief Returns the allocations made by whole commands of one kind.
+     *
+     * @param action ParserActionType of the commands, or -1 for INVALID lines.
+     */
+    static const AllocationTotals& commandAllocations(int action);
+
+    /// Writes a table of every non-empty histogram, as printed by --stats at exit.
+    static void report(std::ostream& out);
+
+    /// Forgets every measurement.
+    static void clear();
+
+    /**
+     * @brief Answers the "Stats?" query with a one-line summary of every non-empty histogram.
+     *
+     * @param tokenList Tokens of the query (unused).
+     */
+    static void query(const TokenList& tokenList);
+
+    /// Returns the name of a stage as used in reports, e.g. "scan".
+    static const char* stageName(Stage stage);
+
+private:
+    static bool active;     ///< Spans are measured; true when histograms or tracing are on
+    static bool histograms; ///< Measured spans are recorded into the histograms
+    static Histogram stages[STAGE_COUNT];
+    static std::vector<Histogram> actions;
+    static AllocationTotals stageAllocationTotals[STAGE_COUNT];
+    static AllocationTotals commandAllocationTotals[PARSER_ACTION_COUNT + 1]; ///< Index 0 is INVALID
+    static int commandAction; ///< Action of the current line, -1 until it has been matched
+
+    /// Slow path of a measured span: hands it to the histograms, the allocation totals and the trace exporter.
+    static void finish(Stage stage, int action, std::chrono::steady_clock::time_point start,
+                       std::chrono::steady_clock::time_point end, const Allocations::Counters& allocationsAtStart);
+
+    /// Remembers the action of the current line (-1 when a new line starts) and tells the trace exporter.
+    static void noteAction(int action);
+};
+
+#endif
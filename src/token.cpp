@@ -5,6 +5,7 @@
 
 #include <unordered_map>
 #include <string>
+#include <utility>
 
 #include "token.h"
 
@@ -15,15 +16,15 @@
  * @param content The string content (lexeme) of the token.
  * @param type The TokenType associated with this content.
  */
-Token::Token(const std::string& content, TokenType type) : content_(content), type_(type) {}
+Token::Token(std::string content, TokenType type) : content_(std::move(content)), type_(type) {}
 
 
 /**
  * @brief Gets the content of the token.
  * 
- * @return std::string The string that represents the lexeme of the token.
+ * @return const std::string& The string that represents the lexeme of the token.
  */
-std::string Token::getContent() const {
+const std::string& Token::getContent() const {
     return content_;
 }
 
@@ -7,6 +7,8 @@
 #define TOKEN_H
 
 #include <string>
+#include <vector>
+#include <memory_resource>
 
 #include "tokenizer.h" ///< Required for TokenType definition
 
@@ -32,14 +34,14 @@ public:
      * @param content The string content of the token.
      * @param type The TokenType of this token.
      */
-    Token(const std::string& content, TokenType type);
+    Token(std::string content, TokenType type);
 
     /**
      * @brief Retrieves the content of the token.
      * 
-     * @return std::string The literal text value of the token.
+     * @return const std::string& The literal text value of the token.
      */
-    std::string getContent() const;
+    const std::string& getContent() const;
 
     /**
      * @brief Retrieves the type of the token.
@@ -50,4 +52,12 @@ public:
 
 };
 
+/**
+ * @brief Token sequence of one input line.
+ *
+ * While a command runs, the lexer allocates the sequence from the per-command arena
+ * (see arena.h). Copies use the default heap, so a copied TokenList may outlive the command.
+ */
+typedef std::pmr::vector<Token> TokenList;
+
 #endif  // TOKEN_H
\ No newline at end of file
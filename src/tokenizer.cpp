@@ -14,6 +14,12 @@
 
 #include "tokenizer.h"
 #include "token.h"
+#include "parser.h"
+#include "journal.h"
+#include "geralt.h"
+#include "parsecache.h"
+#include "stats.h"
+#include "arena.h"
 
 
 using namespace std;
@@ -37,44 +43,35 @@ TokenType getWordType(const string&, int, int);
  * @return true If token sequence is valid and successfully refined.
  * @return false If invalid syntax is detected.
  */
-bool refineTokens(vector<Token>&);
+bool refineTokens(TokenList&);
 
 /**
  * @brief Prints the tokens to the standard output.
  *
  * @param tokens Vector of tokens to print.
  */
-void printTokens(const vector<Token>&);
+void printTokens(const TokenList&);
 
 
-/**
- * @brief External parser function that analyzes tokens and executes appropriate logic.
- * 
- * @param tokens Vector of refined tokens to parse.
- * @return true If parsing is successful and command is valid.
- * @return false If no valid command is matched.
- */
-extern bool parseCommand(const vector<Token>&);
-
 
 /**
- * @brief Tokenizes a given input line into lexical tokens (words, numbers, punctuation, etc.).
+ * @brief Splits a given input line into raw lexical tokens (words, numbers, punctuation, whitespace).
  *
  * Handles:
  * - Single and multiple spaces
- * - Positive quantities (rejects 0 and negative)
+ * - Quantities (rejects negative numbers)
  * - Commas, question marks
- * - Word labeling based on context
+ * - Word labeling based on the keyword map
  *
- * @param line The input string to tokenize.
- * @return optional<vector<Token>> Vector of tokens if the line is valid; nullopt if invalid syntax is detected.
+ * @param line The input string to scan.
+ * @return optional<TokenList> Unrefined tokens, whitespace included; nullopt if invalid syntax is detected.
  */
-optional<vector<Token>> tokenizeLine(const string& line) {
+optional<TokenList> scanLine(const string& line) {
     
     int i = 0, lexStart; // i: current index, lexStart: where did we start the lexeme
     string::size_type lineLen = line.length();
     
-    vector<Token> tokens;
+    TokenList tokens(CommandArena::resource());
 
     TokenType type;
 
@@ -119,7 +116,7 @@ optional<vector<Token>> tokenizeLine(const string& line) {
 
             if (isNegative) {
                 // Negative numbers are not allowed
-                return nullopt;  // causes refineTokens to reject input
+                return nullopt;  // causes tokenizeLine to reject input
             }
 
             tokens.push_back(Token(line.substr(lexStart, i-lexStart), TOKEN_QUANTITY));
@@ -147,8 +144,32 @@ optional<vector<Token>> tokenizeLine(const string& line) {
 
     }
 
+    return tokens;
+}
+
+/**
+ * @brief Tokenizes a given input line into lexical tokens (words, numbers, punctuation, etc.).
+ *
+ * Scans the line with scanLine and refines the result with refineTokens.
+ *
+ * @param line The input string to tokenize.
+ * @return optional<TokenList> Vector of tokens if the line is valid; nullopt if invalid syntax is detected.
+ */
+optional<TokenList> tokenizeLine(const string& line) {
+    Stats::Span lexSpan(Stats::STAGE_LEX);
+    optional<TokenList> tokens;
+    {
+        Stats::Span span(Stats::STAGE_SCAN);
+        tokens = scanLine(line);
+    }
+
+    if (!tokens) {
+        return nullopt;
+    }
+
     // Deletes multiple spaces, combines words with only a single space in between and in the end there are no whitespace tokens
-    if (refineTokens(tokens)) {
+    Stats::Span span(Stats::STAGE_REFINE);
+    if (refineTokens(*tokens)) {
         return tokens;
     } else {
         return nullopt;
@@ -167,7 +188,7 @@ optional<vector<Token>> tokenizeLine(const string& line) {
  * @param tokens Reference to the vector of tokens to refine.
  * @return true if refinement is successful; false otherwise.
  */
-bool refineTokens(vector<Token>& tokens) {
+bool refineTokens(TokenList& tokens) {
 
     size_t tokenCount = tokens.size();
 
@@ -245,10 +266,9 @@ bool refineTokens(vector<Token>& tokens) {
  */
 TokenType getWordType(const string& line, int lexStartIndex, int lexLength) {
 
+    // Compared in place, so a name longer than the small-string buffer is not copied once per keyword
     for (const auto& pair : keyMap) {
-        string currentKeyword = pair.first;
-        
-        if (currentKeyword.compare(line.substr(lexStartIndex, lexLength)) == 0) {
+        if (line.compare(lexStartIndex, lexLength, pair.first) == 0) {
             return pair.second;
         }
     }
@@ -256,33 +276,90 @@ TokenType getWordType(const string& line, int lexStartIndex, int lexLength) {
     return TOKEN_WORD;
 }
 
+/**
+ * @brief Runs the inventory function of an already parsed line.
+ *
+ * @param line The input line, used for journaling.
+ * @param action The matched action type.
+ * @param tokens The refined tokens of the line.
+ */
+static void run_parsed_line(const string& line, ParserActionType action, const TokenList& tokens) {
+    bool inTransaction = Geralt::inTransaction();
+
+    // Calls the related inventory function
+    dispatchCommand(action, tokens);
+
+    // Commands that changed the state are journaled so that the state can be recovered later
+    if (Journal::isOpen() && isStateChangingAction(action)) {
+        Journal::append(line);
+    } else if (Journal::isOpen() && Geralt::inTransaction() != inTransaction) {
+        // The commands of a transaction reach the journal together, when it commits
+        if (Geralt::inTransaction()) {
+            Journal::beginTransaction();
+        } else if (action == COMMIT_COMMAND) {
+            Journal::commitTransaction();
+        } else {
+            Journal::rollbackTransaction();
+        }
+    }
+}
+
 /**
  * @brief Executes a line by tokenizing and parsing it.
  *
- * - Tokenizes the line.
- * - Refines and validates tokens.
- * - Passes them to the parser.
+ * - Reuses the parse result of a recently seen identical line when the parse cache has it.
+ * - Otherwise tokenizes the line, refines and validates tokens, and passes them to the parser.
+ * - Runs the matched inventory function.
+ * - Journals the line if it changed the state and journaling is enabled.
  *
  * @param line The input line to process.
  * @return true if the command is parsing is successful; false if invalid input or parsing fails.
  */
 bool execute_line(const string& line) {
+    // Transient allocations of this command are dropped at once when it returns
+    CommandArena::Scope arena;
+
+    // A repeated line skips the lexer and the parser entirely
+    if (const ParseCache::Entry* cached = ParseCache::lookup(line)) {
+        if (!cached->action) {
+            return false;
+        }
+
+        run_parsed_line(line, *cached->action, cached->tokens);
+        return true;
+    }
+
     auto tokensOpt = (tokenizeLine(line));
 
     // If tokenizeLine doesnt return null due to invalid input
     if (tokensOpt) {
 
         // Extracts the tokens vector
-        const std::vector<Token>& tokens = tokensOpt.value();
+        const TokenList& tokens = tokensOpt.value();
+
+
+        // Calls the parser to find the sentence type. If the parser fails to match the tokens
+        // to any valid syntax, it returns nullopt to indicate invalid input
+        optional<ParserActionType> action;
+        {
+            Stats::Span span(Stats::STAGE_PARSE);
+            action = matchCommand(tokens);
+        }
 
+        ParseCache::insert(line, action, tokens);
 
-        // Calls the parser and that parser calls the related inventory function inside. If the parser
-        // fails to match the tokens to any valid syntax, it returns falls to indicate invalid input
-        return parseCommand(tokens);
+        if (!action) {
+            return false;
+        }
+
+        run_parsed_line(line, *action, tokens);
+        return true;
 
     } else { // If tokenization fails and tokenizeLine returns null due to invalid input
         // cerr << "Tokenization failed: invalid input." << std::endl;
 
+        ParseCache::insert(line, nullopt, TokenList());
+
         // Invalid inputs which are not compatible with tokenization comes here
         return false;
     }
@@ -295,7 +372,7 @@ bool execute_line(const string& line) {
  *
  * @param tokens Vector of tokens to print.
  */
-void printTokens(const std::vector<Token>& tokens) {
+void printTokens(const TokenList& tokens) {
     for (const auto& token : tokens) {
          std::cout << "Content: " << token.getContent()
                   << ", Type: " << token.getType() << std::endl;
@@ -73,7 +73,53 @@ typedef enum {
     TOKEN_RECURSIVE_INGRED_LIST = 31,
 
     /// A recursive list of trophy tokens
-    TOKEN_RECURSIVE_TROPHY_LIST = 32
+    TOKEN_RECURSIVE_TROPHY_LIST = 32,
+
+    /// "Stats" (resolved from TOKEN_WORD, so "Stats" stays a valid name everywhere else)
+    TOKEN_STATS = 33,
+
+    /// "Memory" (resolved from TOKEN_WORD like TOKEN_STATS)
+    TOKEN_MEMORY = 34,
+
+    /// "How", "does" and "prepare" of the planner query (resolved from TOKEN_WORD like TOKEN_STATS)
+    TOKEN_HOW = 35,
+    TOKEN_DOES,
+    TOKEN_PREPARE,
+
+    /// "brewable" of the brew optimizer query (resolved from TOKEN_WORD like TOKEN_STATS)
+    TOKEN_BREWABLE = 38,
+
+    /// "need" of the shopping list query (resolved from TOKEN_WORD like TOKEN_STATS)
+    TOKEN_NEED = 39,
+
+    /// A recursive list of potion tokens
+    TOKEN_RECURSIVE_POTION_LIST = 40,
+
+    /// "Top" or "Bottom" of the ranked listing queries (resolved from TOKEN_WORD like TOKEN_LOOTS from TOKEN_ACTION)
+    TOKEN_RANKING = 41,
+
+    /// A list of at least two names separated by commas
+    TOKEN_RECURSIVE_NAME_LIST = 42,
+
+    /// A list of at least two potion names, which may be multi-word, separated by commas
+    TOKEN_RECURSIVE_POTION_NAME_LIST = 43,
+
+    /// "Complete" or "Suggest" of the name search queries (resolved from TOKEN_WORD like TOKEN_RANKING)
+    TOKEN_NAME_SEARCH = 44,
+
+    /// "at" of the time-travel queries (resolved from TOKEN_WORD like TOKEN_STATS)
+    TOKEN_AT = 45,
+
+    /// "if" of the what-if query (resolved from TOKEN_WORD like TOKEN_STATS)
+    TOKEN_IF = 46,
+
+    /// A whole state-changing action, up to the question mark that ends the line
+    TOKEN_NESTED_ACTION = 47,
+
+    /// "Begin", "Commit" and "Rollback" of the transaction commands (resolved from TOKEN_WORD like TOKEN_STATS)
+    TOKEN_BEGIN = 48,
+    TOKEN_COMMIT,
+    TOKEN_ROLLBACK
 
 } TokenType;
 
@@ -0,0 +1,204 @@
+/**
+ * @file trace.cpp
+ * @brief Implementation of the per-thread trace rings and the background JSON writer.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+#include "parser.h"
+
+using namespace std;
+
+namespace {
+
+/**
+ * @struct Ring
+ * @brief Single-producer single-consumer event buffer of one thread.
+ *
+ * Only the owning thread advances @c head and only the writer advances @c tail, so
+ * both sides synchronize through the two atomics alone.
+ */
+struct Ring {
+    atomic<uint64_t> head{0};
+    atomic<uint64_t> tail{0};
+    atomic<uint64_t> dropped{0};
+    long thread = 0;
+    uint64_t line = 0;    ///< Current line of the owning thread
+    int32_t action = -1;  ///< Action of the current line, once matched
+    Trace::Event events[Trace::RING_CAPACITY];
+};
+
+atomic<bool> tracing{false};
+FILE* file = nullptr;
+uint64_t origin = 0;
+long process = 0;
+bool firstEvent = true;
+
+mutex registryMutex;
+vector<unique_ptr<Ring>> rings;
+
+thread writer;
+mutex writerMutex;
+condition_variable writerWake;
+bool stopping = false;
+
+thread_local Ring* localRing = nullptr;
+
+/// How often the writer drains the rings.
+constexpr chrono::milliseconds FLUSH_INTERVAL(5);
+
+Ring& ownRing() {
+    if (localRing == nullptr) {
+        unique_ptr<Ring> ring(new Ring());
+        ring->thread = static_cast<long>(syscall(SYS_gettid));
+
+        lock_guard<mutex> lock(registryMutex);
+        rings.push_back(move(ring));
+        localRing = rings.back().get();
+    }
+    return *localRing;
+}
+
+void writeEvent(const Trace::Event& event, long thread) {
+    // Chrome trace timestamps are microseconds; fractions keep the nanosecond resolution
+    fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"witchertracker\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld",
+            firstEvent ? "" : ",", event.name, event.start / 1000.0, event.duration / 1000.0, process, thread);
+    firstEvent = false;
+
+    if (event.line != 0) {
+        fprintf(file, ",\"args\":{\"line\":%llu", static_cast<unsigned long long>(event.line));
+        if (event.action >= 0) {
+            fprintf(file, ",\"action\":\"%s\"", actionTypeName(static_cast<ParserActionType>(event.action)));
+        }
+        fputc('}', file);
+    }
+    fputc('}', file);
+}
+
+/// Writes every event that is in the rings right now.
+void drain() {
+    vector<Ring*> snapshot;
+    {
+        lock_guard<mutex> lock(registryMutex);
+        for (const auto& ring : rings) {
+            snapshot.push_back(ring.get());
+        }
+    }
+
+    for (Ring* ring : snapshot) {
+        uint64_t tail = ring->tail.load(memory_order_relaxed);
+        uint64_t head = ring->head.load(memory_order_acquire);
+
+        for (; tail != head; tail++) {
+            writeEvent(ring->events[tail & (Trace::RING_CAPACITY - 1)], ring->thread);
+        }
+        ring->tail.store(tail, memory_order_release);
+    }
+}
+
+void writerLoop() {
+    unique_lock<mutex> lock(writerMutex);
+    while (!stopping) {
+        writerWake.wait_for(lock, FLUSH_INTERVAL);
+        drain();
+    }
+}
+
+uint64_t steadyNanoseconds() {
+    return static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+bool Trace::open(const string& path, string& error) {
+    file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        error = "cannot create " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    origin = steadyNanoseconds();
+    process = static_cast<long>(getpid());
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+
+    stopping = false;
+    writer = thread(writerLoop);
+    tracing.store(true, memory_order_release);
+    return true;
+}
+
+bool Trace::isOpen() {
+    return tracing.load(memory_order_relaxed);
+}
+
+void Trace::setLine(uint64_t line) {
+    Ring& ring = ownRing();
+    ring.line = line;
+    ring.action = -1;
+}
+
+void Trace::setAction(int action) {
+    ownRing().action = action;
+}
+
+void Trace::emit(const char* name, uint64_t startNanoseconds, uint64_t duration) {
+    Ring& ring = ownRing();
+    uint64_t head = ring.head.load(memory_order_relaxed);
+
+    if (head - ring.tail.load(memory_order_acquire) == RING_CAPACITY) {
+        ring.dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    Event& event = ring.events[head & (RING_CAPACITY - 1)];
+    event.name = name;
+    event.start = startNanoseconds - origin;
+    event.duration = duration;
+    event.line = ring.line;
+    event.action = ring.action;
+
+    ring.head.store(head + 1, memory_order_release);
+}
+
+void Trace::close() {
+    if (!tracing.exchange(false)) {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(writerMutex);
+        stopping = true;
+    }
+    writerWake.notify_one();
+    writer.join();
+
+    // Whatever was recorded after the last periodic drain
+    drain();
+    fputs("\n]}\n", file);
+    fclose(file);
+    file = nullptr;
+
+    uint64_t dropped = 0;
+    for (const auto& ring : rings) {
+        dropped += ring->dropped.load(memory_order_relaxed);
+    }
+    if (dropped > 0) {
+        fprintf(stderr, "trace: %llu events dropped because a ring buffer was full\n",
+                static_cast<unsigned long long>(dropped));
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/**
+ * @file trace.h
+ * @brief Declares the Chrome trace-event exporter of per-command spans.
+ *
+ * With --trace every Stats::Span also becomes a complete ("X") trace event: one
+ * "command" span per input line with the lex, parse, execute and output spans nested
+ * inside it, each carrying the line number and, once it is known, the action type.
+ * The resulting JSON file loads in Perfetto or chrome://tracing.
+ *
+ * Recording a span must not distort the timings it records, so a span only copies a
+ * fixed-size event into a ring buffer owned by the current thread. A background
+ * thread drains every ring, formats the JSON and writes it. Rings are single-producer
+ * single-consumer and lock-free; when one is full the event is dropped and counted
+ * rather than making the command wait.
+ */
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @class Trace
+ * @brief Static trace-event recorder, used like the static Stats collection.
+ */
+class Trace {
+public:
+    /**
+     * @struct Event
+     * @brief One finished span, as stored in a ring buffer.
+     */
+    struct Event {
+        const char* name;  ///< Static span name, e.g. "parse"
+        uint64_t start;    ///< Nanoseconds since the trace was opened
+        uint64_t duration; ///< Nanoseconds
+        uint64_t line;     ///< Input line number, 0 when outside a command
+        int32_t action;    ///< ParserActionType, or -1 when not known (yet)
+    };
+
+    /// Events each thread can buffer before new ones are dropped; a power of two.
+    static constexpr size_t RING_CAPACITY = 1 << 16;
+
+    /**
+     * @brief Creates the trace file and starts the background writer.
+     *
+     * @param path Destination of the trace-event JSON.
+     * @param error Receives a human readable reason on failure.
+     * @return true If tracing is active.
+     */
+    static bool open(const std::string& path, std::string& error);
+
+    /// Returns true between open() and close().
+    static bool isOpen();
+
+    /**
+     * @brief Sets the input line that the spans of the calling thread belong to.
+     *
+     * @param line Line number counted from 1, or 0 between two commands.
+     */
+    static void setLine(uint64_t line);
+
+    /**
+     * @brief Records the action type of the current line of the calling thread.
+     *
+     * @param action Matched ParserActionType.
+     */
+    static void setAction(int action);
+
+    /**
+     * @brief Stores a finished span in the ring buffer of the calling thread.
+     *
+     * @param name Static span name.
+     * @param startNanoseconds steady_clock time of the span start, in nanoseconds.
+     * @param duration Length of the span in nanoseconds.
+     */
+    static void emit(const char* name, uint64_t startNanoseconds, uint64_t duration);
+
+    /// Drains every ring, completes the JSON document and stops the background writer.
+    static void close();
+};
+
+#endif
@@ -1,8 +1,8 @@
 #include "trophy.h"
 #include <string>
 
-Trophy::Trophy(const string& name)
-    : name(name), quantity(0) {}
+Trophy::Trophy(const Name& name)
+    : name(name), quantity(0), id(0), generation(0) {}
     
 int Trophy::getQuantity() {
     return this->quantity;
@@ -10,8 +10,26 @@ int Trophy::getQuantity() {
 
 void Trophy::increaseQuantity(int amount) {
     this->quantity += amount;
+    this->generation++;
 }
 
 void Trophy::decreaseQuantity(int amount) {
     this->quantity -= amount;
-}
\ No newline at end of file
+    this->generation++;
+}
+
+const Name& Trophy::getName() const {
+    return this->name;
+}
+
+const uint64_t& Trophy::getGeneration() const {
+    return this->generation;
+}
+
+uint32_t Trophy::getId() const {
+    return this->id;
+}
+
+void Trophy::setId(uint32_t id) {
+    this->id = id;
+}
@@ -7,20 +7,25 @@
  */
 
 #include <string>
+#include <cstdint>
+
+#include "name.h"
 
 using namespace std;
 
 class Trophy {
 private:
     /// Data fields are declared private in order to encapsulate the data.
-    string name;
+    Name name;
     int quantity;
+    uint32_t id;            ///< Dense index of the entity in its collection, in the order of addition
+    uint64_t generation;
 public:
     /**
      * @brief Construct a Trophy.
      * @param name Monster name.
      */
-    Trophy(const string& name);
+    Trophy(const Name& name);
 
     /**
      * @brief Get current quantity.
@@ -38,6 +43,22 @@ public:
      * @param amount Amount to subtract.
      */
     void decreaseQuantity(int amount);
+
+    /**
+     * @brief Get the name, stored in the trophy itself.
+     */
+    const Name& getName() const;
+
+    /**
+     * @brief Version counter bumped on every change, used to validate cached query answers.
+     */
+    const uint64_t& getGeneration() const;
+
+    /**
+     * @brief ID of the entity in its collection, used by the history, the change feed and the undo log; set by Geralt.
+     */
+    uint32_t getId() const;
+    void setId(uint32_t id);
 };
 
 #endif
\ No newline at end of file